@@ -7,11 +7,51 @@
  * applications... I suppose
  */
 
+#if !defined(_POSIX_C_SOURCE) && !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS, MAP_HUGETLB, MADV_HUGEPAGE
+#endif
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // cpu_set_t, pthread_attr_setaffinity_np
+#endif
+
+#include <limits.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "3d_detection_algo.h"
+
+// No pthreads: the pool runs every job inline on the submitting thread
+#if !defined(DETECTION_NO_THREADS) && (defined(_WIN32) || defined(__wasm__))
+#define DETECTION_NO_THREADS
+#endif
+
+#ifndef DETECTION_NO_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// NUMA-aware pools read the node layout from sysfs and pin workers; no
+// libnuma needed. Elsewhere (or single node) pools are flat.
+#if defined(__linux__) && !defined(DETECTION_NO_THREADS) &&                   \
+    !defined(DETECTION_NO_NUMA)
+#include <sched.h>
+#define DETECTION_NUMA
+#endif
+
+// Huge-page arenas need Linux mmap/madvise; elsewhere arenas use malloc
+#if defined(__linux__) && !defined(DETECTION_NO_HUGE_PAGES)
+#include <sys/mman.h>
+#if defined(MAP_HUGETLB) && defined(MADV_HUGEPAGE)
+#define DETECTION_HUGE_PAGES
+#endif
+#endif
+
 #define EPSILON 1e-9
 #define MAX_COMPONENTS 1000
 #define MAX_SEGMENTS 100
@@ -22,6 +62,11 @@ typedef struct {
   double x, y, z;
 } Vector3D;
 
+// Flat xyz buffers are reinterpreted as Vector3D arrays without copying
+typedef char vector3d_matches_xyz_triple[sizeof(Vector3D) == 3 * sizeof(double)
+                                             ? 1
+                                             : -1];
+
 // 3D Transformation Matrix (4x4 homogeneous)
 typedef struct {
   double m[4][4];
@@ -36,8 +81,8 @@ typedef struct {
 // Dynamic array for storing segments in 3D space
 typedef struct {
   Segment3D *data;
-  int count;
-  int capacity;
+  uint32_t count;
+  uint32_t capacity;
 } SegmentArray;
 
 // Joint types
@@ -46,20 +91,111 @@ typedef enum { FINGER_JOINT, HOLE_JOINT, SLOT_JOINT } JointType;
 typedef struct {
   JointType type;
   Segment3D segment;
+  double width; // across the segment in the component's plane; 0 for a line
 } Joint;
 
+/*
+ * Arena: bump allocator over large chunks, released all at once. Contexts
+ * keep vertices, joints and the component array in arenas so a large
+ * assembly sits in a few big mappings rather than thousands of small
+ * blocks; with huge pages enabled each chunk is a 2 MB aligned mapping
+ * (MAP_HUGETLB, else MADV_HUGEPAGE), cutting dTLB misses on big walks.
+ */
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+typedef enum {
+  CHUNK_HEAP,    // malloc
+  CHUNK_MAPPED,  // mmap, transparent huge pages advised
+  CHUNK_HUGETLB  // mmap from the reserved huge page pool
+} ChunkKind;
+
+typedef struct ArenaChunk {
+  struct ArenaChunk *next;
+  size_t mapping_size; // whole allocation, header included
+  size_t size;         // usable bytes after the header
+  size_t used;
+  ChunkKind kind;
+  int huge; // backed (or advised to be backed) by huge pages
+} ArenaChunk;
+
+typedef struct {
+  ArenaChunk *head;
+  int huge_pages;
+  size_t reserved;
+  size_t huge_reserved;
+} Arena;
+
 // Dynamic array for storing joints
 typedef struct {
   Joint *data;
-  int count;
-  int capacity;
+  uint32_t count;
+  uint32_t capacity;
+  Arena *arena; // NULL: heap-allocated, freed with the component
 } JointArray;
 
-// 3D Component identification
+/*
+ * Compressed outline: local x, y quantized to 16 bits within the outline's
+ * local bounding box, z implicitly 0. Decoded with one multiply-add per
+ * coordinate by component_vertex(); precision is extent / 65535.
+ */
+typedef struct {
+  double origin[2];
+  double scale[2];
+  uint16_t xy[]; // 2 per vertex
+} QuantizedOutline;
+
+/*
+ * Outline as it was added, kept for reporting once simplification merged
+ * runs of its edges: stored edge k stands for the original edges
+ * first_edge[k] up to first_edge[k + 1] (wrapping past count).
+ */
 typedef struct {
-  int id;
   Vector3D *vertices;
-  int vertex_count;
+  uint32_t *next; // as Component3D.next, for the original loops
+  uint32_t count;
+  uint32_t first_edge[]; // one per stored vertex
+} OutlineSource;
+
+/*
+ * 2D bounding volume hierarchy over an outline's edges in the local frame
+ * (edge k runs from vertex k to vertex k + 1, wrapping). Built on a
+ * component's first detection once it has EDGE_TREE_MIN_VERTICES or any arc
+ * edge, so line clipping and on-edge tests visit O(log n) nodes instead of
+ * every edge.
+ */
+#define EDGE_TREE_MIN_VERTICES 32
+#define EDGE_TREE_LEAF 4
+
+typedef struct {
+  double min[2];
+  double max[2];
+  uint32_t first; // leaf: first slot in order; inner: right child
+  uint32_t count; // leaf: edge count; inner: 0, left child follows
+} EdgeNode;
+
+typedef struct {
+  EdgeNode *nodes; // same allocation as the tree
+  uint32_t *order; // edge indices; each leaf owns a contiguous run
+  uint32_t node_count;
+} EdgeTree;
+
+// 3D Component identification
+typedef struct Component3D {
+  int id;
+  Vector3D *vertices;          // NULL when quantized
+  QuantizedOutline *quantized; // NULL unless stored compressed
+  double *bulges;              // per edge, tan(sweep / 4); NULL if straight
+  OutlineSource *source;       // NULL unless the outline was simplified
+  uint32_t *next; // end vertex of each edge with inner loops, else NULL
+  EdgeTree *edges;             // NULL for small straight outlines
+  uint32_t vertex_count;
+  double thickness; // slab across local z = 0, half each side; 0: none
+  // Phase 1 output: the union of this component's coplanar cluster in its
+  // local frame, owned here; members other than the lowest index are
+  // skipped and point back at it by index + 1
+  struct Component3D *face;
+  uint32_t merged_into;
   Matrix4x4 transform_3d;
   Matrix4x4 inverse_transform;
   Vector3D normal;
@@ -68,13 +204,53 @@ typedef struct {
   JointArray slots;
 } Component3D;
 
-// Component collection
+/*
+ * Component collection. Component, vertex and joint indices are uint32_t
+ * throughout: half the size of size_t, and with pair counts (n^2 / 2 passes
+ * INT_MAX at ~65k components) kept in 64 bits none of them can overflow.
+ */
 typedef struct {
   Component3D *components;
-  int count;
-  int capacity;
+  uint32_t count;
+  uint32_t capacity;
+  Arena *arena; // NULL: components array is heap-allocated
 } ComponentArray;
 
+/*
+ * Binary detection trace
+ *
+ * Little-endian stream: a header ("D3TR", u16 version, u16 reserved,
+ * u32 component count), one record per component (u32 id, f32 normal[3],
+ * f32 transform_3d rows 0-2 [12], u32 vertex count, f32 xyz per vertex),
+ * then a flat list of events.
+ * Pair events are 12 bytes (u8 kind, u8 result, u16 reserved, u32 i, u32 j),
+ * joint events are 32 bytes (u8 kind, u8 joint type, u16 reserved,
+ * u32 component index, f32 segment[6]). Joint events always follow the pair
+ * event that produced them. The stream ends with a single END byte.
+ */
+#define TRACE_MAGIC "D3TR"
+#define TRACE_VERSION 2
+
+typedef enum {
+  TRACE_EVENT_PAIR = 1,
+  TRACE_EVENT_JOINT = 2,
+  TRACE_EVENT_END = 3
+} TraceEventKind;
+
+// Outcome of testing one component pair
+typedef enum {
+  TRACE_PAIR_PARALLEL = 0,
+  TRACE_PAIR_COPLANAR = 1,
+  TRACE_PAIR_NO_INTERSECTION = 2,
+  TRACE_PAIR_INTERSECTION = 3
+} TracePairResult;
+
+typedef struct {
+  FILE *file;
+  unsigned long pair_events;
+  unsigned long joint_events;
+} DetectionTrace;
+
 // Function prototypes
 static inline double dot_product(const Vector3D *a, const Vector3D *b);
 static inline Vector3D cross_product(const Vector3D *a, const Vector3D *b);
@@ -95,25 +271,53 @@ static SegmentArray find_line_component_intersections(const Segment3D *line,
 static int is_segment_on_edge(const Segment3D *segment,
                               const Component3D *comp);
 
-static SegmentArray *create_segment_array(int initial_capacity);
+static void *arena_alloc(Arena *arena, size_t size);
+static void *arena_alloc_fresh(Arena *arena, size_t size);
+static void arena_reset(Arena *arena);
+static void arena_release(Arena *arena);
+
+static uint32_t grow_capacity(uint32_t capacity, uint32_t initial);
+static SegmentArray *create_segment_array(uint32_t initial_capacity);
 static void destroy_segment_array(SegmentArray *arr);
 static void add_segment(SegmentArray *arr, const Segment3D *segment);
 
-static JointArray *create_joint_array(int initial_capacity);
+static JointArray *create_joint_array(uint32_t initial_capacity);
 static void destroy_joint_array(JointArray *arr);
 static void add_joint(JointArray *arr, JointType type,
-                      const Segment3D *segment);
+                      const Segment3D *segment, double width);
 
-static ComponentArray *create_component_array(int initial_capacity);
+static ComponentArray *create_component_array(uint32_t initial_capacity);
 static void destroy_component_array(ComponentArray *arr);
 static void init_component(Component3D *comp, int id);
+static void init_component_in(Component3D *comp, int id, Arena *joints);
 static void cleanup_component(Component3D *comp);
 
-static void merge_coplanar_components(Component3D *c1, Component3D *c2);
-static void find_and_classify_intersections(ComponentArray *components);
+static DetectionTrace *trace_open(const char *path,
+                                  const ComponentArray *components);
+static int trace_close(DetectionTrace *trace);
+static void trace_pair(DetectionTrace *trace, uint32_t i, uint32_t j,
+                       TracePairResult result);
+static void trace_joint(DetectionTrace *trace, uint32_t component,
+                        JointType type, const Segment3D *segment);
+
+static int merge_coplanar_components(ComponentArray *components);
+static void count_pair(DetectionStats *stats, TracePairResult result);
+static void find_and_classify_intersections(ComponentArray *components,
+                                            DetectionTrace *trace,
+                                            DetectionStats *stats);
 int detect_component_intersections(ComponentArray *components);
+int detect_component_intersections_traced(ComponentArray *components,
+                                          const char *trace_path);
 
-int main(void) {
+static void load_flat_transform(Component3D *comp, const double *m);
+static Component3D *append_component(ComponentArray *arr, int id,
+                                     Arena *joints);
+static int collect_joints(const JointArray *arr, int component,
+                          FlatJoints *out);
+
+#ifndef DETECTION_ENGINE_NO_MAIN
+int main(int argc, char **argv) {
+  const char *trace_path = argc > 1 ? argv[1] : NULL;
   ComponentArray *components = create_component_array(10);
   if (!components) {
     fprintf(stderr,
@@ -140,7 +344,7 @@ int main(void) {
   printf("Academic 3D-Component Intersection Detection Algorithm\n");
   printf("An Expanded ANSI-C Implementation\n");
 
-  if (detect_component_intersections(components) == 0)
+  if (detect_component_intersections_traced(components, trace_path) == 0)
     printf("PASSED: Algorithm executed successfully\n");
   else
     printf("FAILED: No Dice 😔\n");
@@ -149,6 +353,7 @@ int main(void) {
 
   return 0;
 }
+#endif /* DETECTION_ENGINE_NO_MAIN */
 
 /* Vector operations */
 static inline double dot_product(const Vector3D *a, const Vector3D *b) {
@@ -219,268 +424,5558 @@ static inline Vector3D transform_point(const Matrix4x4 *matrix,
   return result;
 }
 
-/* Functions for geometric predicates */
-static int are_coplanar(const Component3D *c1, const Component3D *c2) {
-  double dot = dot_product(&c1->normal, &c2->normal);
+// Vertex v of the outline in the local frame, from whichever form holds it
+static inline Vector3D component_vertex(const Component3D *comp, uint32_t v) {
+  const QuantizedOutline *q = comp->quantized;
+  Vector3D result;
 
-  return fabs(fabs(dot) - 1.0) < EPSILON;
+  if (!q)
+    return comp->vertices[v];
+
+  result.x = q->origin[0] + q->scale[0] * q->xy[2 * v];
+  result.y = q->origin[1] + q->scale[1] * q->xy[2 * v + 1];
+  result.z = 0.0;
+
+  return result;
 }
 
-static int are_parallel(const Component3D *c1, const Component3D *c2) {
-  double dot = dot_product(&c1->normal, &c2->normal);
+// Vertex edge runs to: the next one, wrapping within its loop
+static inline uint32_t edge_end(const Component3D *comp, uint32_t edge) {
+  if (comp->next)
+    return comp->next[edge];
 
-  return fabs(fabs(dot) - 1.0) < EPSILON;
+  return edge + 1 < comp->vertex_count ? edge + 1 : 0;
 }
 
-static int components_intersect(const Component3D *c1, const Component3D *c2) {
-  return 1;
+static size_t quantized_size(uint32_t vertex_count) {
+  return sizeof(QuantizedOutline) + sizeof(uint16_t) * 2 * vertex_count;
 }
 
-static Segment3D find_intersection_line(const Component3D *c1,
-                                        const Component3D *c2) {
-  Segment3D line;
+/* Outline edge hierarchy */
+#define EDGE_TOLERANCE 1e-6
 
-  Vector3D direction = cross_product(&c1->normal, &c2->normal);
-  direction = normalise_vector(&direction);
+// How far off an edge a point still counts as on it: EDGE_TOLERANCE, plus
+// for a quantized outline the furthest rounding can move a point of an edge
+static double edge_tolerance(const Component3D *comp) {
+  const QuantizedOutline *q = comp->quantized;
 
-  line.start.x = line.start.y = line.start.z = 0.0;
-  line.end = direction;
+  if (!q)
+    return EDGE_TOLERANCE;
 
-  return line;
+  return EDGE_TOLERANCE +
+         0.5 * sqrt(q->scale[0] * q->scale[0] + q->scale[1] * q->scale[1]);
 }
+#define EDGE_TREE_MAX_DEPTH 64
 
-static SegmentArray find_line_component_intersections(const Segment3D *line,
-                                                      const Component3D *comp) {
-  SegmentArray result = {0};
+// Circular arc edge in the local frame from vertex a to b; the arc is the
+// part of the circle right of the chord a -> b for a positive bulge
+// (counterclockwise), left of it for a negative one
+typedef struct {
+  double centre[2];
+  double radius;
+  double bulge;
+} EdgeArc;
 
-  result.data = NULL;
-  result.count = 0;
-  result.capacity = 0;
+// Arc through a and b for edge's bulge (DXF convention: tan(sweep / 4));
+// returns 0 for a straight edge
+static int edge_arc(const Component3D *comp, uint32_t edge, Vector3D a,
+                    Vector3D b, EdgeArc *arc) {
+  double bulge = comp->bulges ? comp->bulges[edge] : 0.0;
+  double cx = b.x - a.x, cy = b.y - a.y;
+  double chord = sqrt(cx * cx + cy * cy), offset;
 
-  return result;
-}
+  if (fabs(bulge) < EPSILON || chord < EPSILON)
+    return 0;
+
+  // Centre sits left of the chord for a counterclockwise arc
+  offset = (1.0 - bulge * bulge) / (4.0 * bulge);
+  arc->centre[0] = 0.5 * (a.x + b.x) - cy * offset;
+  arc->centre[1] = 0.5 * (a.y + b.y) + cx * offset;
+  arc->radius = chord * (1.0 + bulge * bulge) / (4.0 * fabs(bulge));
+  arc->bulge = bulge;
 
-static int is_segment_on_edge(const Segment3D *segment,
-                              const Component3D *comp) {
   return 1;
 }
 
-/* Dynamic array allocations */
-static SegmentArray *create_segment_array(int initial_capacity) {
-  SegmentArray *arr = malloc(sizeof(SegmentArray));
+// Whether a point on the arc's circle lies on the arc itself; the chord
+// splits the circle in two, so a side test replaces any angle arithmetic
+static int arc_contains(const EdgeArc *arc, Vector3D a, Vector3D b, double x,
+                        double y) {
+  double side = (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
 
-  if (!arr)
-    return NULL;
+  return arc->bulge > 0.0 ? side < 0.0 : side > 0.0;
+}
 
-  arr->data = malloc(sizeof(Segment3D) * initial_capacity);
-  if (!arr->data) {
-    free(arr);
+static void edge_bounds(const Component3D *comp, uint32_t edge, double *min,
+                        double *max) {
+  Vector3D a = component_vertex(comp, edge);
+  Vector3D b = component_vertex(comp, edge_end(comp, edge));
+  EdgeArc arc;
+  int extreme;
 
-    return NULL;
-  }
+  min[0] = a.x < b.x ? a.x : b.x;
+  max[0] = a.x < b.x ? b.x : a.x;
+  min[1] = a.y < b.y ? a.y : b.y;
+  max[1] = a.y < b.y ? b.y : a.y;
+  if (!edge_arc(comp, edge, a, b, &arc))
+    return;
 
-  arr->count = 0;
-  arr->capacity = initial_capacity;
+  // Arcs reach past their chord at every axis extreme they pass through
+  for (extreme = 0; extreme < 4; extreme++) {
+    double sign = extreme & 1 ? -1.0 : 1.0;
+    double x = arc.centre[0] + (extreme & 2 ? 0.0 : sign * arc.radius);
+    double y = arc.centre[1] + (extreme & 2 ? sign * arc.radius : 0.0);
 
-  return arr;
+    if (!arc_contains(&arc, a, b, x, y))
+      continue;
+    min[0] = x < min[0] ? x : min[0];
+    max[0] = x > max[0] ? x : max[0];
+    min[1] = y < min[1] ? y : min[1];
+    max[1] = y > max[1] ? y : max[1];
+  }
 }
 
-static void destroy_segment_array(SegmentArray *arr) {
-  if (arr) {
-    free(arr->data);
-    free(arr);
+// Quickselect order[first, end) so the k-th smallest centre (on axis) sits
+// at k with smaller ones before it
+static void select_edges(uint32_t *order, const double *centres, int axis,
+                         uint32_t first, uint32_t end, uint32_t k) {
+  while (end - first > 1) {
+    double pivot = centres[2 * order[first + (end - first) / 2] + axis];
+    uint32_t lo = first, hi = end - 1;
+
+    while (lo <= hi) {
+      while (centres[2 * order[lo] + axis] < pivot)
+        lo++;
+      while (centres[2 * order[hi] + axis] > pivot)
+        hi--;
+      if (lo <= hi) {
+        uint32_t swap = order[lo];
+
+        order[lo] = order[hi];
+        order[hi] = swap;
+        lo++;
+        if (hi == 0)
+          break;
+        hi--;
+      }
+    }
+
+    if (k <= hi)
+      end = hi + 1;
+    else if (k >= lo)
+      first = lo;
+    else
+      return;
   }
 }
 
-static void add_segment(SegmentArray *arr, const Segment3D *segment) {
-  if (arr->count >= arr->capacity) {
-    int new_capacity = arr->capacity * 2;
-    Segment3D *new_data = realloc(arr->data, sizeof(Segment3D) * new_capacity);
+// Object-median split on the wider axis keeps the depth at log2(n)
+static uint32_t build_edge_node(EdgeTree *tree, const Component3D *comp,
+                                const double *centres, uint32_t first,
+                                uint32_t end) {
+  uint32_t index = tree->node_count++, k;
+  EdgeNode *node = &tree->nodes[index];
+  double cmin[2], cmax[2];
 
-    if (!new_data)
-      return;
+  for (k = first; k < end; k++) {
+    double min[2], max[2];
+    int axis;
 
-    arr->data = new_data;
-    arr->capacity = new_capacity;
+    edge_bounds(comp, tree->order[k], min, max);
+    for (axis = 0; axis < 2; axis++) {
+      double c = centres[2 * tree->order[k] + axis];
+
+      if (k == first || min[axis] < node->min[axis])
+        node->min[axis] = min[axis];
+      if (k == first || max[axis] > node->max[axis])
+        node->max[axis] = max[axis];
+      if (k == first || c < cmin[axis])
+        cmin[axis] = c;
+      if (k == first || c > cmax[axis])
+        cmax[axis] = c;
+    }
   }
 
-  arr->data[arr->count++] = *segment;
+  if (end - first <= EDGE_TREE_LEAF) {
+    node->first = first;
+    node->count = end - first;
+  } else {
+    uint32_t mid = first + (end - first) / 2;
+    int axis = cmax[0] - cmin[0] >= cmax[1] - cmin[1] ? 0 : 1;
+
+    select_edges(tree->order, centres, axis, first, end, mid);
+    node->count = 0;
+    build_edge_node(tree, comp, centres, first, mid);
+    // nodes[] never moves, but node may be stale after recursion
+    tree->nodes[index].first = build_edge_node(tree, comp, centres, mid, end);
+  }
+
+  return index;
 }
 
-static JointArray *create_joint_array(int initial_capacity) {
-  JointArray *arr = malloc(sizeof(JointArray));
+// NULL on allocation failure; callers fall back to scanning every edge
+static EdgeTree *build_edge_tree(const Component3D *comp) {
+  uint32_t n = comp->vertex_count, k;
+  size_t max_nodes = 2 * (size_t)n;
+  EdgeTree *tree = malloc(sizeof(EdgeTree) + sizeof(EdgeNode) * max_nodes +
+                          sizeof(uint32_t) * n);
+  double *centres = malloc(sizeof(double) * 2 * n);
 
-  if (!arr)
+  if (!tree || !centres) {
+    free(tree);
+    free(centres);
     return NULL;
+  }
 
-  arr->data = malloc(sizeof(Joint) * initial_capacity);
+  tree->nodes = (EdgeNode *)(tree + 1);
+  tree->order = (uint32_t *)(tree->nodes + max_nodes);
+  tree->node_count = 0;
+  for (k = 0; k < n; k++) {
+    double min[2], max[2];
 
-  if (!arr->data) {
-    free(arr);
+    edge_bounds(comp, k, min, max);
+    centres[2 * k] = 0.5 * (min[0] + max[0]);
+    centres[2 * k + 1] = 0.5 * (min[1] + max[1]);
+    tree->order[k] = k;
+  }
+  build_edge_node(tree, comp, centres, 0, n);
+  free(centres);
 
-    return NULL;
+  return tree;
+}
+
+// Trees are built single-threaded before a run, never inside the kernels,
+// so concurrent tiles and workers only ever read them
+static void prepare_edge_trees(ComponentArray *components) {
+  uint32_t i;
+
+  for (i = 0; i < components->count; i++) {
+    Component3D *comp = &components->components[i];
+
+    // Arcs cost more to test than a box, so curved outlines always get one
+    if (!comp->edges && comp->vertex_count > 0 &&
+        (comp->vertex_count >= EDGE_TREE_MIN_VERTICES || comp->bulges))
+      comp->edges = build_edge_tree(comp);
   }
+}
 
-  arr->count = 0;
-  arr->capacity = initial_capacity;
+typedef int (*EdgeBoxTest)(const void *query, const double *min,
+                           const double *max);
+typedef int (*EdgeVisit)(void *user, uint32_t edge);
 
-  return arr;
+// Visits edges whose boxes pass test, or every edge without a tree; a
+// nonzero return from visit stops the walk
+static void walk_edges(const Component3D *comp, EdgeBoxTest test,
+                       const void *query, EdgeVisit visit, void *user) {
+  const EdgeTree *tree = comp->edges;
+  uint32_t stack[EDGE_TREE_MAX_DEPTH];
+  int top = 0;
+
+  if (!tree) {
+    uint32_t k;
+
+    for (k = 0; k < comp->vertex_count; k++)
+      if (visit(user, k))
+        return;
+    return;
+  }
+
+  stack[top++] = 0;
+  while (top > 0) {
+    const EdgeNode *node = &tree->nodes[stack[--top]];
+    uint32_t k;
+
+    if (!test(query, node->min, node->max))
+      continue;
+    if (node->count == 0) {
+      stack[top++] = node->first;
+      stack[top++] = (uint32_t)(node - tree->nodes) + 1;
+      continue;
+    }
+    for (k = node->first; k < node->first + node->count; k++)
+      if (visit(user, tree->order[k]))
+        return;
+  }
 }
 
-static void destroy_joint_array(JointArray *arr) {
-  if (arr) {
-    free(arr->data);
-    free(arr);
+// Infinite 2D line through origin along direction
+typedef struct {
+  double origin[2];
+  double direction[2];
+  double length;    // |direction|
+  double tolerance; // edge_tolerance() of the outline it is clipped to
+} EdgeLine;
+
+static double line_side(const EdgeLine *line, double x, double y) {
+  return (line->direction[0] * (y - line->origin[1]) -
+          line->direction[1] * (x - line->origin[0])) /
+         line->length;
+}
+
+static int line_crosses_box(const void *query, const double *min,
+                            const double *max) {
+  const EdgeLine *line = query;
+  double s[4], lo, hi;
+  int c;
+
+  s[0] = line_side(line, min[0], min[1]);
+  s[1] = line_side(line, max[0], min[1]);
+  s[2] = line_side(line, min[0], max[1]);
+  s[3] = line_side(line, max[0], max[1]);
+  lo = hi = s[0];
+  for (c = 1; c < 4; c++) {
+    if (s[c] < lo)
+      lo = s[c];
+    if (s[c] > hi)
+      hi = s[c];
   }
+
+  return lo <= line->tolerance && hi >= -line->tolerance;
 }
 
-static void add_joint(JointArray *arr, JointType type,
-                      const Segment3D *segment) {
-  if (arr->count >= arr->capacity) {
-    int new_capacity = arr->capacity * 2;
-    Joint *new_data = realloc(arr->data, sizeof(Joint) * new_capacity);
+typedef struct {
+  const Component3D *comp;
+  const EdgeLine *line;
+  double bias;  // vertices up to this far above the line count as below
+  int touching; // some vertex lies within the line's tolerance of it
+  double *params;
+  uint32_t count;
+  uint32_t capacity;
+  int failed;
+} LineClip;
 
-    if (!new_data)
-      return;
+// Records where the line meets it at (x, y); returns -1 when out of memory
+static int clip_push(LineClip *clip, double x, double y) {
+  const EdgeLine *line = clip->line;
 
-    arr->data = new_data;
-    arr->capacity = new_capacity;
+  if (clip->count == clip->capacity) {
+    uint32_t capacity = grow_capacity(clip->capacity, 8);
+    double *params =
+        capacity ? realloc(clip->params, sizeof(double) * capacity) : NULL;
+
+    if (!params) {
+      clip->failed = 1;
+      return -1;
+    }
+    clip->params = params;
+    clip->capacity = capacity;
   }
 
-  arr->data[arr->count].type = type;
-  arr->data[arr->count].segment = *segment;
-  arr->count++;
+  x -= line->origin[0];
+  y -= line->origin[1];
+  clip->params[clip->count++] =
+      (x * line->direction[0] + y * line->direction[1]) /
+      (line->length * line->length);
+
+  return 0;
 }
 
-/* Manage components */
-static ComponentArray *create_component_array(int initial_capacity) {
-  ComponentArray *arr = malloc(sizeof(ComponentArray));
+// Arc version of the crossing rule below. A line meeting a circle at two
+// points crosses it at both, so every such point strictly inside the arc
+// flips the side the arc is on; the end vertices add a crossing where
+// their own side differs from the arc's next to them.
+static int clip_arc(LineClip *clip, const EdgeArc *arc, Vector3D a,
+                    Vector3D b, double sa, double sb) {
+  const EdgeLine *line = clip->line;
+  double ox = line->origin[0] - arc->centre[0];
+  double oy = line->origin[1] - arc->centre[1];
+  double qa = line->length * line->length;
+  double qb = 2.0 * (ox * line->direction[0] + oy * line->direction[1]);
+  double qc = ox * ox + oy * oy - arc->radius * arc->radius;
+  double disc = qb * qb - 4.0 * qa * qc;
+  int above = sa > clip->bias, k;
 
-  if (!arr)
-    return NULL;
+  // Leaving a vertex on the line, the arc heads along its tangent, or
+  // towards its centre when the tangent runs along the line
+  if (fabs(sa) <= line->tolerance) {
+    double tx = (arc->centre[1] - a.y) * (arc->bulge > 0.0 ? 1.0 : -1.0);
+    double ty = (a.x - arc->centre[0]) * (arc->bulge > 0.0 ? 1.0 : -1.0);
+    double turn = (line->direction[0] * ty - line->direction[1] * tx) /
+                  (line->length * arc->radius);
 
-  arr->components = malloc(sizeof(Component3D) * initial_capacity);
+    above = fabs(turn) > EPSILON
+                ? turn > 0.0
+                : line_side(line, arc->centre[0], arc->centre[1]) > 0.0;
+    if (above != (sa > clip->bias) && clip_push(clip, a.x, a.y) != 0)
+      return 1;
+  }
 
-  if (!arr->components) {
-    free(arr);
+  // A tangent line touches without crossing
+  if (disc > 0.0) {
+    double root = sqrt(disc);
 
-    return NULL;
+    for (k = -1; k <= 1; k += 2) {
+      double t = (-qb + k * root) / (2.0 * qa);
+      double x = line->origin[0] + line->direction[0] * t;
+      double y = line->origin[1] + line->direction[1] * t;
+      double dax = x - a.x, day = y - a.y, dbx = x - b.x, dby = y - b.y;
+
+      // Meetings at an end vertex are settled by the sides around it
+      if (dax * dax + day * day <= line->tolerance * line->tolerance ||
+          dbx * dbx + dby * dby <= line->tolerance * line->tolerance ||
+          !arc_contains(arc, a, b, x, y))
+        continue;
+      if (clip_push(clip, x, y) != 0)
+        return 1;
+      above = !above;
+    }
   }
 
-  arr->count = 0;
-  arr->capacity = initial_capacity;
+  if (above != (sb > clip->bias) && clip_push(clip, b.x, b.y) != 0)
+    return 1;
 
-  return arr;
+  return 0;
 }
 
-static void destroy_component_array(ComponentArray *arr) {
-  if (arr) {
-    int i;
+// Even-odd crossing of the line with one edge; a vertex on the line counts
+// as below or above it by the clip's bias, so crossings through vertices
+// are counted once
+static int clip_edge(void *user, uint32_t edge) {
+  LineClip *clip = user;
+  Vector3D a = component_vertex(clip->comp, edge);
+  Vector3D b = component_vertex(clip->comp, edge_end(clip->comp, edge));
+  double sa = line_side(clip->line, a.x, a.y);
+  double sb = line_side(clip->line, b.x, b.y);
+  double f;
+  EdgeArc arc;
 
-    for (i = 0; i < arr->count; i++)
-      cleanup_component(&arr->components[i]);
+  if (fabs(sa) <= clip->line->tolerance || fabs(sb) <= clip->line->tolerance)
+    clip->touching = 1;
+  if (edge_arc(clip->comp, edge, a, b, &arc))
+    return clip_arc(clip, &arc, a, b, sa, sb);
+  if ((sa > clip->bias) == (sb > clip->bias))
+    return 0;
 
-    free(arr->components);
-    free(arr);
-  }
+  // Sides of one sign only differ by the bias: the crossing is the vertex
+  f = sa / (sa - sb);
+  f = f < 0.0 ? 0.0 : f > 1.0 ? 1.0 : f;
+
+  return clip_push(clip, a.x + (b.x - a.x) * f, a.y + (b.y - a.y) * f) != 0;
 }
 
-static void init_component(Component3D *comp, int id) {
-  comp->id = id;
-  comp->vertices = NULL;
-  comp->vertex_count = 0;
+static int compare_doubles(const void *a, const void *b) {
+  double da = *(const double *)a, db = *(const double *)b;
 
-  memset(&comp->transform_3d, 0, sizeof(Matrix4x4));
-  memset(&comp->inverse_transform, 0, sizeof(Matrix4x4));
+  return da < db ? -1 : da > db ? 1 : 0;
+}
 
-  comp->normal.x = comp->normal.y = 0.0;
-  comp->normal.z = 1.0;
+typedef struct {
+  const Component3D *comp;
+  double point[2];
+  double tolerance; // edge_tolerance() of comp
+  int found;
+  uint32_t edge; // valid once found
+} EdgeProbe;
+
+static int probe_in_box(const void *query, const double *min,
+                        const double *max) {
+  const EdgeProbe *probe = query;
 
-  comp->fingers.data = malloc(sizeof(Joint) * 10);
-  comp->fingers.count = 0;
-  comp->fingers.capacity = 10;
+  return probe->point[0] >= min[0] - probe->tolerance &&
+         probe->point[0] <= max[0] + probe->tolerance &&
+         probe->point[1] >= min[1] - probe->tolerance &&
+         probe->point[1] <= max[1] + probe->tolerance;
+}
+
+// Squared distance in the local xy plane from (x, y) to the segment a b
+static double segment_distance2(Vector3D a, Vector3D b, double x, double y) {
+  double ex = b.x - a.x, ey = b.y - a.y;
+  double px = x - a.x, py = y - a.y;
+  double length2 = ex * ex + ey * ey, t = 0.0, dx, dy;
 
-  comp->holes.data = malloc(sizeof(Joint) * 10);
-  comp->holes.count = 0;
-  comp->holes.capacity = 10;
+  if (length2 > 0.0) {
+    t = (px * ex + py * ey) / length2;
+    t = t < 0.0 ? 0.0 : t > 1.0 ? 1.0 : t;
+  }
+  dx = px - ex * t;
+  dy = py - ey * t;
 
-  comp->slots.data = malloc(sizeof(Joint) * 10);
-  comp->slots.count = 0;
-  comp->slots.capacity = 10;
+  return dx * dx + dy * dy;
 }
 
-static void cleanup_component(Component3D *comp) {
-  free(comp->vertices);
-  free(comp->fingers.data);
-  free(comp->holes.data);
-  free(comp->slots.data);
+// Stops the walk once the probe is within tolerance of the edge
+static int probe_on_edge(void *user, uint32_t edge) {
+  EdgeProbe *probe = user;
+  Vector3D a = component_vertex(probe->comp, edge);
+  Vector3D b = component_vertex(probe->comp, edge_end(probe->comp, edge));
+  EdgeArc arc;
+
+  if (edge_arc(probe->comp, edge, a, b, &arc)) {
+    double rx = probe->point[0] - arc.centre[0];
+    double ry = probe->point[1] - arc.centre[1];
+    double px = probe->point[0] - a.x, py = probe->point[1] - a.y;
+    double qx = probe->point[0] - b.x, qy = probe->point[1] - b.y;
+    double distance;
+
+    // Radial distance inside the arc's wedge, else the nearer end vertex
+    if (arc_contains(&arc, a, b, probe->point[0], probe->point[1]))
+      distance = fabs(sqrt(rx * rx + ry * ry) - arc.radius);
+    else
+      distance = sqrt(px * px + py * py < qx * qx + qy * qy
+                          ? px * px + py * py
+                          : qx * qx + qy * qy);
+    probe->found = distance <= probe->tolerance;
+  } else {
+    probe->found = segment_distance2(a, b, probe->point[0], probe->point[1]) <=
+                   probe->tolerance * probe->tolerance;
+  }
+  probe->edge = edge;
+
+  return probe->found;
 }
 
-/* Core algorithm functions */
-static void merge_coplanar_components(Component3D *c1, Component3D *c2) {
-  if (!are_coplanar(c1, c2) || !components_intersect(c1, c2))
-    return;
+static int point_on_outline(const Component3D *comp, double x, double y) {
+  EdgeProbe probe;
+
+  probe.comp = comp;
+  probe.tolerance = edge_tolerance(comp);
+  probe.point[0] = x;
+  probe.point[1] = y;
+  probe.found = 0;
+  walk_edges(comp, probe_in_box, &probe, probe_on_edge, &probe);
+
+  return probe.found;
 }
 
-static void find_and_classify_intersections(ComponentArray *components) {
-  int i, j, k;
+static int ray_in_box(const void *query, const double *min,
+                      const double *max) {
+  const EdgeProbe *probe = query;
 
-  for (i = 0; i < components->count; i++) {
-    Component3D *ci = &components->components[i];
-
-    for (j = i + 1; j < components->count; j++) {
-      Component3D *cj = &components->components[j];
-
-      if (are_coplanar(ci, cj) && components_intersect(ci, cj)) {
-        merge_coplanar_components(ci, cj);
-      } else if (!are_coplanar(ci, cj) && !are_parallel(ci, cj)) {
-        Segment3D intersection_line = find_intersection_line(ci, cj);
-
-        SegmentArray segments_i =
-            find_line_component_intersections(&intersection_line, ci);
-        SegmentArray segments_j =
-            find_line_component_intersections(&intersection_line, cj);
-
-        for (k = 0; k < segments_i.count && k < segments_j.count; k++) {
-          Segment3D seg_i = segments_i.data[k];
-          Segment3D seg_j = segments_j.data[k];
-
-          seg_i.start = transform_point(&ci->inverse_transform, &seg_i.start);
-          seg_i.end = transform_point(&ci->inverse_transform, &seg_i.end);
-          seg_j.start = transform_point(&cj->inverse_transform, &seg_j.start);
-          seg_j.end = transform_point(&cj->inverse_transform, &seg_j.end);
-
-          int i_on_edge = is_segment_on_edge(&seg_i, ci);
-          int j_on_edge = is_segment_on_edge(&seg_j, cj);
-
-          if (i_on_edge && j_on_edge) {
-            add_joint(&ci->fingers, FINGER_JOINT, &seg_i);
-            add_joint(&cj->fingers, FINGER_JOINT, &seg_j);
-          } else if (i_on_edge && !j_on_edge) {
-            add_joint(&ci->fingers, FINGER_JOINT, &seg_i);
-            add_joint(&cj->holes, HOLE_JOINT, &seg_j);
-          } else if (!i_on_edge && j_on_edge) {
-            add_joint(&ci->holes, HOLE_JOINT, &seg_i);
-            add_joint(&cj->fingers, FINGER_JOINT, &seg_j);
-          } else {
-            add_joint(&ci->slots, SLOT_JOINT, &seg_i);
-            add_joint(&cj->slots, SLOT_JOINT, &seg_j);
-          }
-        }
+  return max[0] >= probe->point[0] && min[1] <= probe->point[1] &&
+         max[1] >= probe->point[1];
+}
 
-        free(segments_i.data);
-        free(segments_j.data);
-      }
-    }
+// Even-odd count of edges crossed by a ray to +x. An arc crosses the ray
+// as often as its chord does, give or take one when the point sits in the
+// circular segment between them, which the chord and arc together enclose
+static int ray_crosses_edge(void *user, uint32_t edge) {
+  EdgeProbe *probe = user;
+  Vector3D a = component_vertex(probe->comp, edge);
+  Vector3D b = component_vertex(probe->comp, edge_end(probe->comp, edge));
+  EdgeArc arc;
+
+  if ((a.y > probe->point[1]) != (b.y > probe->point[1]) &&
+      a.x + (probe->point[1] - a.y) * (b.x - a.x) / (b.y - a.y) >
+          probe->point[0])
+    probe->found ^= 1;
+  if (edge_arc(probe->comp, edge, a, b, &arc)) {
+    double rx = probe->point[0] - arc.centre[0];
+    double ry = probe->point[1] - arc.centre[1];
+
+    if (rx * rx + ry * ry < arc.radius * arc.radius &&
+        arc_contains(&arc, a, b, probe->point[0], probe->point[1]))
+      probe->found ^= 1;
   }
+
+  return 0;
 }
 
-// Algo starting point
-int detect_component_intersections(ComponentArray *components) {
-  if (!components || components->count == 0)
+// Inside an outline (every loop, even-odd, arcs included) in the local xy
+// plane
+static int point_in_outline(const Component3D *comp, double x, double y) {
+  EdgeProbe probe;
+
+  probe.comp = comp;
+  probe.tolerance = edge_tolerance(comp);
+  probe.point[0] = x;
+  probe.point[1] = y;
+  probe.found = 0;
+  walk_edges(comp, ray_in_box, &probe, ray_crosses_edge, &probe);
+
+  return probe.found;
+}
+
+// Whether segments a b and c d meet, touching within EDGE_TOLERANCE counts
+static int segments_meet(const double *a, const double *b, const double *c,
+                         const double *d) {
+  double ex = b[0] - a[0], ey = b[1] - a[1];
+  double fx = d[0] - c[0], fy = d[1] - c[1];
+  double le = sqrt(ex * ex + ey * ey), lf = sqrt(fx * fx + fy * fy);
+  double sc, sd, sa, sb, tc, td;
+
+  if (le < EPSILON || lf < EPSILON)
+    return 0;
+
+  // Signed distances of each segment's ends from the other's line
+  sc = (ex * (c[1] - a[1]) - ey * (c[0] - a[0])) / le;
+  sd = (ex * (d[1] - a[1]) - ey * (d[0] - a[0])) / le;
+  sa = (fx * (a[1] - c[1]) - fy * (a[0] - c[0])) / lf;
+  sb = (fx * (b[1] - c[1]) - fy * (b[0] - c[0])) / lf;
+  if ((sc > EDGE_TOLERANCE && sd > EDGE_TOLERANCE) ||
+      (sc < -EDGE_TOLERANCE && sd < -EDGE_TOLERANCE) ||
+      (sa > EDGE_TOLERANCE && sb > EDGE_TOLERANCE) ||
+      (sa < -EDGE_TOLERANCE && sb < -EDGE_TOLERANCE))
+    return 0;
+  if (fabs(sc) > EDGE_TOLERANCE || fabs(sd) > EDGE_TOLERANCE)
+    return 1;
+
+  // Collinear: the projections onto a b must overlap
+  tc = (ex * (c[0] - a[0]) + ey * (c[1] - a[1])) / le;
+  td = (ex * (d[0] - a[0]) + ey * (d[1] - a[1])) / le;
+
+  return (tc > td ? tc : td) >= -EDGE_TOLERANCE &&
+         (tc < td ? tc : td) <= le + EDGE_TOLERANCE;
+}
+
+typedef struct {
+  const Component3D *comp;
+  double min[2]; // segment box, padded by EDGE_TOLERANCE
+  double max[2];
+  double a[2];
+  double b[2];
+  int found;
+} SegmentProbe;
+
+static int segment_in_box(const void *query, const double *min,
+                          const double *max) {
+  const SegmentProbe *probe = query;
+
+  return probe->min[0] <= max[0] && probe->max[0] >= min[0] &&
+         probe->min[1] <= max[1] && probe->max[1] >= min[1];
+}
+
+static int segment_meets_edge(void *user, uint32_t edge) {
+  SegmentProbe *probe = user;
+  Vector3D a = component_vertex(probe->comp, edge);
+  Vector3D b = component_vertex(probe->comp, edge_end(probe->comp, edge));
+  double c[2], d[2];
+
+  c[0] = a.x;
+  c[1] = a.y;
+  d[0] = b.x;
+  d[1] = b.y;
+  probe->found = segments_meet(probe->a, probe->b, c, d);
+
+  return probe->found;
+}
+
+// Vertex v of comp in the local frame of other, which shares its plane
+static Vector3D vertex_in_frame(const Component3D *comp, uint32_t v,
+                                const Component3D *other) {
+  Vector3D p = component_vertex(comp, v);
+
+  p = transform_point(&comp->transform_3d, &p);
+
+  return transform_point(&other->inverse_transform, &p);
+}
+
+/* Functions for geometric predicates */
+
+// Parallel normals and the same plane offset
+static int are_coplanar(const Component3D *c1, const Component3D *c2) {
+  double dot = dot_product(&c1->normal, &c2->normal);
+  Vector3D p1 = {c1->transform_3d.m[0][3], c1->transform_3d.m[1][3],
+                 c1->transform_3d.m[2][3]};
+  Vector3D p2 = {c2->transform_3d.m[0][3], c2->transform_3d.m[1][3],
+                 c2->transform_3d.m[2][3]};
+  Vector3D d = subtract_vectors(&p2, &p1);
+
+  return fabs(fabs(dot) - 1.0) < EPSILON &&
+         fabs(dot_product(&c1->normal, &d)) < EDGE_TOLERANCE;
+}
+
+static int are_parallel(const Component3D *c1, const Component3D *c2) {
+  double dot = dot_product(&c1->normal, &c2->normal);
+
+  return fabs(fabs(dot) - 1.0) < EPSILON;
+}
+
+// Whether two coplanar straight outlines overlap or touch: an edge of one
+// meets an edge of the other, or one lies inside the other
+static int components_intersect(const Component3D *c1, const Component3D *c2) {
+  SegmentProbe probe;
+  Vector3D p;
+  uint32_t k;
+
+  if (c1->vertex_count == 0 || c2->vertex_count == 0)
+    return 0;
+
+  probe.comp = c1;
+  probe.found = 0;
+  for (k = 0; k < c2->vertex_count && !probe.found; k++) {
+    Vector3D a = vertex_in_frame(c2, k, c1);
+    Vector3D b = vertex_in_frame(c2, edge_end(c2, k), c1);
+
+    probe.a[0] = a.x;
+    probe.a[1] = a.y;
+    probe.b[0] = b.x;
+    probe.b[1] = b.y;
+    probe.min[0] = (a.x < b.x ? a.x : b.x) - EDGE_TOLERANCE;
+    probe.max[0] = (a.x < b.x ? b.x : a.x) + EDGE_TOLERANCE;
+    probe.min[1] = (a.y < b.y ? a.y : b.y) - EDGE_TOLERANCE;
+    probe.max[1] = (a.y < b.y ? b.y : a.y) + EDGE_TOLERANCE;
+    walk_edges(c1, segment_in_box, &probe, segment_meets_edge, &probe);
+  }
+  if (probe.found)
+    return 1;
+
+  // No crossing: they overlap only if one contains the other
+  p = vertex_in_frame(c2, 0, c1);
+  if (point_in_outline(c1, p.x, p.y))
+    return 1;
+  p = vertex_in_frame(c1, 0, c2);
+
+  return point_in_outline(c2, p.x, p.y);
+}
+
+// Line common to both planes, passing through the point on it nearest the
+// world origin; start and end are one unit apart
+static Segment3D find_intersection_line(const Component3D *c1,
+                                        const Component3D *c2) {
+  Segment3D line;
+  Vector3D direction = cross_product(&c1->normal, &c2->normal);
+  Vector3D p1 = {c1->transform_3d.m[0][3], c1->transform_3d.m[1][3],
+                 c1->transform_3d.m[2][3]};
+  Vector3D p2 = {c2->transform_3d.m[0][3], c2->transform_3d.m[1][3],
+                 c2->transform_3d.m[2][3]};
+  double h1 = dot_product(&c1->normal, &p1);
+  double h2 = dot_product(&c2->normal, &p2);
+  double length2 = dot_product(&direction, &direction);
+  Vector3D a = cross_product(&c2->normal, &direction);
+  Vector3D b = cross_product(&direction, &c1->normal);
+
+  line.start.x = line.start.y = line.start.z = 0.0;
+  if (length2 > EPSILON) {
+    line.start.x = (h1 * a.x + h2 * b.x) / length2;
+    line.start.y = (h1 * a.y + h2 * b.y) / length2;
+    line.start.z = (h1 * a.z + h2 * b.z) / length2;
+  }
+  direction = normalise_vector(&direction);
+  line.end = add_vectors(&line.start, &direction);
+
+  return line;
+}
+
+// Appends the part of line between parameters t0 and t1 unless it is empty
+static void add_line_piece(SegmentArray *result, const Segment3D *line,
+                           double t0, double t1) {
+  Vector3D direction = subtract_vectors(&line->end, &line->start);
+  Segment3D piece;
+
+  if (t1 - t0 < EPSILON)
+    return;
+  piece.start.x = line->start.x + direction.x * t0;
+  piece.start.y = line->start.y + direction.y * t0;
+  piece.start.z = line->start.z + direction.z * t0;
+  piece.end.x = line->start.x + direction.x * t1;
+  piece.end.y = line->start.y + direction.y * t1;
+  piece.end.z = line->start.z + direction.z * t1;
+  add_segment(result, &piece);
+}
+
+// Pieces of the line inside the outline, in world space and ordered along
+// the line. Crossings of every loop go into one list sorted once, so inner
+// loops cut holes by the even-odd rule. Empty if the line misses the
+// outline or leaves its plane.
+static SegmentArray find_line_component_intersections(const Segment3D *line,
+                                                      const Component3D *comp) {
+  SegmentArray result = {0};
+  Vector3D start = transform_point(&comp->inverse_transform, &line->start);
+  Vector3D end = transform_point(&comp->inverse_transform, &line->end);
+  EdgeLine local;
+  LineClip clip[2];
+  uint32_t next[2] = {0, 0};
+  double t0 = 0.0, t1 = 0.0;
+  int pass, open = 0;
+
+  result.data = NULL;
+  result.count = 0;
+  result.capacity = 0;
+
+  local.origin[0] = start.x;
+  local.origin[1] = start.y;
+  local.direction[0] = end.x - start.x;
+  local.direction[1] = end.y - start.y;
+  local.length = sqrt(local.direction[0] * local.direction[0] +
+                      local.direction[1] * local.direction[1]);
+  local.tolerance = edge_tolerance(comp);
+  // Two arcs already enclose an area, two straight edges do not
+  if (comp->vertex_count < (comp->bulges ? 2u : 3u) ||
+      local.length < EPSILON || fabs(start.z) > EDGE_TOLERANCE ||
+      fabs(end.z) > EDGE_TOLERANCE)
+    return result;
+
+  // Vertices on the line count as below it, then, if the line touches the
+  // outline at all, as above it: the union of both passes keeps runs along
+  // the boundary whichever side the material is on
+  for (pass = 0; pass < 2; pass++) {
+    clip[pass].comp = comp;
+    clip[pass].line = &local;
+    clip[pass].bias = pass ? -local.tolerance : local.tolerance;
+    clip[pass].touching = 0;
+    clip[pass].params = NULL;
+    clip[pass].count = clip[pass].capacity = 0;
+    clip[pass].failed = 0;
+    if (pass == 0 || clip[0].touching)
+      walk_edges(comp, line_crosses_box, &local, clip_edge, &clip[pass]);
+    if (clip[pass].count > 1)
+      qsort(clip[pass].params, clip[pass].count, sizeof(double),
+            compare_doubles);
+  }
+
+  // Merge the inside intervals of both passes in order along the line
+  while (!clip[0].failed && !clip[1].failed) {
+    int from = -1;
+
+    for (pass = 0; pass < 2; pass++)
+      if (next[pass] + 1 < clip[pass].count &&
+          (from < 0 ||
+           clip[pass].params[next[pass]] < clip[from].params[next[from]]))
+        from = pass;
+    if (from < 0)
+      break;
+
+    if (open && clip[from].params[next[from]] <= t1 + EPSILON) {
+      if (clip[from].params[next[from] + 1] > t1)
+        t1 = clip[from].params[next[from] + 1];
+    } else {
+      if (open)
+        add_line_piece(&result, line, t0, t1);
+      t0 = clip[from].params[next[from]];
+      t1 = clip[from].params[next[from] + 1];
+      open = 1;
+    }
+    next[from] += 2;
+  }
+  if (open && !clip[0].failed && !clip[1].failed)
+    add_line_piece(&result, line, t0, t1);
+  free(clip[0].params);
+  free(clip[1].params);
+
+  return result;
+}
+
+// Original outline edge (as added, before simplification) that a segment
+// along the outline runs on, found from its midpoint; -1 if it is not on
+// the outline
+static int source_edge(const Component3D *comp, const Segment3D *segment) {
+  const OutlineSource *source = comp->source;
+  EdgeProbe probe;
+  uint32_t edge, stop, best, steps;
+  double best_distance = HUGE_VAL;
+
+  probe.comp = comp;
+  probe.tolerance = edge_tolerance(comp);
+  probe.point[0] = 0.5 * (segment->start.x + segment->end.x);
+  probe.point[1] = 0.5 * (segment->start.y + segment->end.y);
+  probe.found = 0;
+  walk_edges(comp, probe_in_box, &probe, probe_on_edge, &probe);
+  if (!probe.found)
+    return -1;
+  if (!source)
+    return (int)probe.edge;
+
+  // Merged originals all lie within the tolerance of the stored edge, so
+  // the nearest of them is the one the joint runs along
+  edge = best = source->first_edge[probe.edge];
+  stop = source->first_edge[edge_end(comp, probe.edge)];
+  for (steps = 0; steps < source->count; steps++) {
+    uint32_t end = source->next ? source->next[edge]
+                   : edge + 1 < source->count ? edge + 1
+                                              : 0;
+    double distance =
+        segment_distance2(source->vertices[edge], source->vertices[end],
+                          probe.point[0], probe.point[1]);
+
+    if (distance < best_distance) {
+      best_distance = distance;
+      best = edge;
+    }
+    edge = end;
+    if (edge == stop)
+      break;
+  }
+
+  return (int)best;
+}
+
+// Segment (local frame) lies along the outline if both ends and its midpoint
+// are within edge_tolerance() of some edge
+static int is_segment_on_edge(const Segment3D *segment,
+                              const Component3D *comp) {
+  double mx = 0.5 * (segment->start.x + segment->end.x);
+  double my = 0.5 * (segment->start.y + segment->end.y);
+
+  return point_on_outline(comp, segment->start.x, segment->start.y) &&
+         point_on_outline(comp, mx, my) &&
+         point_on_outline(comp, segment->end.x, segment->end.y);
+}
+
+/* Arenas */
+#define ARENA_ALIGN 64
+#define ARENA_HEADER                                                           \
+  ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+#ifdef DETECTION_HUGE_PAGES
+// 2 MB aligned anonymous mapping: the reserved huge page pool if the system
+// has one, otherwise an over-mapped window trimmed to alignment with
+// transparent huge pages advised. Returns NULL if both mmaps fail.
+static void *map_huge(size_t size, ChunkKind *kind, int *huge) {
+  size_t span = size + HUGE_PAGE_SIZE;
+  char *raw, *aligned;
+  void *mapping;
+
+  mapping = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (mapping != MAP_FAILED) {
+    *kind = CHUNK_HUGETLB;
+    *huge = 1;
+    return mapping;
+  }
+
+  raw = mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+             -1, 0);
+  if (raw == MAP_FAILED)
+    return NULL;
+
+  aligned = (char *)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1) &
+                     ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+  if (aligned > raw)
+    munmap(raw, aligned - raw);
+  if (raw + span > aligned + size)
+    munmap(aligned + size, raw + span - (aligned + size));
+
+  *kind = CHUNK_MAPPED;
+  *huge = madvise(aligned, size, MADV_HUGEPAGE) == 0;
+  return aligned;
+}
+#endif
+
+static ArenaChunk *arena_new_chunk(Arena *arena, size_t min_size) {
+  size_t size = ARENA_HEADER + min_size;
+  ChunkKind kind = CHUNK_HEAP;
+  ArenaChunk *chunk = NULL;
+  int huge = 0;
+
+#ifdef DETECTION_HUGE_PAGES
+  if (arena->huge_pages) {
+    size = (size + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+    chunk = map_huge(size, &kind, &huge);
+  }
+#endif
+
+  if (!chunk) {
+    if (size < ARENA_CHUNK_SIZE)
+      size = ARENA_CHUNK_SIZE;
+    chunk = malloc(size);
+    if (!chunk)
+      return NULL;
+    kind = CHUNK_HEAP;
+  }
+
+  chunk->next = arena->head;
+  chunk->mapping_size = size;
+  chunk->size = size - ARENA_HEADER;
+  chunk->used = 0;
+  chunk->kind = kind;
+  chunk->huge = huge;
+  arena->head = chunk;
+  arena->reserved += size;
+  if (huge)
+    arena->huge_reserved += size;
+
+  return chunk;
+}
+
+static void arena_free_chunk(ArenaChunk *chunk) {
+#ifdef DETECTION_HUGE_PAGES
+  if (chunk->kind != CHUNK_HEAP) {
+    munmap(chunk, chunk->mapping_size);
+    return;
+  }
+#endif
+  free(chunk);
+}
+
+// Cache-line aligned; NULL on allocation failure
+static void *arena_alloc(Arena *arena, size_t size) {
+  ArenaChunk *chunk = arena->head;
+
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  if (!chunk || chunk->size - chunk->used < size) {
+    chunk = arena_new_chunk(arena, size > ARENA_CHUNK_SIZE ? size
+                                                           : ARENA_CHUNK_SIZE);
+    if (!chunk)
+      return NULL;
+  }
+
+  chunk->used += size;
+  return (char *)chunk + ARENA_HEADER + chunk->used - size;
+}
+
+// From a new chunk whose pages nobody has touched yet (bar the header), so
+// whichever thread writes them first decides their NUMA node
+static void *arena_alloc_fresh(Arena *arena, size_t size) {
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  if (!arena_new_chunk(arena, size))
+    return NULL;
+
+  return arena_alloc(arena, size);
+}
+
+// Keeps the newest chunk for reuse and releases the rest
+static void arena_reset(Arena *arena) {
+  ArenaChunk *keep = arena->head;
+
+  if (!keep)
+    return;
+
+  arena->head = keep->next;
+  arena_release(arena);
+
+  keep->next = NULL;
+  keep->used = 0;
+  arena->head = keep;
+  arena->reserved = keep->mapping_size;
+  arena->huge_reserved = keep->huge ? keep->mapping_size : 0;
+}
+
+static void arena_release(Arena *arena) {
+  while (arena->head) {
+    ArenaChunk *next = arena->head->next;
+
+    arena_free_chunk(arena->head);
+    arena->head = next;
+  }
+  arena->reserved = arena->huge_reserved = 0;
+}
+
+/* Dynamic array allocations */
+
+// Doubled capacity (initial when empty), or 0 once it would pass UINT32_MAX
+static uint32_t grow_capacity(uint32_t capacity, uint32_t initial) {
+  if (capacity == 0)
+    return initial;
+
+  return capacity <= UINT32_MAX / 2 ? capacity * 2 : 0;
+}
+static SegmentArray *create_segment_array(uint32_t initial_capacity) {
+  SegmentArray *arr = malloc(sizeof(SegmentArray));
+
+  if (!arr)
+    return NULL;
+
+  arr->data = malloc(sizeof(Segment3D) * initial_capacity);
+  if (!arr->data) {
+    free(arr);
+
+    return NULL;
+  }
+
+  arr->count = 0;
+  arr->capacity = initial_capacity;
+
+  return arr;
+}
+
+static void destroy_segment_array(SegmentArray *arr) {
+  if (arr) {
+    free(arr->data);
+    free(arr);
+  }
+}
+
+static void add_segment(SegmentArray *arr, const Segment3D *segment) {
+  if (arr->count >= arr->capacity) {
+    uint32_t new_capacity = grow_capacity(arr->capacity, 8);
+    Segment3D *new_data;
+
+    // A saturated capacity of 0 must not reach realloc, which would free
+    if (!new_capacity)
+      return;
+    new_data = realloc(arr->data, sizeof(Segment3D) * new_capacity);
+    if (!new_data)
+      return;
+
+    arr->data = new_data;
+    arr->capacity = new_capacity;
+  }
+
+  arr->data[arr->count++] = *segment;
+}
+
+static JointArray *create_joint_array(uint32_t initial_capacity) {
+  JointArray *arr = malloc(sizeof(JointArray));
+
+  if (!arr)
+    return NULL;
+
+  arr->data = malloc(sizeof(Joint) * initial_capacity);
+
+  if (!arr->data) {
+    free(arr);
+
+    return NULL;
+  }
+
+  arr->count = 0;
+  arr->capacity = initial_capacity;
+  arr->arena = NULL;
+
+  return arr;
+}
+
+static void destroy_joint_array(JointArray *arr) {
+  if (arr) {
+    free(arr->data);
+    free(arr);
+  }
+}
+
+static void add_joint(JointArray *arr, JointType type,
+                      const Segment3D *segment, double width) {
+  if (arr->count >= arr->capacity) {
+    uint32_t new_capacity = grow_capacity(arr->capacity, 10);
+    Joint *new_data;
+
+    if (!new_capacity)
+      return;
+
+    // Arena blocks cannot grow in place; the old block is reclaimed with
+    // the arena
+    if (arr->arena) {
+      new_data = arena_alloc(arr->arena, sizeof(Joint) * new_capacity);
+      if (new_data && arr->count > 0)
+        memcpy(new_data, arr->data, sizeof(Joint) * arr->count);
+    } else {
+      new_data = realloc(arr->data, sizeof(Joint) * new_capacity);
+    }
+
+    if (!new_data)
+      return;
+
+    arr->data = new_data;
+    arr->capacity = new_capacity;
+  }
+
+  arr->data[arr->count].type = type;
+  arr->data[arr->count].segment = *segment;
+  arr->data[arr->count].width = width;
+  arr->count++;
+}
+
+/* Manage components */
+static ComponentArray *create_component_array(uint32_t initial_capacity) {
+  ComponentArray *arr = malloc(sizeof(ComponentArray));
+
+  if (!arr)
+    return NULL;
+
+  arr->components = malloc(sizeof(Component3D) * initial_capacity);
+
+  if (!arr->components) {
+    free(arr);
+
+    return NULL;
+  }
+
+  arr->count = 0;
+  arr->capacity = initial_capacity;
+  arr->arena = NULL;
+
+  return arr;
+}
+
+static void destroy_component_array(ComponentArray *arr) {
+  if (arr) {
+    uint32_t i;
+
+    for (i = 0; i < arr->count; i++)
+      cleanup_component(&arr->components[i]);
+
+    if (!arr->arena)
+      free(arr->components);
+    free(arr);
+  }
+}
+
+static void init_component(Component3D *comp, int id) {
+  init_component_in(comp, id, NULL);
+}
+
+static void init_joint_array(JointArray *arr, Arena *arena) {
+  arr->arena = arena;
+  arr->data = arena ? arena_alloc(arena, sizeof(Joint) * 10)
+                    : malloc(sizeof(Joint) * 10);
+  arr->count = 0;
+  arr->capacity = arr->data ? 10 : 0;
+}
+
+// Joint arrays come from the given arena, or the heap when it is NULL
+static void init_component_in(Component3D *comp, int id, Arena *joints) {
+  int i;
+
+  comp->id = id;
+  comp->vertices = NULL;
+  comp->quantized = NULL;
+  comp->bulges = NULL;
+  comp->source = NULL;
+  comp->next = NULL;
+  comp->edges = NULL;
+  comp->vertex_count = 0;
+  comp->thickness = 0.0;
+  comp->face = NULL;
+  comp->merged_into = 0;
+
+  // Start from identity so an untouched component sits at the origin
+  memset(&comp->transform_3d, 0, sizeof(Matrix4x4));
+  memset(&comp->inverse_transform, 0, sizeof(Matrix4x4));
+  for (i = 0; i < 4; i++) {
+    comp->transform_3d.m[i][i] = 1.0;
+    comp->inverse_transform.m[i][i] = 1.0;
+  }
+
+  comp->normal.x = comp->normal.y = 0.0;
+  comp->normal.z = 1.0;
+
+  init_joint_array(&comp->fingers, joints);
+  init_joint_array(&comp->holes, joints);
+  init_joint_array(&comp->slots, joints);
+}
+
+// Merged faces own heap copies of everything, edge table included
+static void release_face(Component3D *comp) {
+  if (comp->face) {
+    free(comp->face->next);
+    cleanup_component(comp->face);
+    free(comp->face);
+    comp->face = NULL;
+  }
+}
+
+static void cleanup_component(Component3D *comp) {
+  release_face(comp);
+  free(comp->vertices);
+  free(comp->bulges);
+  free(comp->edges);
+  if (!comp->fingers.arena)
+    free(comp->fingers.data);
+  if (!comp->holes.arena)
+    free(comp->holes.data);
+  if (!comp->slots.arena)
+    free(comp->slots.data);
+}
+
+/* Detection trace recording */
+static void trace_put_u8(FILE *f, unsigned int v) { fputc((int)(v & 0xFF), f); }
+
+static void trace_put_u16(FILE *f, unsigned int v) {
+  trace_put_u8(f, v);
+  trace_put_u8(f, v >> 8);
+}
+
+static void trace_put_u32(FILE *f, unsigned long v) {
+  trace_put_u16(f, (unsigned int)(v & 0xFFFF));
+  trace_put_u16(f, (unsigned int)((v >> 16) & 0xFFFF));
+}
+
+static void trace_put_f32(FILE *f, double v) {
+  float fv = (float)v;
+  uint32_t bits;
+
+  memcpy(&bits, &fv, sizeof(bits));
+  trace_put_u32(f, bits);
+}
+
+static DetectionTrace *trace_open(const char *path,
+                                  const ComponentArray *components) {
+  DetectionTrace *trace;
+  uint32_t i, v;
+  int r;
+
+  if (!path)
+    return NULL;
+
+  trace = malloc(sizeof(DetectionTrace));
+  if (!trace)
+    return NULL;
+
+  trace->file = fopen(path, "wb");
+  if (!trace->file) {
+    free(trace);
+
+    return NULL;
+  }
+  trace->pair_events = 0;
+  trace->joint_events = 0;
+
+  fwrite(TRACE_MAGIC, 1, 4, trace->file);
+  trace_put_u16(trace->file, TRACE_VERSION);
+  trace_put_u16(trace->file, 0);
+  trace_put_u32(trace->file, (unsigned long)components->count);
+
+  for (i = 0; i < components->count; i++) {
+    const Component3D *c = &components->components[i];
+
+    trace_put_u32(trace->file, (unsigned long)c->id);
+    trace_put_f32(trace->file, c->normal.x);
+    trace_put_f32(trace->file, c->normal.y);
+    trace_put_f32(trace->file, c->normal.z);
+    for (r = 0; r < 12; r++)
+      trace_put_f32(trace->file, c->transform_3d.m[r / 4][r % 4]);
+    trace_put_u32(trace->file, (unsigned long)c->vertex_count);
+
+    for (v = 0; v < c->vertex_count; v++) {
+      Vector3D p = component_vertex(c, v);
+
+      trace_put_f32(trace->file, p.x);
+      trace_put_f32(trace->file, p.y);
+      trace_put_f32(trace->file, p.z);
+    }
+  }
+
+  // A header that did not fit on disk would replay as garbage
+  if (ferror(trace->file)) {
+    fclose(trace->file);
+    free(trace);
+
+    return NULL;
+  }
+
+  return trace;
+}
+
+// Ends and closes the trace; -1 if any write failed, leaving it truncated
+static int trace_close(DetectionTrace *trace) {
+  int status = 0;
+
+  if (trace) {
+    trace_put_u8(trace->file, TRACE_EVENT_END);
+    if (ferror(trace->file))
+      status = -1;
+    if (fclose(trace->file) != 0)
+      status = -1;
+    free(trace);
+  }
+
+  return status;
+}
+
+static void trace_pair(DetectionTrace *trace, uint32_t i, uint32_t j,
+                       TracePairResult result) {
+  if (!trace)
+    return;
+
+  trace_put_u8(trace->file, TRACE_EVENT_PAIR);
+  trace_put_u8(trace->file, result);
+  trace_put_u16(trace->file, 0);
+  trace_put_u32(trace->file, (unsigned long)i);
+  trace_put_u32(trace->file, (unsigned long)j);
+  trace->pair_events++;
+}
+
+static void trace_joint(DetectionTrace *trace, uint32_t component,
+                        JointType type, const Segment3D *segment) {
+  if (!trace)
+    return;
+
+  trace_put_u8(trace->file, TRACE_EVENT_JOINT);
+  trace_put_u8(trace->file, type);
+  trace_put_u16(trace->file, 0);
+  trace_put_u32(trace->file, (unsigned long)component);
+  trace_put_f32(trace->file, segment->start.x);
+  trace_put_f32(trace->file, segment->start.y);
+  trace_put_f32(trace->file, segment->start.z);
+  trace_put_f32(trace->file, segment->end.x);
+  trace_put_f32(trace->file, segment->end.y);
+  trace_put_f32(trace->file, segment->end.z);
+  trace->joint_events++;
+}
+
+/* Broad phase */
+
+// World-space bounds of one component for the broad phase
+typedef struct {
+  double min[3];
+  double max[3];
+  uint32_t index;
+} ComponentBounds;
+
+static void component_bounds(const Component3D *comp, uint32_t index,
+                             ComponentBounds *bounds) {
+  uint32_t v;
+  int axis;
+
+  bounds->index = index;
+  // A merged face covers its cluster; same frame and thickness as comp
+  if (comp->face)
+    comp = comp->face;
+
+  // Without an outline there is nothing to cull against
+  if (comp->vertex_count == 0) {
+    for (axis = 0; axis < 3; axis++) {
+      bounds->min[axis] = -HUGE_VAL;
+      bounds->max[axis] = HUGE_VAL;
+    }
+    return;
+  }
+
+  for (v = 0; v < comp->vertex_count; v++) {
+    Vector3D corners[4];
+    int corner, count = 1;
+
+    corners[0] = component_vertex(comp, v);
+    // Arcs bulge past their vertices; take the corners of their local box
+    if (comp->bulges && comp->bulges[v] != 0.0) {
+      double min[2], max[2];
+
+      edge_bounds(comp, v, min, max);
+      for (corner = 0; corner < 4; corner++) {
+        corners[corner].x = corner & 1 ? max[0] : min[0];
+        corners[corner].y = corner & 2 ? max[1] : min[1];
+        corners[corner].z = corners[0].z;
+      }
+      count = 4;
+    }
+
+    for (corner = 0; corner < count; corner++) {
+      Vector3D p = transform_point(&comp->transform_3d, &corners[corner]);
+      double xyz[3];
+
+      xyz[0] = p.x;
+      xyz[1] = p.y;
+      xyz[2] = p.z;
+      for (axis = 0; axis < 3; axis++) {
+        if ((v == 0 && corner == 0) || xyz[axis] < bounds->min[axis])
+          bounds->min[axis] = xyz[axis];
+        if ((v == 0 && corner == 0) || xyz[axis] > bounds->max[axis])
+          bounds->max[axis] = xyz[axis];
+      }
+    }
+  }
+
+  // Slabs reach half their thickness off the plane, whichever way it faces
+  for (axis = 0; axis < 3; axis++) {
+    bounds->min[axis] -= EPSILON + comp->thickness / 2.0;
+    bounds->max[axis] += EPSILON + comp->thickness / 2.0;
+  }
+}
+
+static int compare_bounds_min_x(const void *a, const void *b) {
+  double da = ((const ComponentBounds *)a)->min[0];
+  double db = ((const ComponentBounds *)b)->min[0];
+
+  return da < db ? -1 : da > db ? 1 : 0;
+}
+
+typedef void (*CandidateEmit)(void *user, uint32_t i, uint32_t j);
+
+// Sort-and-sweep on x over bounds sorted by min x; overlapping pairs are
+// streamed to emit as (lower index, higher index) and never stored
+static void sweep_candidates(const ComponentBounds *sorted, uint32_t n,
+                             CandidateEmit emit, void *user) {
+  uint32_t a, b;
+
+  for (a = 0; a < n; a++) {
+    const ComponentBounds *ba = &sorted[a];
+
+    for (b = a + 1; b < n && sorted[b].min[0] <= ba->max[0]; b++) {
+      const ComponentBounds *bb = &sorted[b];
+
+      if (bb->min[1] > ba->max[1] || ba->min[1] > bb->max[1] ||
+          bb->min[2] > ba->max[2] || ba->min[2] > bb->max[2])
+        continue;
+
+      if (ba->index < bb->index)
+        emit(user, ba->index, bb->index);
+      else
+        emit(user, bb->index, ba->index);
+    }
+  }
+}
+
+/* Core algorithm functions */
+
+/*
+ * Phase 1: coplanar faces. Components sharing a plane whose straight
+ * outlines overlap or touch are clustered (broad-phase sweep for
+ * candidates, union-find to join them), and each cluster becomes one face:
+ * the union of its outlines in the lowest member's local frame, built by a
+ * single sweep over every member's edges. Phase 2 tests the face in that
+ * member's place and skips the others.
+ */
+#define FACE_SAMPLE (16 * EDGE_TOLERANCE) // off-edge step of side tests
+
+typedef struct {
+  uint32_t a, b;      // points
+  uint32_t member;    // position in the cluster
+  unsigned char left; // member's interior lies left of a->b
+} FaceEdge;
+
+typedef struct {
+  uint32_t edge;
+  uint32_t point;
+  double t; // along the edge, 0 at a
+} FaceSplit;
+
+typedef struct {
+  double key;
+  uint32_t index;
+} FaceKey;
+
+typedef struct {
+  uint32_t a, b;      // welded points
+  unsigned char left; // its member's interior lies left of a->b
+} FacePiece;
+
+typedef struct {
+  Component3D **members; // [0] owns the face and its frame
+  uint32_t member_count;
+  double *points; // xy pairs
+  uint32_t point_count;
+  uint32_t point_capacity;
+  FaceEdge *edges;
+  uint32_t edge_count;
+  FaceSplit *splits;
+  uint32_t split_count;
+  uint32_t split_capacity;
+  int failed;
+} FaceBuild;
+
+static int compare_face_keys(const void *a, const void *b) {
+  double ka = ((const FaceKey *)a)->key, kb = ((const FaceKey *)b)->key;
+
+  return (ka > kb) - (ka < kb);
+}
+
+static int compare_face_splits(const void *a, const void *b) {
+  const FaceSplit *sa = a, *sb = b;
+
+  if (sa->edge != sb->edge)
+    return sa->edge < sb->edge ? -1 : 1;
+
+  return (sa->t > sb->t) - (sa->t < sb->t);
+}
+
+static int compare_face_pieces(const void *a, const void *b) {
+  const FacePiece *pa = a, *pb = b;
+
+  if (pa->a != pb->a)
+    return pa->a < pb->a ? -1 : 1;
+
+  return (pa->b > pb->b) - (pa->b < pb->b);
+}
+
+static uint32_t face_point(FaceBuild *build, double x, double y) {
+  if (build->point_count >= build->point_capacity) {
+    uint32_t new_capacity = grow_capacity(build->point_capacity, 64);
+    double *points = new_capacity ? realloc(build->points,
+                                            sizeof(double) * 2 * new_capacity)
+                                  : NULL;
+
+    if (!points) {
+      build->failed = 1;
+      return 0;
+    }
+    build->points = points;
+    build->point_capacity = new_capacity;
+  }
+  build->points[2 * build->point_count] = x;
+  build->points[2 * build->point_count + 1] = y;
+
+  return build->point_count++;
+}
+
+static void face_split(FaceBuild *build, uint32_t edge, double t,
+                       uint32_t point) {
+  if (build->split_count >= build->split_capacity) {
+    uint32_t new_capacity = grow_capacity(build->split_capacity, 16);
+    FaceSplit *splits =
+        new_capacity ? realloc(build->splits, sizeof(FaceSplit) * new_capacity)
+                     : NULL;
+
+    if (!splits) {
+      build->failed = 1;
+      return;
+    }
+    build->splits = splits;
+    build->split_capacity = new_capacity;
+  }
+  build->splits[build->split_count].edge = edge;
+  build->splits[build->split_count].point = point;
+  build->splits[build->split_count].t = t;
+  build->split_count++;
+}
+
+// Splits two edges of different members where they meet: at an end of one
+// lying on the other, or at a proper crossing, whose point both share so
+// the pieces chain up exactly
+static void split_edge_pair(FaceBuild *build, uint32_t e, uint32_t f) {
+  uint32_t ids[2], ends[2][2];
+  double s[2][2];
+  int side, end;
+
+  ids[0] = e;
+  ids[1] = f;
+  for (side = 0; side < 2; side++) {
+    ends[side][0] = build->edges[ids[side]].a;
+    ends[side][1] = build->edges[ids[side]].b;
+  }
+
+  for (side = 0; side < 2; side++) {
+    const double *a = &build->points[2 * ends[side][0]];
+    const double *b = &build->points[2 * ends[side][1]];
+    double ex = b[0] - a[0], ey = b[1] - a[1];
+    double length = sqrt(ex * ex + ey * ey);
+
+    if (length < EPSILON)
+      return;
+    for (end = 0; end < 2; end++) {
+      uint32_t point = ends[1 - side][end];
+      const double *q = &build->points[2 * point];
+      double along = (ex * (q[0] - a[0]) + ey * (q[1] - a[1])) / length;
+
+      s[side][end] = (ex * (q[1] - a[1]) - ey * (q[0] - a[0])) / length;
+      if (fabs(s[side][end]) <= EDGE_TOLERANCE && along > EDGE_TOLERANCE &&
+          along < length - EDGE_TOLERANCE)
+        face_split(build, ids[side], along / length, point);
+    }
+  }
+
+  // s[0] holds f's ends against e's line, s[1] e's ends against f's
+  if (fabs(s[0][0]) > EDGE_TOLERANCE && fabs(s[0][1]) > EDGE_TOLERANCE &&
+      fabs(s[1][0]) > EDGE_TOLERANCE && fabs(s[1][1]) > EDGE_TOLERANCE &&
+      (s[0][0] > 0.0) != (s[0][1] > 0.0) &&
+      (s[1][0] > 0.0) != (s[1][1] > 0.0)) {
+    double te = s[1][0] / (s[1][0] - s[1][1]);
+    double tf = s[0][0] / (s[0][0] - s[0][1]);
+    const double *a = &build->points[2 * ends[0][0]];
+    const double *b = &build->points[2 * ends[0][1]];
+    uint32_t point = face_point(build, a[0] + (b[0] - a[0]) * te,
+                                a[1] + (b[1] - a[1]) * te);
+
+    if (!build->failed) {
+      face_split(build, e, te, point);
+      face_split(build, f, tf, point);
+    }
+  }
+}
+
+// Marks which side of each of one member's edges its interior lies on:
+// left for a counterclockwise loop at even nesting depth (an outline, or an
+// island in a hole) or a clockwise one at odd depth (a hole); returns 0 or -1
+static int orient_member_edges(FaceBuild *build, uint32_t first,
+                               uint32_t count) {
+  FaceEdge *edges = &build->edges[first];
+  const double *points = build->points;
+  uint32_t base = edges[0].a, e, k, loops = 0;
+  uint32_t *loop = malloc(sizeof(uint32_t) * count);
+  uint32_t *starts = malloc(sizeof(uint32_t) * count);
+  double *areas = malloc(sizeof(double) * count);
+
+  if (!loop || !starts || !areas) {
+    free(loop);
+    free(starts);
+    free(areas);
+    return -1;
+  }
+
+  for (e = 0; e < count; e++)
+    loop[e] = UINT32_MAX;
+  for (e = 0; e < count; e++) {
+    if (loop[e] != UINT32_MAX)
+      continue;
+    starts[loops] = e;
+    areas[loops] = 0.0;
+    for (k = e; loop[k] == UINT32_MAX; k = edges[k].b - base) {
+      const double *a = &points[2 * edges[k].a];
+      const double *b = &points[2 * edges[k].b];
+
+      loop[k] = loops;
+      areas[loops] += a[0] * b[1] - b[0] * a[1];
+    }
+    loops++;
+  }
+
+  // Depth parity of each loop: crossings of a ray from one of its corners
+  // with every other loop's edges
+  for (k = 0; k < loops; k++) {
+    const double *p = &points[2 * edges[starts[k]].a];
+    int odd = 0;
+
+    for (e = 0; loops > 1 && e < count; e++) {
+      const double *a = &points[2 * edges[e].a];
+      const double *b = &points[2 * edges[e].b];
+
+      if (loop[e] != k && (a[1] > p[1]) != (b[1] > p[1]) &&
+          a[0] + (p[1] - a[1]) * (b[0] - a[0]) / (b[1] - a[1]) > p[0])
+        odd ^= 1;
+    }
+    areas[k] = (areas[k] > 0.0) != odd ? 1.0 : -1.0;
+  }
+  for (e = 0; e < count; e++)
+    edges[e].left = areas[loop[e]] > 0.0;
+
+  free(loop);
+  free(starts);
+  free(areas);
+
+  return 0;
+}
+
+// Every member's edges in the owner's frame, then one sweep in x order
+// splitting each pair of edges whose boxes meet
+static void gather_face_edges(FaceBuild *build) {
+  FaceKey *order;
+  uint32_t m, v, k, l, total = 0;
+
+  for (m = 0; m < build->member_count; m++)
+    total += build->members[m]->vertex_count;
+  build->edges = malloc(sizeof(FaceEdge) * total);
+  order = malloc(sizeof(FaceKey) * total);
+  if (!build->edges || !order) {
+    build->failed = 1;
+    free(order);
+    return;
+  }
+
+  for (m = 0; m < build->member_count && !build->failed; m++) {
+    const Component3D *member = build->members[m];
+    uint32_t first = build->point_count;
+
+    for (v = 0; v < member->vertex_count && !build->failed; v++) {
+      Vector3D p = vertex_in_frame(member, v, build->members[0]);
+
+      face_point(build, p.x, p.y);
+    }
+    if (build->failed)
+      break;
+    for (v = 0; v < member->vertex_count; v++) {
+      FaceEdge *edge = &build->edges[build->edge_count + v];
+
+      edge->a = first + v;
+      edge->b = first + edge_end(member, v);
+      edge->member = m;
+    }
+    if (member->vertex_count &&
+        orient_member_edges(build, build->edge_count, member->vertex_count))
+      build->failed = 1;
+    build->edge_count += member->vertex_count;
+  }
+  if (build->failed) {
+    free(order);
+    return;
+  }
+
+  for (k = 0; k < build->edge_count; k++) {
+    const double *a = &build->points[2 * build->edges[k].a];
+    const double *b = &build->points[2 * build->edges[k].b];
+
+    order[k].key = a[0] < b[0] ? a[0] : b[0];
+    order[k].index = k;
+  }
+  qsort(order, build->edge_count, sizeof(FaceKey), compare_face_keys);
+
+  for (k = 0; k < build->edge_count && !build->failed; k++) {
+    const FaceEdge *e = &build->edges[order[k].index];
+    const double *ea = &build->points[2 * e->a];
+    const double *eb = &build->points[2 * e->b];
+    double max_x = (ea[0] > eb[0] ? ea[0] : eb[0]) + EDGE_TOLERANCE;
+    double min_y = (ea[1] < eb[1] ? ea[1] : eb[1]) - EDGE_TOLERANCE;
+    double max_y = (ea[1] > eb[1] ? ea[1] : eb[1]) + EDGE_TOLERANCE;
+
+    for (l = k + 1; l < build->edge_count && order[l].key <= max_x; l++) {
+      const FaceEdge *f = &build->edges[order[l].index];
+      const double *fa = &build->points[2 * f->a];
+      const double *fb = &build->points[2 * f->b];
+
+      // A member's own loops are taken as simple and disjoint
+      if (f->member == e->member ||
+          (fa[1] < min_y && fb[1] < min_y) ||
+          (fa[1] > max_y && fb[1] > max_y))
+        continue;
+      split_edge_pair(build, order[k].index, order[l].index);
+      // Growing the point pool may have moved the rows read above
+      ea = &build->points[2 * e->a];
+      eb = &build->points[2 * e->b];
+    }
+  }
+  free(order);
+}
+
+// Points within EDGE_TOLERANCE collapse onto one, so pieces from different
+// members that share a corner or an overlap end chain and compare equal
+static uint32_t *weld_face_points(const FaceBuild *build) {
+  uint32_t *weld = malloc(sizeof(uint32_t) * build->point_count);
+  FaceKey *order = malloc(sizeof(FaceKey) * build->point_count);
+  uint32_t k, l;
+
+  if (!weld || !order) {
+    free(weld);
+    free(order);
+    return NULL;
+  }
+  for (k = 0; k < build->point_count; k++) {
+    weld[k] = k;
+    order[k].key = build->points[2 * k];
+    order[k].index = k;
+  }
+  qsort(order, build->point_count, sizeof(FaceKey), compare_face_keys);
+
+  for (k = 0; k < build->point_count; k++) {
+    uint32_t p = order[k].index;
+
+    if (weld[p] != p)
+      continue;
+    for (l = k + 1; l < build->point_count &&
+                    order[l].key - order[k].key <= EDGE_TOLERANCE;
+         l++) {
+      uint32_t q = order[l].index;
+
+      if (weld[q] == q && fabs(build->points[2 * q + 1] -
+                               build->points[2 * p + 1]) <= EDGE_TOLERANCE)
+        weld[q] = p;
+    }
+  }
+  free(order);
+
+  return weld;
+}
+
+/*
+ * Coverage sweep. Pieces only meet at their ends, so along a vertical line
+ * sweeping in x they keep one bottom-to-top order, held in a treap ranked
+ * by height at the sweep position. Each piece weighs +1 if its member's
+ * interior lies above it and -1 if below, so the weights up to a height
+ * count the members covering it. Points are visited in (x, y) order, as if
+ * the sweep leaned back slightly: a vertical piece then spans the sweep at
+ * its bottom end, with the side to its left above it.
+ */
+#define FACE_NIL UINT32_MAX
+
+typedef struct {
+  uint32_t left, right, parent;
+  uint32_t priority;
+  int weight;
+  int sum; // weights in the subtree
+} FaceNode;
+
+typedef struct {
+  const FaceBuild *build;
+  const FacePiece *pieces;
+  FaceNode *nodes; // one per piece
+  uint32_t root;
+  uint32_t random;
+  double x; // sweep position
+} FaceSweep;
+
+typedef struct {
+  double x, y;
+  uint32_t piece;
+} FaceEvent;
+
+static int compare_face_events(const void *a, const void *b) {
+  const FaceEvent *ea = a, *eb = b;
+
+  if (ea->x != eb->x)
+    return ea->x < eb->x ? -1 : 1;
+
+  return (ea->y > eb->y) - (ea->y < eb->y);
+}
+
+// Lower and upper ends of a piece in (x, y) order
+static void piece_ends(const FaceSweep *sweep, uint32_t piece,
+                       const double **lo, const double **hi) {
+  const double *a = &sweep->build->points[2 * sweep->pieces[piece].a];
+  const double *b = &sweep->build->points[2 * sweep->pieces[piece].b];
+  int forward = a[0] < b[0] || (a[0] == b[0] && a[1] < b[1]);
+
+  *lo = forward ? a : b;
+  *hi = forward ? b : a;
+}
+
+// Orders two pieces spanning the sweep by height there, then by slope (the
+// flatter one is below just past a shared end); 0 for coincident pieces
+static int compare_face_pieces_at(const FaceSweep *sweep, uint32_t p,
+                                  uint32_t q) {
+  const double *pl, *ph, *ql, *qh;
+  double yp, yq, sp, sq;
+
+  piece_ends(sweep, p, &pl, &ph);
+  piece_ends(sweep, q, &ql, &qh);
+  if (ph[0] == pl[0]) {
+    yp = pl[1];
+    sp = HUGE_VAL;
+  } else {
+    sp = (ph[1] - pl[1]) / (ph[0] - pl[0]);
+    yp = pl[1] + (sweep->x - pl[0]) * sp;
+  }
+  if (qh[0] == ql[0]) {
+    yq = ql[1];
+    sq = HUGE_VAL;
+  } else {
+    sq = (qh[1] - ql[1]) / (qh[0] - ql[0]);
+    yq = ql[1] + (sweep->x - ql[0]) * sq;
+  }
+  if (yp != yq)
+    return yp < yq ? -1 : 1;
+
+  return (sp > sq) - (sp < sq);
+}
+
+static void face_node_update(FaceSweep *sweep, uint32_t n) {
+  FaceNode *node = &sweep->nodes[n];
+
+  node->sum = node->weight;
+  if (node->left != FACE_NIL)
+    node->sum += sweep->nodes[node->left].sum;
+  if (node->right != FACE_NIL)
+    node->sum += sweep->nodes[node->right].sum;
+}
+
+// Lifts node n above its parent, keeping the in-order sequence
+static void face_node_rotate_up(FaceSweep *sweep, uint32_t n) {
+  FaceNode *nodes = sweep->nodes;
+  uint32_t p = nodes[n].parent, g = nodes[p].parent;
+
+  if (nodes[p].left == n) {
+    nodes[p].left = nodes[n].right;
+    if (nodes[n].right != FACE_NIL)
+      nodes[nodes[n].right].parent = p;
+    nodes[n].right = p;
+  } else {
+    nodes[p].right = nodes[n].left;
+    if (nodes[n].left != FACE_NIL)
+      nodes[nodes[n].left].parent = p;
+    nodes[n].left = p;
+  }
+  nodes[p].parent = n;
+  nodes[n].parent = g;
+  if (g == FACE_NIL)
+    sweep->root = n;
+  else if (nodes[g].left == p)
+    nodes[g].left = n;
+  else
+    nodes[g].right = n;
+  face_node_update(sweep, p);
+  face_node_update(sweep, n);
+}
+
+static void face_sweep_insert(FaceSweep *sweep, uint32_t n) {
+  FaceNode *nodes = sweep->nodes;
+  uint32_t parent = FACE_NIL, at = sweep->root, k;
+  int below = 0;
+
+  // xorshift priorities keep the treap balanced in expectation
+  sweep->random ^= sweep->random << 13;
+  sweep->random ^= sweep->random >> 17;
+  sweep->random ^= sweep->random << 5;
+  nodes[n].priority = sweep->random;
+  nodes[n].left = nodes[n].right = FACE_NIL;
+  nodes[n].sum = nodes[n].weight;
+
+  // Coincident pieces go in index order
+  while (at != FACE_NIL) {
+    int order = compare_face_pieces_at(sweep, n, at);
+
+    parent = at;
+    below = order < 0 || (order == 0 && n < at);
+    at = below ? nodes[at].left : nodes[at].right;
+  }
+  nodes[n].parent = parent;
+  if (parent == FACE_NIL)
+    sweep->root = n;
+  else if (below)
+    nodes[parent].left = n;
+  else
+    nodes[parent].right = n;
+  for (k = parent; k != FACE_NIL; k = nodes[k].parent)
+    face_node_update(sweep, k);
+
+  while (nodes[n].parent != FACE_NIL &&
+         nodes[nodes[n].parent].priority < nodes[n].priority)
+    face_node_rotate_up(sweep, n);
+}
+
+static void face_sweep_remove(FaceSweep *sweep, uint32_t n) {
+  FaceNode *nodes = sweep->nodes;
+  uint32_t parent, k;
+
+  // Sink it to a leaf under its higher-priority child, then cut it off
+  while (nodes[n].left != FACE_NIL || nodes[n].right != FACE_NIL) {
+    uint32_t l = nodes[n].left, r = nodes[n].right;
+
+    face_node_rotate_up(sweep, r == FACE_NIL || (l != FACE_NIL &&
+                                                 nodes[l].priority >
+                                                     nodes[r].priority)
+                                   ? l
+                                   : r);
+  }
+  parent = nodes[n].parent;
+  if (parent == FACE_NIL)
+    sweep->root = FACE_NIL;
+  else if (nodes[parent].left == n)
+    nodes[parent].left = FACE_NIL;
+  else
+    nodes[parent].right = FACE_NIL;
+  for (k = parent; k != FACE_NIL; k = nodes[k].parent)
+    face_node_update(sweep, k);
+}
+
+// Weight of the pieces below piece p at the sweep, and those level with it
+static void face_sweep_count(const FaceSweep *sweep, uint32_t p, int *below,
+                             int *level) {
+  const FaceNode *nodes = sweep->nodes;
+  uint32_t at;
+
+  *below = 0;
+  for (at = sweep->root; at != FACE_NIL;) {
+    if (compare_face_pieces_at(sweep, at, p) < 0) {
+      *below += nodes[at].weight;
+      if (nodes[at].left != FACE_NIL)
+        *below += nodes[nodes[at].left].sum;
+      at = nodes[at].right;
+    } else {
+      at = nodes[at].left;
+    }
+  }
+  *level = -*below;
+  for (at = sweep->root; at != FACE_NIL;) {
+    if (compare_face_pieces_at(sweep, at, p) <= 0) {
+      *level += nodes[at].weight;
+      if (nodes[at].left != FACE_NIL)
+        *level += nodes[nodes[at].left].sum;
+      at = nodes[at].right;
+    } else {
+      at = nodes[at].left;
+    }
+  }
+}
+
+/*
+ * Which sides of each piece some member covers: bit 0 left, bit 1 right.
+ * Coincident pieces (edges two members share) count together, so each
+ * sees the coverage beside the pair. Returns NULL on allocation failure.
+ */
+static unsigned char *face_coverage(const FaceBuild *build,
+                                    const FacePiece *pieces, uint32_t count) {
+  size_t size = count ? count : 1;
+  unsigned char *sides = calloc(size, 1);
+  FaceEvent *starts = malloc(sizeof(FaceEvent) * size);
+  FaceEvent *ends = malloc(sizeof(FaceEvent) * size);
+  FaceSweep sweep;
+  uint32_t k, events = 0, i = 0, j = 0;
+
+  sweep.build = build;
+  sweep.pieces = pieces;
+  sweep.nodes = malloc(sizeof(FaceNode) * size);
+  sweep.root = FACE_NIL;
+  sweep.random = 2463534242u;
+  if (!sides || !starts || !ends || !sweep.nodes) {
+    free(sides);
+    sides = NULL;
+    goto done;
+  }
+
+  for (k = 0; k < count; k++) {
+    const double *lo, *hi;
+
+    piece_ends(&sweep, k, &lo, &hi);
+    // Points that welded apart but sit together bound nothing
+    if (lo[0] == hi[0] && lo[1] == hi[1])
+      continue;
+    sweep.nodes[k].weight =
+        pieces[k].left == (lo == &build->points[2 * pieces[k].a]) ? 1 : -1;
+    starts[events].x = lo[0];
+    starts[events].y = lo[1];
+    starts[events].piece = k;
+    ends[events].x = hi[0];
+    ends[events].y = hi[1];
+    ends[events].piece = k;
+    events++;
+  }
+  qsort(starts, events, sizeof(FaceEvent), compare_face_events);
+  qsort(ends, events, sizeof(FaceEvent), compare_face_events);
+
+  while (i < events) {
+    uint32_t first = i;
+
+    // Pieces ending here leave before those starting here join
+    sweep.x = starts[i].x;
+    while (j < events && compare_face_events(&ends[j], &starts[i]) <= 0)
+      face_sweep_remove(&sweep, ends[j++].piece);
+    while (i < events && compare_face_events(&starts[i], &starts[first]) == 0)
+      face_sweep_insert(&sweep, starts[i++].piece);
+
+    for (k = first; k < i; k++) {
+      uint32_t piece = starts[k].piece;
+      const double *lo, *hi;
+      int below, level, above;
+
+      face_sweep_count(&sweep, piece, &below, &level);
+      above = below + level;
+      piece_ends(&sweep, piece, &lo, &hi);
+      // Left of the piece is above it when it runs from its lower end
+      if (lo == &build->points[2 * pieces[piece].a])
+        sides[piece] = (above > 0) | (below > 0) << 1;
+      else
+        sides[piece] = (below > 0) | (above > 0) << 1;
+    }
+  }
+
+done:
+  free(starts);
+  free(ends);
+  free(sweep.nodes);
+
+  return sides;
+}
+
+// Boundary pieces of the union, oriented with the covered side on the left
+// and sorted by start point; returns 0 or -1
+static int face_boundary(FaceBuild *build, FacePiece **out,
+                         uint32_t *out_count) {
+  uint32_t *weld;
+  FacePiece *pieces;
+  unsigned char *covered;
+  uint32_t k, s = 0, count = 0, kept = 0;
+
+  if (build->split_count > 1)
+    qsort(build->splits, build->split_count, sizeof(FaceSplit),
+          compare_face_splits);
+  weld = weld_face_points(build);
+  pieces = malloc(sizeof(FacePiece) *
+                  ((size_t)build->edge_count + build->split_count));
+  if (!weld || !pieces) {
+    free(weld);
+    free(pieces);
+    return -1;
+  }
+
+  // Each edge runs through its splits in order
+  for (k = 0; k < build->edge_count; k++) {
+    uint32_t from = weld[build->edges[k].a];
+
+    for (;; s++) {
+      int last = s >= build->split_count || build->splits[s].edge != k;
+      uint32_t to = weld[last ? build->edges[k].b : build->splits[s].point];
+
+      if (to != from) {
+        pieces[count].a = from;
+        pieces[count].b = to;
+        pieces[count].left = build->edges[k].left;
+        count++;
+      }
+      from = to;
+      if (last)
+        break;
+    }
+  }
+  free(weld);
+
+  covered = face_coverage(build, pieces, count);
+  if (!covered) {
+    free(pieces);
+    return -1;
+  }
+
+  // A piece bounds the union where coverage differs across it
+  for (k = 0; k < count; k++) {
+    int left = covered[k] & 1, right = covered[k] >> 1;
+
+    if (left == right)
+      continue;
+    pieces[kept] = pieces[k];
+    if (right) {
+      pieces[kept].a = pieces[k].b;
+      pieces[kept].b = pieces[k].a;
+    }
+    kept++;
+  }
+  free(covered);
+
+  // Overlapping edges of two members leave the same piece twice
+  if (kept > 1)
+    qsort(pieces, kept, sizeof(FacePiece), compare_face_pieces);
+  for (k = 0, count = 0; k < kept; k++)
+    if (count == 0 || pieces[k].a != pieces[count - 1].a ||
+        pieces[k].b != pieces[count - 1].b)
+      pieces[count++] = pieces[k];
+
+  *out = pieces;
+  *out_count = count;
+
+  return 0;
+}
+
+// Splitting leaves vertices partway along straight runs; compacts a closed
+// loop to its corners and returns how many remain
+static uint32_t drop_collinear(Vector3D *loop, uint32_t count) {
+  uint32_t k, kept = 0;
+
+  for (k = 0; k < count; k++) {
+    Vector3D prev = kept ? loop[kept - 1] : loop[count - 1];
+
+    if (segment_distance2(prev, loop[(k + 1) % count], loop[k].x,
+                          loop[k].y) > EDGE_TOLERANCE * EDGE_TOLERANCE)
+      loop[kept++] = loop[k];
+  }
+
+  return kept;
+}
+
+// Chains boundary pieces into loops and stores them as a face on the owner;
+// fails (leaving the cluster unmerged) if a chain does not close
+static int build_face(FaceBuild *build) {
+  Component3D *owner = build->members[0];
+  Component3D *face = NULL;
+  FacePiece *pieces = NULL;
+  unsigned char *used = NULL;
+  uint32_t *starts = NULL;
+  uint32_t count, k, vertex_count = 0, loop_count = 0;
+  int status = -1;
+
+  gather_face_edges(build);
+  if (build->failed)
+    return -1;
+  if (face_boundary(build, &pieces, &count) != 0)
+    return -1;
+  if (count < 3) {
+    free(pieces);
+    return -1;
+  }
+
+  face = calloc(1, sizeof(Component3D));
+  used = calloc(count, 1);
+  starts = malloc(sizeof(uint32_t) * count);
+  if (face)
+    face->vertices = malloc(sizeof(Vector3D) * count);
+  if (!face || !used || !starts || !face->vertices)
+    goto done;
+
+  for (k = 0; k < count; k++) {
+    uint32_t first = vertex_count, piece = k;
+
+    if (used[k])
+      continue;
+    for (;;) {
+      uint32_t target = pieces[piece].b, lo = 0, hi = count;
+      Vector3D *v = &face->vertices[vertex_count++];
+
+      used[piece] = 1;
+      v->x = build->points[2 * pieces[piece].a];
+      v->y = build->points[2 * pieces[piece].a + 1];
+      v->z = 0.0;
+      if (target == pieces[k].a)
+        break;
+
+      // First piece starting at target, then the first unused one
+      while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if (pieces[mid].a < target)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      while (lo < count && pieces[lo].a == target && used[lo])
+        lo++;
+      if (lo == count || pieces[lo].a != target)
+        goto done;
+      piece = lo;
+    }
+    vertex_count = first + drop_collinear(&face->vertices[first],
+                                          vertex_count - first);
+    if (vertex_count - first < 3)
+      vertex_count = first;
+    else
+      starts[loop_count++] = first;
+  }
+  if (loop_count == 0)
+    goto done;
+
+  face->id = owner->id;
+  face->vertex_count = vertex_count;
+  face->transform_3d = owner->transform_3d;
+  face->inverse_transform = owner->inverse_transform;
+  face->normal = owner->normal;
+  face->thickness = owner->thickness;
+  if (loop_count > 1) {
+    face->next = malloc(sizeof(uint32_t) * vertex_count);
+    if (!face->next)
+      goto done;
+    for (k = 0; k < loop_count; k++) {
+      uint32_t end = k + 1 < loop_count ? starts[k + 1] : vertex_count, v;
+
+      for (v = starts[k]; v < end; v++)
+        face->next[v] = v + 1 < end ? v + 1 : starts[k];
+    }
+  }
+  if (vertex_count >= EDGE_TREE_MIN_VERTICES)
+    face->edges = build_edge_tree(face);
+  status = 0;
+
+done:
+  if (status == 0) {
+    owner->face = face;
+  } else if (face) {
+    free(face->vertices);
+    free(face->next);
+    free(face);
+  }
+  free(pieces);
+  free(used);
+  free(starts);
+
+  return status;
+}
+
+typedef struct {
+  ComponentArray *components;
+  uint32_t *parent;
+} CoplanarJoin;
+
+static uint32_t find_cluster(uint32_t *parent, uint32_t i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+
+  return i;
+}
+
+// Only straight outlines take part; arcs keep their own components
+static int can_merge(const Component3D *comp) {
+  return comp->vertex_count >= 3 && !comp->bulges;
+}
+
+static void join_coplanar(void *user, uint32_t i, uint32_t j) {
+  CoplanarJoin *join = user;
+  const Component3D *ci = &join->components->components[i];
+  const Component3D *cj = &join->components->components[j];
+  uint32_t ri, rj;
+
+  if (!can_merge(ci) || !can_merge(cj) || ci->thickness != cj->thickness ||
+      !are_coplanar(ci, cj))
+    return;
+  ri = find_cluster(join->parent, i);
+  rj = find_cluster(join->parent, j);
+  if (ri == rj || !components_intersect(ci, cj))
+    return;
+
+  // The lowest index roots its cluster and will own the face
+  if (ri < rj)
+    join->parent[rj] = ri;
+  else
+    join->parent[ri] = rj;
+}
+
+// Drops every merged face, so each component tests on its own outline
+static void unmerge_components(ComponentArray *components) {
+  uint32_t i;
+
+  for (i = 0; i < components->count; i++) {
+    release_face(&components->components[i]);
+    components->components[i].merged_into = 0;
+  }
+}
+
+// Rebuilds every merged face; returns how many components were folded into
+// another's. Allocation failures leave components unmerged.
+static int merge_coplanar_components(ComponentArray *components) {
+  uint32_t n = components->count, i, *parent, *offsets, *members;
+  Component3D **cluster;
+  ComponentBounds *bounds;
+  CoplanarJoin join;
+  int merged = 0;
+
+  unmerge_components(components);
+
+  parent = malloc(sizeof(uint32_t) * n);
+  offsets = calloc((size_t)n + 1, sizeof(uint32_t));
+  members = malloc(sizeof(uint32_t) * n);
+  cluster = malloc(sizeof(Component3D *) * n);
+  bounds = malloc(sizeof(ComponentBounds) * n);
+  if (!parent || !offsets || !members || !cluster || !bounds)
+    goto done;
+
+  for (i = 0; i < n; i++) {
+    parent[i] = i;
+    component_bounds(&components->components[i], i, &bounds[i]);
+  }
+  qsort(bounds, n, sizeof(ComponentBounds), compare_bounds_min_x);
+  join.components = components;
+  join.parent = parent;
+  sweep_candidates(bounds, n, join_coplanar, &join);
+
+  // Members of each cluster, in index order, behind their root
+  for (i = 0; i < n; i++)
+    offsets[find_cluster(parent, i) + 1]++;
+  for (i = 0; i < n; i++)
+    offsets[i + 1] += offsets[i];
+  for (i = 0; i < n; i++)
+    members[offsets[find_cluster(parent, i)]++] = i;
+  for (i = n; i > 0; i--)
+    offsets[i] = offsets[i - 1];
+  offsets[0] = 0;
+
+  for (i = 0; i < n; i++) {
+    uint32_t first = offsets[i], count = offsets[i + 1] - offsets[i], k;
+    FaceBuild build;
+
+    if (count < 2)
+      continue;
+    for (k = 0; k < count; k++)
+      cluster[k] = &components->components[members[first + k]];
+    memset(&build, 0, sizeof(build));
+    build.members = cluster;
+    build.member_count = count;
+    if (build_face(&build) == 0) {
+      for (k = 1; k < count; k++)
+        components->components[members[first + k]].merged_into = i + 1;
+      merged += (int)count - 1;
+    }
+    free(build.points);
+    free(build.edges);
+    free(build.splits);
+  }
+
+done:
+  free(parent);
+  free(offsets);
+  free(members);
+  free(cluster);
+  free(bounds);
+
+  return merged;
+}
+
+// Tally one pair outcome for detection_get_stats() (NULL disables)
+static void count_pair(DetectionStats *stats, TracePairResult result) {
+  if (!stats)
+    return;
+
+  stats->pairs_tested++;
+  if (result == TRACE_PAIR_PARALLEL)
+    stats->pairs_parallel++;
+  else if (result == TRACE_PAIR_COPLANAR)
+    stats->pairs_coplanar++;
+  else if (result == TRACE_PAIR_INTERSECTION)
+    stats->pairs_intersecting++;
+}
+
+// Where detect_pair() sends its results. Sequential runs write straight into
+// the components; tiles collect joints privately so several can run at
+// once, and the owner replays them afterwards.
+typedef struct {
+  DetectionTrace *trace;
+  DetectionStats *stats;
+  FlatJoints *joints;  // NULL: append to the components' joint arrays
+  // Pipelined runs see pairs out of order; tagging each joint with its pair
+  // lets the merge restore sequential order
+  int keyed;
+  uint64_t pair_key;
+  uint64_t *joint_keys;
+  uint32_t joint_keys_capacity;
+  int failed;
+} PairSink;
+
+static int append_flat_joint(FlatJoints *out, uint32_t component,
+                             JointType type, const Segment3D *segment,
+                             double width) {
+  JointArray one;
+  Joint joint;
+
+  joint.type = type;
+  joint.segment = *segment;
+  joint.width = width;
+  one.data = &joint;
+  one.count = one.capacity = 1;
+  one.arena = NULL;
+
+  return collect_joints(&one, (int)component, out);
+}
+
+static void emit_joint(ComponentArray *components, PairSink *sink,
+                       uint32_t index, JointType type,
+                       const Segment3D *segment, double width) {
+  Component3D *comp = &components->components[index];
+
+  if (sink->joints) {
+    if (append_flat_joint(sink->joints, index, type, segment, width) != 0) {
+      sink->failed = 1;
+      return;
+    }
+    if (sink->keyed) {
+      if (sink->joint_keys_capacity < (uint32_t)sink->joints->capacity) {
+        uint64_t *keys = realloc(sink->joint_keys,
+                                 sizeof(uint64_t) * sink->joints->capacity);
+
+        if (!keys) {
+          sink->joints->count--;
+          sink->failed = 1;
+          return;
+        }
+        sink->joint_keys = keys;
+        sink->joint_keys_capacity = sink->joints->capacity;
+      }
+      sink->joint_keys[sink->joints->count - 1] = sink->pair_key;
+    }
+  } else {
+    add_joint(type == FINGER_JOINT ? &comp->fingers
+              : type == HOLE_JOINT ? &comp->holes
+                                   : &comp->slots,
+              type, segment, width);
+  }
+  trace_joint(sink->trace, index, type, segment);
+}
+
+typedef struct {
+  double t0;
+  double t1;
+} LineSpan;
+
+static int compare_spans(const void *a, const void *b) {
+  double ta = ((const LineSpan *)a)->t0, tb = ((const LineSpan *)b)->t0;
+
+  return (ta > tb) - (ta < tb);
+}
+
+// Growable list of pieces of the intersection line, as parameters along it
+typedef struct {
+  LineSpan *data;
+  uint32_t count;
+  uint32_t capacity;
+  int failed;
+} SpanList;
+
+static void push_span(SpanList *spans, double t0, double t1) {
+  if (spans->count == spans->capacity) {
+    uint32_t capacity = grow_capacity(spans->capacity, 8);
+    LineSpan *data =
+        capacity ? realloc(spans->data, sizeof(LineSpan) * capacity) : NULL;
+
+    if (!data) {
+      spans->failed = 1;
+      return;
+    }
+    spans->data = data;
+    spans->capacity = capacity;
+  }
+  spans->data[spans->count].t0 = t0;
+  spans->data[spans->count].t1 = t1;
+  spans->count++;
+}
+
+static Segment3D shift_segment(const Segment3D *segment, const Vector3D *by,
+                               double s) {
+  Segment3D result = *segment;
+
+  result.start.x += by->x * s;
+  result.start.y += by->y * s;
+  result.start.z += by->z * s;
+  result.end.x += by->x * s;
+  result.end.y += by->y * s;
+  result.end.z += by->z * s;
+
+  return result;
+}
+
+// Parameter of p along the unit-length line; shifts perpendicular to the
+// line drop out
+static double line_param(const Segment3D *line, const Vector3D *p) {
+  Vector3D direction = subtract_vectors(&line->end, &line->start);
+  Vector3D d = subtract_vectors(p, &line->start);
+
+  return dot_product(&d, &direction);
+}
+
+/*
+ * One sample of comp's band: the line moved s along shift (unit, in comp's
+ * plane, across the line), clipped to comp's outline. That line lies over
+ * the line moved s along lean (shift projected onto the other plane), so
+ * the sample only counts where that one is inside the other outline too:
+ * the band is bounded by the other slab's real footprint, not its plane.
+ */
+static void add_band_spans(SpanList *spans, const Segment3D *line,
+                           const Component3D *comp, const Component3D *other,
+                           const Vector3D *shift, const Vector3D *lean,
+                           double s) {
+  Segment3D own = shift_segment(line, shift, s);
+  Segment3D over = shift_segment(line, lean, s);
+  SegmentArray a = find_line_component_intersections(&own, comp);
+  SegmentArray b = {0};
+  uint32_t ia = 0, ib = 0;
+
+  // Most lines miss the first outline; skip clipping the second then
+  if (a.count > 0)
+    b = find_line_component_intersections(&over, other);
+
+  // Both clips come out ordered along the line
+  while (ia < a.count && ib < b.count) {
+    double a0 = line_param(line, &a.data[ia].start);
+    double a1 = line_param(line, &a.data[ia].end);
+    double b0 = line_param(line, &b.data[ib].start);
+    double b1 = line_param(line, &b.data[ib].end);
+    double t0 = a0 > b0 ? a0 : b0, t1 = a1 < b1 ? a1 : b1;
+
+    if (t1 - t0 > EPSILON)
+      push_span(spans, t0, t1);
+    if (a1 < b1)
+      ia++;
+    else
+      ib++;
+  }
+  free(a.data);
+  free(b.data);
+}
+
+/*
+ * Pieces of the intersection line where the two slabs overlap, estimated
+ * rather than solved exactly from the two box slabs: each component's band
+ * is sampled at its centre line (shared by both) and its two border lines,
+ * each kept only inside the other's footprint, and the samples are merged
+ * along the line. Oblique slabs that only overlap between the samples (an
+ * outline corner cutting across the band) are under-reported. Every piece
+ * lies within both slabs, so inside both components' inflated bounding
+ * boxes, and the broad phase never culls a pair that would produce one.
+ * With no thickness this is the overlap of the line's clips to both
+ * outlines.
+ */
+static SegmentArray find_slab_overlap(const Segment3D *line,
+                                      const Component3D *ci,
+                                      const Component3D *cj,
+                                      const Vector3D *shift_i,
+                                      const Vector3D *shift_j,
+                                      double offset_i, double offset_j) {
+  SegmentArray result = {0};
+  SpanList spans = {0};
+  Vector3D lean_i, lean_j;
+  double across;
+  uint32_t k;
+
+  across = dot_product(shift_i, &cj->normal);
+  lean_i.x = shift_i->x - across * cj->normal.x;
+  lean_i.y = shift_i->y - across * cj->normal.y;
+  lean_i.z = shift_i->z - across * cj->normal.z;
+  across = dot_product(shift_j, &ci->normal);
+  lean_j.x = shift_j->x - across * ci->normal.x;
+  lean_j.y = shift_j->y - across * ci->normal.y;
+  lean_j.z = shift_j->z - across * ci->normal.z;
+
+  add_band_spans(&spans, line, ci, cj, shift_i, &lean_i, 0.0);
+  if (offset_i > 0.0) {
+    add_band_spans(&spans, line, ci, cj, shift_i, &lean_i, offset_i);
+    add_band_spans(&spans, line, ci, cj, shift_i, &lean_i, -offset_i);
+  }
+  if (offset_j > 0.0) {
+    add_band_spans(&spans, line, cj, ci, shift_j, &lean_j, offset_j);
+    add_band_spans(&spans, line, cj, ci, shift_j, &lean_j, -offset_j);
+  }
+
+  if (!spans.failed && spans.count > 1)
+    qsort(spans.data, spans.count, sizeof(LineSpan), compare_spans);
+  for (k = 0; !spans.failed && k < spans.count;) {
+    double t0 = spans.data[k].t0, t1 = spans.data[k].t1;
+
+    for (k++; k < spans.count && spans.data[k].t0 <= t1 + EPSILON; k++)
+      if (spans.data[k].t1 > t1)
+        t1 = spans.data[k].t1;
+    add_line_piece(&result, line, t0, t1);
+  }
+  free(spans.data);
+
+  return result;
+}
+
+// Whether a joint segment (world space) lies on comp's outline, or for a
+// slab joint on it once moved to either border of the band
+static int is_band_on_edge(const Segment3D *segment, const Component3D *comp,
+                           const Vector3D *shift, double offset) {
+  int pass;
+
+  for (pass = 0; pass < (offset > 0.0 ? 3 : 1); pass++) {
+    double s = pass == 0 ? 0.0 : pass == 1 ? offset : -offset;
+    Segment3D local;
+
+    local.start.x = segment->start.x + shift->x * s;
+    local.start.y = segment->start.y + shift->y * s;
+    local.start.z = segment->start.z + shift->z * s;
+    local.end.x = segment->end.x + shift->x * s;
+    local.end.y = segment->end.y + shift->y * s;
+    local.end.z = segment->end.z + shift->z * s;
+    local.start = transform_point(&comp->inverse_transform, &local.start);
+    local.end = transform_point(&comp->inverse_transform, &local.end);
+    if (is_segment_on_edge(&local, comp))
+      return 1;
+  }
+
+  return 0;
+}
+
+// Test and classify one component pair (i < j)
+static void detect_pair(ComponentArray *components, uint32_t i, uint32_t j,
+                        PairSink *sink) {
+  const Component3D *ci = &components->components[i];
+  const Component3D *cj = &components->components[j];
+  uint32_t k;
+
+  // Merged members are tested through their cluster's face
+  if (ci->merged_into || cj->merged_into)
+    return;
+  ci = ci->face ? ci->face : ci;
+  cj = cj->face ? cj->face : cj;
+
+  if (are_coplanar(ci, cj)) {
+    // Overlapping ones were merged in phase 1
+    trace_pair(sink->trace, i, j, TRACE_PAIR_COPLANAR);
+    count_pair(sink->stats, TRACE_PAIR_COPLANAR);
+  } else if (!are_parallel(ci, cj)) {
+    Segment3D intersection_line = find_intersection_line(ci, cj);
+    Vector3D direction =
+        subtract_vectors(&intersection_line.end, &intersection_line.start);
+    Vector3D shift_i = cross_product(&ci->normal, &direction);
+    Vector3D shift_j = cross_product(&cj->normal, &direction);
+    // A slab of thickness t crosses the other plane in a band t / sin wide
+    Vector3D across = cross_product(&ci->normal, &cj->normal);
+    double sine = sqrt(dot_product(&across, &across));
+    double offset_i = sine > EPSILON ? cj->thickness / (2.0 * sine) : 0.0;
+    double offset_j = sine > EPSILON ? ci->thickness / (2.0 * sine) : 0.0;
+
+    shift_i = normalise_vector(&shift_i);
+    shift_j = normalise_vector(&shift_j);
+
+    SegmentArray shared =
+        find_slab_overlap(&intersection_line, ci, cj, &shift_i, &shift_j,
+                          offset_i, offset_j);
+
+    TracePairResult result = shared.count > 0 ? TRACE_PAIR_INTERSECTION
+                                              : TRACE_PAIR_NO_INTERSECTION;
+
+    trace_pair(sink->trace, i, j, result);
+    count_pair(sink->stats, result);
+
+    for (k = 0; k < shared.count; k++) {
+      Segment3D seg_i = shared.data[k];
+      Segment3D seg_j = shared.data[k];
+      int i_on_edge = is_band_on_edge(&seg_i, ci, &shift_i, offset_i);
+      int j_on_edge = is_band_on_edge(&seg_j, cj, &shift_j, offset_j);
+      JointType type_i, type_j;
+
+      seg_i.start = transform_point(&ci->inverse_transform, &seg_i.start);
+      seg_i.end = transform_point(&ci->inverse_transform, &seg_i.end);
+      seg_j.start = transform_point(&cj->inverse_transform, &seg_j.start);
+      seg_j.end = transform_point(&cj->inverse_transform, &seg_j.end);
+
+      if (i_on_edge && j_on_edge) {
+        type_i = FINGER_JOINT;
+        type_j = FINGER_JOINT;
+      } else if (i_on_edge && !j_on_edge) {
+        type_i = FINGER_JOINT;
+        type_j = HOLE_JOINT;
+      } else if (!i_on_edge && j_on_edge) {
+        type_i = HOLE_JOINT;
+        type_j = FINGER_JOINT;
+      } else {
+        type_i = SLOT_JOINT;
+        type_j = SLOT_JOINT;
+      }
+
+      emit_joint(components, sink, i, type_i, &seg_i, 2.0 * offset_i);
+      emit_joint(components, sink, j, type_j, &seg_j, 2.0 * offset_j);
+    }
+
+    free(shared.data);
+  } else {
+    trace_pair(sink->trace, i, j, TRACE_PAIR_PARALLEL);
+    count_pair(sink->stats, TRACE_PAIR_PARALLEL);
+  }
+}
+
+static void find_and_classify_intersections(ComponentArray *components,
+                                            DetectionTrace *trace,
+                                            DetectionStats *stats) {
+  PairSink sink = {0};
+  uint32_t i, j;
+
+  sink.trace = trace;
+  sink.stats = stats;
+
+  for (i = 0; i < components->count; i++) {
+    if (components->components[i].merged_into)
+      continue;
+    for (j = i + 1; j < components->count; j++)
+      detect_pair(components, i, j, &sink);
+  }
+}
+
+// Algo starting point
+int detect_component_intersections(ComponentArray *components) {
+  if (!components || components->count == 0)
+    return -1;
+
+  prepare_edge_trees(components);
+  merge_coplanar_components(components);
+  find_and_classify_intersections(components, NULL, NULL);
+
+  return 0;
+}
+
+// Same as above, additionally recording every pair test and joint to a
+// binary trace at trace_path (NULL disables tracing)
+int detect_component_intersections_traced(ComponentArray *components,
+                                          const char *trace_path) {
+  DetectionTrace *trace;
+
+  if (!components || components->count == 0)
+    return -1;
+
+  trace = trace_open(trace_path, components);
+  if (trace_path && !trace)
+    return -1;
+
+  prepare_edge_trees(components);
+  merge_coplanar_components(components);
+  find_and_classify_intersections(components, trace, NULL);
+
+  return trace_close(trace);
+}
+
+/* Flat buffer interface (see 3d_detection_algo.h) */
+
+// Rigid local-to-world transform: the inverse is R^T and -R^T * t, and the
+// component normal is the local z axis in world space
+static void load_flat_transform(Component3D *comp, const double *m) {
+  Vector3D z_axis;
+  int r, c;
+
+  for (r = 0; r < 4; r++)
+    for (c = 0; c < 4; c++)
+      comp->transform_3d.m[r][c] = m[r * 4 + c];
+
+  memset(&comp->inverse_transform, 0, sizeof(Matrix4x4));
+  for (r = 0; r < 3; r++) {
+    for (c = 0; c < 3; c++)
+      comp->inverse_transform.m[r][c] = m[c * 4 + r];
+
+    comp->inverse_transform.m[r][3] =
+        -(m[0 * 4 + r] * m[3] + m[1 * 4 + r] * m[7] + m[2 * 4 + r] * m[11]);
+  }
+  comp->inverse_transform.m[3][3] = 1.0;
+
+  z_axis.x = m[2];
+  z_axis.y = m[6];
+  z_axis.z = m[10];
+  comp->normal = normalise_vector(&z_axis);
+}
+
+// Flat buffers are public and int-indexed, so they stop short of INT_MAX
+static int collect_joints(const JointArray *arr, int component,
+                          FlatJoints *out) {
+  uint32_t k;
+
+  if (arr->count > (uint32_t)(INT_MAX / 2 - out->count))
+    return -1;
+  if (out->count + (int)arr->count > out->capacity) {
+    int new_capacity = out->capacity ? out->capacity : 16;
+    double *segments;
+    unsigned char *types;
+    int *components;
+    double *widths;
+
+    while (new_capacity < out->count + (int)arr->count)
+      new_capacity *= 2;
+
+    segments = realloc(out->segments, sizeof(double) * 6 * new_capacity);
+    if (!segments)
+      return -1;
+    out->segments = segments;
+
+    types = realloc(out->types, new_capacity);
+    if (!types)
+      return -1;
+    out->types = types;
+
+    components = realloc(out->components, sizeof(int) * new_capacity);
+    if (!components)
+      return -1;
+    out->components = components;
+
+    widths = realloc(out->widths, sizeof(double) * new_capacity);
+    if (!widths)
+      return -1;
+    out->widths = widths;
+
+    out->capacity = new_capacity;
+  }
+
+  for (k = 0; k < arr->count; k++) {
+    const Segment3D *seg = &arr->data[k].segment;
+    double *dst = &out->segments[out->count * 6];
+
+    dst[0] = seg->start.x;
+    dst[1] = seg->start.y;
+    dst[2] = seg->start.z;
+    dst[3] = seg->end.x;
+    dst[4] = seg->end.y;
+    dst[5] = seg->end.z;
+    out->types[out->count] = (unsigned char)arr->data[k].type;
+    out->components[out->count] = component;
+    out->widths[out->count] = arr->data[k].width;
+    out->count++;
+  }
+
+  return 0;
+}
+
+// Buffers present and offsets starting at or after 0 and never decreasing,
+// so every component reads a forward run of the vertex buffer
+static int flat_assembly_valid(const FlatAssembly *assembly) {
+  int i;
+
+  if (!assembly || assembly->count <= 0 || !assembly->vertex_offsets ||
+      !assembly->transforms || assembly->vertex_offsets[0] < 0)
+    return 0;
+  for (i = 0; i < assembly->count; i++)
+    if (assembly->vertex_offsets[i + 1] < assembly->vertex_offsets[i])
+      return 0;
+
+  return assembly->vertices ||
+         assembly->vertex_offsets[assembly->count] ==
+             assembly->vertex_offsets[0];
+}
+
+int detect_flat_assembly(const FlatAssembly *assembly, FlatJoints *joints) {
+  ComponentArray *components;
+  uint32_t i, count;
+  int status = 0;
+
+  if (!joints || !flat_assembly_valid(assembly))
+    return -1;
+
+  count = (uint32_t)assembly->count;
+  components = create_component_array(count);
+  if (!components)
+    return -1;
+
+  for (i = 0; i < count; i++) {
+    Component3D *comp = &components->components[i];
+    int first = assembly->vertex_offsets[i];
+
+    init_component(comp, assembly->ids ? assembly->ids[i] : (int)i + 1);
+    components->count++;
+
+    // Borrowed from the caller: never freed by cleanup_component
+    comp->vertices = (Vector3D *)(assembly->vertices + 3 * first);
+    comp->vertex_count = (uint32_t)(assembly->vertex_offsets[i + 1] - first);
+    load_flat_transform(comp, assembly->transforms + 16 * i);
+  }
+
+  if (detect_component_intersections(components) != 0)
+    status = -1;
+
+  for (i = 0; i < components->count && status == 0; i++) {
+    const Component3D *comp = &components->components[i];
+
+    if (collect_joints(&comp->fingers, (int)i, joints) != 0 ||
+        collect_joints(&comp->holes, (int)i, joints) != 0 ||
+        collect_joints(&comp->slots, (int)i, joints) != 0)
+      status = -1;
+  }
+
+  for (i = 0; i < components->count; i++)
+    components->components[i].vertices = NULL;
+  destroy_component_array(components);
+
+  return status;
+}
+
+void free_flat_joints(FlatJoints *joints) {
+  if (joints) {
+    free(joints->segments);
+    free(joints->types);
+    free(joints->components);
+    free(joints->widths);
+    joints->segments = NULL;
+    joints->types = NULL;
+    joints->components = NULL;
+    joints->widths = NULL;
+    joints->count = joints->capacity = 0;
+  }
+}
+
+/* Context API (see 3d_detection_algo.h) */
+
+#define PIPELINE_PREFETCH_DISTANCE 8 // default candidate pair lookahead
+
+struct DetectionContext {
+  ComponentArray *components; // vertices owned, unlike the flat interface
+  DetectionStats stats;
+  Arena component_arena; // components->components
+  Arena vertex_arena;    // every comp->vertices
+  Arena joint_arena;     // fingers, holes and slots
+  // NUMA placement by detection_run_async(): per-node arenas holding each
+  // partition's vertices and joints, and the row bounds last placed
+  Arena *node_arenas;
+  int node_arena_count;
+  int *placed_rows;
+  int placed_nodes; // 0: nothing placed for the current assembly
+  int prefetch_distance; // candidate pairs fetched ahead, 0 disables
+  int quantize_vertices;
+  double simplify_tolerance; // 0 keeps outlines as added
+  double thickness;          // given to components as they are added
+  int merge_joints;          // fuse collinear joints after each run
+  int merge_faces;           // phase 1 coplanar face merging, on by default
+  char *trace_path;          // detection_run() records a trace here if set
+};
+
+#define DETECTION_STRINGIFY_(x) #x
+#define DETECTION_STRINGIFY(x) DETECTION_STRINGIFY_(x)
+
+const char *detection_version(void) {
+  return DETECTION_STRINGIFY(DETECTION_VERSION_MAJOR) "." DETECTION_STRINGIFY(
+      DETECTION_VERSION_MINOR);
+}
+
+// Grow by doubling; the new slot is initialised with an identity transform
+// and joint arrays taken from the joints arena (heap if NULL)
+static Component3D *append_component(ComponentArray *arr, int id,
+                                     Arena *joints) {
+  Component3D *comp;
+
+  if (arr->count >= arr->capacity) {
+    uint32_t new_capacity = grow_capacity(arr->capacity, 8);
+    Component3D *new_components;
+
+    if (!new_capacity)
+      return NULL;
+    if (arr->arena) {
+      new_components =
+          arena_alloc(arr->arena, sizeof(Component3D) * new_capacity);
+      if (new_components && arr->count > 0)
+        memcpy(new_components, arr->components,
+               sizeof(Component3D) * arr->count);
+    } else {
+      new_components =
+          realloc(arr->components, sizeof(Component3D) * new_capacity);
+    }
+
+    if (!new_components)
+      return NULL;
+
+    arr->components = new_components;
+    arr->capacity = new_capacity;
+  }
+
+  comp = &arr->components[arr->count];
+  init_component_in(comp, id, joints);
+  if (!comp->fingers.data || !comp->holes.data || !comp->slots.data) {
+    cleanup_component(comp);
+    return NULL;
+  }
+  arr->count++;
+
+  return comp;
+}
+
+DetectionContext *detection_context_create(void) {
+  DetectionContext *ctx = calloc(1, sizeof(DetectionContext));
+
+  if (!ctx)
+    return NULL;
+
+  // Empty store; the first append takes its block from the arena
+  ctx->components = calloc(1, sizeof(ComponentArray));
+  if (!ctx->components) {
+    free(ctx);
+    return NULL;
+  }
+  ctx->components->arena = &ctx->component_arena;
+  ctx->prefetch_distance = PIPELINE_PREFETCH_DISTANCE;
+  ctx->merge_faces = 1;
+
+  return ctx;
+}
+
+// Vertices live in the vertex arena, so detach them before the per-component
+// cleanup frees what it thinks it owns
+static void release_components(DetectionContext *ctx) {
+  uint32_t i;
+
+  for (i = 0; i < ctx->components->count; i++) {
+    ctx->components->components[i].vertices = NULL;
+    ctx->components->components[i].quantized = NULL;
+    ctx->components->components[i].bulges = NULL;
+    ctx->components->components[i].source = NULL;
+    ctx->components->components[i].next = NULL;
+    cleanup_component(&ctx->components->components[i]);
+  }
+  ctx->components->count = 0;
+}
+
+void detection_context_destroy(DetectionContext *ctx) {
+  if (ctx) {
+    int i;
+
+    release_components(ctx);
+    destroy_component_array(ctx->components);
+    arena_release(&ctx->component_arena);
+    arena_release(&ctx->vertex_arena);
+    arena_release(&ctx->joint_arena);
+    for (i = 0; i < ctx->node_arena_count; i++)
+      arena_release(&ctx->node_arenas[i]);
+    free(ctx->node_arenas);
+    free(ctx->placed_rows);
+    free(ctx->trace_path);
+    free(ctx);
+  }
+}
+
+void detection_context_clear(DetectionContext *ctx) {
+  int i;
+
+  if (!ctx)
+    return;
+
+  // The component store keeps its block for the next assembly
+  release_components(ctx);
+  arena_reset(&ctx->vertex_arena);
+  arena_reset(&ctx->joint_arena);
+  for (i = 0; i < ctx->node_arena_count; i++)
+    arena_reset(&ctx->node_arenas[i]);
+  ctx->placed_nodes = 0;
+  memset(&ctx->stats, 0, sizeof(DetectionStats));
+}
+
+int detection_context_set_huge_pages(DetectionContext *ctx, int enabled) {
+  int i;
+
+  if (!ctx)
+    return -1;
+#ifndef DETECTION_HUGE_PAGES
+  if (enabled)
+    return -1;
+#endif
+
+  ctx->component_arena.huge_pages = enabled != 0;
+  ctx->vertex_arena.huge_pages = enabled != 0;
+  ctx->joint_arena.huge_pages = enabled != 0;
+  for (i = 0; i < ctx->node_arena_count; i++)
+    ctx->node_arenas[i].huge_pages = enabled != 0;
+
+  return 0;
+}
+
+static void add_arena_memory(DetectionMemory *memory, const Arena *arena) {
+  memory->reserved += arena->reserved;
+  memory->huge_page_backed += arena->huge_reserved;
+}
+
+int detection_get_memory(const DetectionContext *ctx, DetectionMemory *memory) {
+  uint32_t c;
+  int i;
+
+  if (!ctx || !memory)
+    return -1;
+
+  memory->reserved = memory->huge_page_backed = memory->outlines = 0;
+  for (c = 0; c < ctx->components->count; c++) {
+    const Component3D *comp = &ctx->components->components[c];
+
+    memory->outlines += comp->quantized
+                            ? quantized_size(comp->vertex_count)
+                            : sizeof(Vector3D) * comp->vertex_count;
+    if (comp->bulges)
+      memory->outlines += sizeof(double) * comp->vertex_count;
+    if (comp->source)
+      memory->outlines += sizeof(Vector3D) * comp->source->count +
+                          sizeof(uint32_t) * comp->vertex_count;
+    if (comp->next)
+      memory->outlines += sizeof(uint32_t) * comp->vertex_count;
+  }
+  add_arena_memory(memory, &ctx->component_arena);
+  add_arena_memory(memory, &ctx->vertex_arena);
+  add_arena_memory(memory, &ctx->joint_arena);
+  for (i = 0; i < ctx->node_arena_count; i++)
+    add_arena_memory(memory, &ctx->node_arenas[i]);
+
+  return 0;
+}
+
+int detection_context_set_joint_merging(DetectionContext *ctx, int enabled) {
+  if (!ctx)
+    return -1;
+
+  ctx->merge_joints = enabled != 0;
+
+  return 0;
+}
+
+int detection_context_set_face_merging(DetectionContext *ctx, int enabled) {
+  if (!ctx)
+    return -1;
+
+  ctx->merge_faces = enabled != 0;
+
+  return 0;
+}
+
+int detection_context_set_trace_path(DetectionContext *ctx, const char *path) {
+  char *copy = NULL;
+
+  if (!ctx)
+    return -1;
+
+  if (path) {
+    size_t length = strlen(path) + 1;
+
+    copy = malloc(length);
+    if (!copy)
+      return -1;
+    memcpy(copy, path, length);
+  }
+  free(ctx->trace_path);
+  ctx->trace_path = copy;
+
+  return 0;
+}
+
+int detection_context_set_vertex_quantization(DetectionContext *ctx,
+                                              int enabled) {
+  if (!ctx)
+    return -1;
+
+  ctx->quantize_vertices = enabled != 0;
+
+  return 0;
+}
+
+// 16-bit copy of a flat xyz outline, or NULL if it leaves the local z = 0
+// plane (or allocation fails) and must stay in doubles
+static QuantizedOutline *quantize_outline(Arena *arena, const double *xyz,
+                                          uint32_t count) {
+  QuantizedOutline *q;
+  double min[2], max[2];
+  uint32_t v;
+  int axis;
+
+  for (v = 0; v < count; v++) {
+    if (fabs(xyz[3 * v + 2]) > EPSILON)
+      return NULL;
+    for (axis = 0; axis < 2; axis++) {
+      double c = xyz[3 * v + axis];
+
+      if (v == 0 || c < min[axis])
+        min[axis] = c;
+      if (v == 0 || c > max[axis])
+        max[axis] = c;
+    }
+  }
+
+  q = arena_alloc(arena, quantized_size(count));
+  if (!q)
+    return NULL;
+
+  for (axis = 0; axis < 2; axis++) {
+    q->origin[axis] = min[axis];
+    q->scale[axis] = (max[axis] - min[axis]) / 65535.0;
+  }
+  for (v = 0; v < count; v++)
+    for (axis = 0; axis < 2; axis++) {
+      double steps = q->scale[axis] > 0.0
+                         ? (xyz[3 * v + axis] - min[axis]) / q->scale[axis]
+                         : 0.0;
+
+      q->xy[2 * v + axis] = (uint16_t)(steps + 0.5);
+    }
+
+  return q;
+}
+
+int detection_context_set_simplify_tolerance(DetectionContext *ctx,
+                                             double tolerance) {
+  if (!ctx || !(tolerance >= 0.0))
+    return -1;
+
+  ctx->simplify_tolerance = tolerance;
+
+  return 0;
+}
+
+int detection_context_set_thickness(DetectionContext *ctx, double thickness) {
+  if (!ctx || !(thickness >= 0.0) || thickness == HUGE_VAL)
+    return -1;
+
+  ctx->thickness = thickness;
+
+  return 0;
+}
+
+// Squared distance from xyz vertex p to the segment between vertices a, b
+static double vertex_distance2(const double *p, const double *a,
+                               const double *b) {
+  double e[3], d[3], length2 = 0.0, t = 0.0, distance2 = 0.0;
+  int axis;
+
+  for (axis = 0; axis < 3; axis++) {
+    e[axis] = b[axis] - a[axis];
+    d[axis] = p[axis] - a[axis];
+    length2 += e[axis] * e[axis];
+    t += d[axis] * e[axis];
+  }
+  t = length2 > 0.0 ? t / length2 : 0.0;
+  t = t < 0.0 ? 0.0 : t > 1.0 ? 1.0 : t;
+  for (axis = 0; axis < 3; axis++) {
+    double r = d[axis] - e[axis] * t;
+
+    distance2 += r * r;
+  }
+
+  return distance2;
+}
+
+/*
+ * Douglas-Peucker over a closed outline: sets keep[v] for the vertices that
+ * hold every dropped one within tolerance of the simplified edge spanning
+ * it. Arc edges are never merged, so their end vertices anchor the runs of
+ * straight edges between them; a straight outline is anchored at vertex 0
+ * and the vertex farthest from it. Returns the number kept, 0 on failure.
+ */
+static uint32_t simplify_outline(const double *xyz, const double *bulges,
+                                 uint32_t count, double tolerance,
+                                 unsigned char *keep) {
+  uint32_t *stack = malloc(sizeof(uint32_t) * 2 * count);
+  uint32_t v, first = count, kept = 0, anchors = 0;
+
+  if (!stack)
+    return 0;
+
+  for (v = 0; v < count; v++) {
+    keep[v] = bulges && (bulges[v] != 0.0 ||
+                         bulges[(v + count - 1) % count] != 0.0);
+    anchors += keep[v];
+  }
+  if (anchors < 2) {
+    uint32_t from = 0, far = 0;
+    double farthest = -1.0;
+
+    while (anchors && !keep[from])
+      from++;
+    keep[from] = 1;
+    for (v = 0; v < count; v++) {
+      double distance = vertex_distance2(&xyz[3 * v], &xyz[3 * from],
+                                         &xyz[3 * from]);
+
+      if (distance > farthest) {
+        farthest = distance;
+        far = v;
+      }
+    }
+    keep[far] = 1;
+  }
+
+  // Each run from one anchor to the next, as offsets past the first anchor
+  for (v = 0; v < count; v++)
+    if (keep[v]) {
+      first = v;
+      break;
+    }
+  for (v = 1; v <= count; v++) {
+    uint32_t run = (first + v) % count, start, top = 0;
+
+    if (!keep[run])
+      continue;
+    start = first + v;
+    // start walks back to the previous anchor
+    do
+      start--;
+    while (!keep[start % count]);
+    if (first + v - start < 2)
+      continue;
+
+    stack[top++] = start;
+    stack[top++] = first + v;
+    while (top > 0) {
+      uint32_t hi = stack[--top], lo = stack[--top], k, split = lo;
+      double worst = -1.0;
+
+      for (k = lo + 1; k < hi; k++) {
+        double distance =
+            vertex_distance2(&xyz[3 * (k % count)], &xyz[3 * (lo % count)],
+                             &xyz[3 * (hi % count)]);
+
+        if (distance > worst) {
+          worst = distance;
+          split = k;
+        }
+      }
+      if (worst > tolerance * tolerance) {
+        keep[split % count] = 1;
+        stack[top++] = lo;
+        stack[top++] = split;
+        stack[top++] = split;
+        stack[top++] = hi;
+      }
+    }
+  }
+  free(stack);
+
+  for (v = 0; v < count; v++)
+    kept += keep[v];
+
+  return kept;
+}
+
+int detection_add_component(DetectionContext *ctx, int id,
+                            const double *vertices, int vertex_count,
+                            const double *transform) {
+  return detection_add_curved_component(ctx, id, vertices, NULL, vertex_count,
+                                        transform);
+}
+
+// Flattened edge table for an outline of loop_count loops, loop l running
+// from vertex starts[l] to the next loop's start; *next stays NULL for a
+// single loop, where edges simply wrap. Returns 0 or -1.
+static int build_edge_table(Arena *arena, const int *starts, int loop_count,
+                            uint32_t vertex_count, uint32_t **next) {
+  uint32_t *table;
+  int l;
+
+  *next = NULL;
+  if (loop_count <= 1)
+    return 0;
+
+  table = arena_alloc(arena, sizeof(uint32_t) * vertex_count);
+  if (!table)
+    return -1;
+  for (l = 0; l < loop_count; l++) {
+    uint32_t first = (uint32_t)starts[l], v;
+    uint32_t end = l + 1 < loop_count ? (uint32_t)starts[l + 1] : vertex_count;
+
+    for (v = first; v < end; v++)
+      table[v] = v + 1 < end ? v + 1 : first;
+  }
+  *next = table;
+
+  return 0;
+}
+
+// Copies an outline into comp from the context's vertex arena
+static int store_outline(DetectionContext *ctx, Component3D *comp,
+                         const double *vertices, const double *bulges,
+                         uint32_t vertex_count, const int *starts,
+                         int loop_count) {
+  uint32_t v;
+
+  if (vertex_count > 0 && ctx->quantize_vertices)
+    comp->quantized =
+        quantize_outline(&ctx->vertex_arena, vertices, vertex_count);
+
+  if (!comp->quantized && vertex_count > 0) {
+    comp->vertices =
+        arena_alloc(&ctx->vertex_arena, sizeof(Vector3D) * vertex_count);
+    if (!comp->vertices)
+      return -1;
+    memcpy(comp->vertices, vertices, sizeof(Vector3D) * vertex_count);
+  }
+  comp->vertex_count = vertex_count;
+
+  // All-straight outlines keep no bulges at all
+  for (v = 0; bulges && v < vertex_count; v++)
+    if (bulges[v] != 0.0)
+      break;
+  if (bulges && v < vertex_count) {
+    comp->bulges =
+        arena_alloc(&ctx->vertex_arena, sizeof(double) * vertex_count);
+    if (!comp->bulges)
+      return -1;
+    memcpy(comp->bulges, bulges, sizeof(double) * vertex_count);
+  }
+
+  return build_edge_table(&ctx->vertex_arena, starts, loop_count,
+                          vertex_count, &comp->next);
+}
+
+// Stores the simplified outline and the original behind it, simplifying
+// each loop on its own; 1 when nothing simplified and the outline should
+// be stored as is
+static int store_simplified(DetectionContext *ctx, Component3D *comp,
+                            const double *vertices, const double *bulges,
+                            uint32_t vertex_count, const int *starts,
+                            int loop_count) {
+  unsigned char *keep = malloc(vertex_count);
+  double *xyz = malloc(sizeof(double) * 3 * vertex_count);
+  double *arcs = bulges ? malloc(sizeof(double) * vertex_count) : NULL;
+  int *kept_starts = malloc(sizeof(int) * loop_count);
+  uint32_t kept = 0, v, k = 0;
+  OutlineSource *source;
+  int status = 1, l;
+
+  if (!keep || !xyz || (bulges && !arcs) || !kept_starts)
+    goto done;
+
+  for (l = 0; l < loop_count; l++) {
+    uint32_t first = (uint32_t)starts[l];
+    uint32_t count =
+        (l + 1 < loop_count ? (uint32_t)starts[l + 1] : vertex_count) - first;
+    uint32_t loop_kept = count;
+
+    kept_starts[l] = (int)kept;
+    if (count > 3) {
+      loop_kept = simplify_outline(&vertices[3 * first],
+                                   bulges ? &bulges[first] : NULL, count,
+                                   ctx->simplify_tolerance, &keep[first]);
+      if (loop_kept == 0)
+        goto done;
+    }
+    // Loops too thin to survive as polygons are kept whole
+    if (count <= 3 || (loop_kept < 3 && !bulges)) {
+      memset(&keep[first], 1, count);
+      loop_kept = count;
+    }
+    kept += loop_kept;
+  }
+  if (kept == vertex_count)
+    goto done;
+
+  status = -1;
+  source = arena_alloc(&ctx->vertex_arena,
+                       sizeof(OutlineSource) + sizeof(uint32_t) * kept);
+  if (!source)
+    goto done;
+  source->vertices =
+      arena_alloc(&ctx->vertex_arena, sizeof(Vector3D) * vertex_count);
+  if (!source->vertices ||
+      build_edge_table(&ctx->vertex_arena, starts, loop_count, vertex_count,
+                       &source->next) != 0)
+    goto done;
+  memcpy(source->vertices, vertices, sizeof(Vector3D) * vertex_count);
+  source->count = vertex_count;
+
+  for (v = 0; v < vertex_count; v++) {
+    if (!keep[v])
+      continue;
+    memcpy(&xyz[3 * k], &vertices[3 * v], sizeof(double) * 3);
+    if (arcs)
+      arcs[k] = bulges[v];
+    source->first_edge[k++] = v;
+  }
+
+  status = store_outline(ctx, comp, xyz, arcs, kept, kept_starts, loop_count);
+  if (status == 0)
+    comp->source = source;
+
+done:
+  free(keep);
+  free(xyz);
+  free(arcs);
+  free(kept_starts);
+
+  return status;
+}
+
+// Removes the most recently appended component; its outline storage
+// belongs to the arena and stays there until the context is cleared
+static void drop_last_component(DetectionContext *ctx) {
+  Component3D *comp = &ctx->components->components[ctx->components->count - 1];
+
+  comp->vertices = NULL;
+  comp->quantized = NULL;
+  comp->bulges = NULL;
+  comp->source = NULL;
+  comp->next = NULL;
+  cleanup_component(comp);
+  ctx->components->count--;
+}
+
+int detection_add_curved_component(DetectionContext *ctx, int id,
+                                   const double *vertices,
+                                   const double *bulges, int vertex_count,
+                                   const double *transform) {
+  return detection_add_component_loops(ctx, id, vertices, bulges,
+                                       vertex_count, NULL, 1, transform);
+}
+
+int detection_add_component_loops(DetectionContext *ctx, int id,
+                                  const double *vertices,
+                                  const double *bulges, int vertex_count,
+                                  const int *loop_starts, int loop_count,
+                                  const double *transform) {
+  static const int single_loop = 0;
+  const int *starts = loop_starts ? loop_starts : &single_loop;
+  Component3D *comp;
+  int status = 1, l;
+
+  // Indices are handed out as int
+  if (!ctx || vertex_count < 0 || (vertex_count > 0 && !vertices) ||
+      ctx->components->count >= INT_MAX || loop_count < 1 ||
+      (loop_count > 1 && !loop_starts))
+    return -1;
+  // Loops start at vertex 0 and each holds at least one vertex
+  if (starts[0] != 0)
+    return -1;
+  for (l = 1; l < loop_count; l++)
+    if (starts[l] <= starts[l - 1] || starts[l] >= vertex_count)
+      return -1;
+
+  comp = append_component(ctx->components, id, &ctx->joint_arena);
+  if (!comp)
+    return -1;
+  ctx->placed_nodes = 0;
+
+  if (ctx->simplify_tolerance > 0.0 && vertex_count > 3)
+    status = store_simplified(ctx, comp, vertices, bulges,
+                              (uint32_t)vertex_count, starts, loop_count);
+  if (status == 1)
+    status = store_outline(ctx, comp, vertices, bulges,
+                           (uint32_t)vertex_count, starts, loop_count);
+  if (status != 0) {
+    drop_last_component(ctx);
+    return -1;
+  }
+
+  if (transform)
+    load_flat_transform(comp, transform);
+  comp->thickness = ctx->thickness;
+
+  return (int)ctx->components->count - 1;
+}
+
+int detection_add_flat_assembly(DetectionContext *ctx,
+                                const FlatAssembly *assembly) {
+  uint32_t added;
+  int i;
+
+  if (!ctx || !flat_assembly_valid(assembly))
+    return -1;
+
+  added = ctx->components->count;
+  for (i = 0; i < assembly->count; i++) {
+    int first = assembly->vertex_offsets[i];
+    int count = assembly->vertex_offsets[i + 1] - first;
+
+    if (detection_add_component(
+            ctx, assembly->ids ? assembly->ids[i] : i + 1,
+            assembly->vertices + 3 * first, count,
+            assembly->transforms + 16 * i) < 0) {
+      // All or nothing: take back the components already added
+      while (ctx->components->count > added)
+        drop_last_component(ctx);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+int detection_component_count(const DetectionContext *ctx) {
+  return ctx ? (int)ctx->components->count : 0;
+}
+
+int detection_component_face(const DetectionContext *ctx, int component) {
+  const Component3D *comp;
+
+  if (!ctx || component < 0 || (uint32_t)component >= ctx->components->count)
+    return -1;
+
+  comp = &ctx->components->components[component];
+
+  return comp->merged_into ? (int)comp->merged_into - 1 : component;
+}
+
+/*
+ * Collinear joint merging: joints of one list (fingers, holes or slots) of
+ * one component are keyed by their supporting line in the local xy plane,
+ * sorted, and overlapping or abutting intervals of equal width along each
+ * line fused, O(k log k) per list.
+ */
+#define JOINT_ANGLE_TOLERANCE 1e-9 // radians; adjacent lines within it merge
+#define JOINT_HALF_TURN 3.14159265358979323846 // M_PI is not C99
+
+typedef struct {
+  uint32_t direction; // first run of its angle group once sorted
+  double angle;       // direction in [0, pi), shared across the group
+  double offset;      // signed distance of the line from the origin
+  double t0, t1;      // interval along the direction, t0 <= t1
+  double width;
+  uint32_t first;     // lowest source joint, keeps the output order stable
+  uint32_t count;     // source joints fused into this one
+} JointRun;
+
+static int compare_runs_by_angle(const void *a, const void *b) {
+  double aa = ((const JointRun *)a)->angle, ab = ((const JointRun *)b)->angle;
+
+  return (aa > ab) - (aa < ab);
+}
+
+static int compare_runs_by_line(const void *a, const void *b) {
+  const JointRun *ra = a, *rb = b;
+
+  if (ra->direction != rb->direction)
+    return ra->direction < rb->direction ? -1 : 1;
+
+  return (ra->offset > rb->offset) - (ra->offset < rb->offset);
+}
+
+static int compare_runs_by_start(const void *a, const void *b) {
+  double ta = ((const JointRun *)a)->t0, tb = ((const JointRun *)b)->t0;
+
+  return (ta > tb) - (ta < tb);
+}
+
+static int compare_runs_by_first(const void *a, const void *b) {
+  uint32_t fa = ((const JointRun *)a)->first, fb = ((const JointRun *)b)->first;
+
+  return (fa > fb) - (fa < fb);
+}
+
+// Fuses one joint list in place; runs is scratch space for arr->count
+static void merge_joint_list(JointArray *arr, JointRun *runs) {
+  uint32_t k, group, end, out_start, count = 0;
+
+  if (arr->count < 2)
+    return;
+
+  for (k = 0; k < arr->count; k++) {
+    const Segment3D *seg = &arr->data[k].segment;
+    double angle = atan2(seg->end.y - seg->start.y, seg->end.x - seg->start.x);
+
+    // Both directions along a line share one angle
+    if (angle < 0.0)
+      angle += JOINT_HALF_TURN;
+    if (angle >= JOINT_HALF_TURN - JOINT_ANGLE_TOLERANCE)
+      angle -= JOINT_HALF_TURN;
+    runs[k].angle = angle;
+    runs[k].first = k;
+  }
+  qsort(runs, arr->count, sizeof(JointRun), compare_runs_by_angle);
+
+  // Neighbours within the tolerance share a direction, the run's first
+  // angle, so their offsets and intervals are measured along one line
+  for (k = 0; k < arr->count; k++) {
+    const Segment3D *seg = &arr->data[runs[k].first].segment;
+    double c, s, ts, te;
+
+    if (k == 0 || runs[k].angle - runs[k - 1].angle > JOINT_ANGLE_TOLERANCE)
+      group = k;
+    else
+      runs[k].angle = runs[group].angle;
+    c = cos(runs[k].angle);
+    s = sin(runs[k].angle);
+    ts = c * seg->start.x + s * seg->start.y;
+    te = c * seg->end.x + s * seg->end.y;
+
+    runs[k].direction = group;
+    runs[k].offset = c * seg->start.y - s * seg->start.x;
+    runs[k].t0 = ts < te ? ts : te;
+    runs[k].t1 = ts < te ? te : ts;
+    runs[k].width = arr->data[runs[k].first].width;
+    runs[k].count = 1;
+  }
+  qsort(runs, arr->count, sizeof(JointRun), compare_runs_by_line);
+
+  // Each line's joints in order along it, fused into the front of runs
+  for (group = 0; group < arr->count; group = end) {
+    for (end = group + 1;
+         end < arr->count && runs[end].direction == runs[group].direction &&
+         runs[end].offset - runs[end - 1].offset <= EDGE_TOLERANCE;
+         end++)
+      ;
+    if (end - group > 1)
+      qsort(&runs[group], end - group, sizeof(JointRun),
+            compare_runs_by_start);
+
+    // Earlier lines may have fused, leaving the output behind group
+    out_start = count;
+    for (k = group; k < end; k++) {
+      JointRun *last = count > out_start ? &runs[count - 1] : NULL;
+
+      if (last && runs[k].t0 <= last->t1 + EDGE_TOLERANCE &&
+          fabs(runs[k].width - last->width) <= EDGE_TOLERANCE) {
+        if (runs[k].t1 > last->t1)
+          last->t1 = runs[k].t1;
+        if (runs[k].first < last->first)
+          last->first = runs[k].first;
+        last->count += runs[k].count;
+      } else {
+        runs[count++] = runs[k];
+      }
+    }
+  }
+  if (count == arr->count)
+    return;
+  qsort(runs, count, sizeof(JointRun), compare_runs_by_first);
+
+  // Output k comes from source first >= k, which is still unwritten
+  for (k = 0; k < count; k++) {
+    const JointRun *run = &runs[k];
+    Joint joint = arr->data[run->first];
+
+    if (run->count > 1) {
+      const Segment3D *seg = &arr->data[run->first].segment;
+      double c = cos(run->angle), s = sin(run->angle);
+      double t0 = run->t0, t1 = run->t1;
+
+      // Keep the direction of the earliest source
+      if (c * (seg->end.x - seg->start.x) + s * (seg->end.y - seg->start.y) <
+          0.0) {
+        t0 = run->t1;
+        t1 = run->t0;
+      }
+      joint.segment.start.x = c * t0 - s * run->offset;
+      joint.segment.start.y = s * t0 + c * run->offset;
+      joint.segment.end.x = c * t1 - s * run->offset;
+      joint.segment.end.y = s * t1 + c * run->offset;
+      joint.segment.end.z = joint.segment.start.z;
+    }
+    arr->data[k] = joint;
+  }
+  arr->count = count;
+}
+
+// Allocation failure leaves joints unmerged
+static void merge_collinear_joints(ComponentArray *components) {
+  JointRun *runs = NULL;
+  uint32_t capacity = 0, i;
+  int list;
+
+  for (i = 0; i < components->count; i++) {
+    Component3D *comp = &components->components[i];
+    JointArray *lists[3];
+
+    lists[0] = &comp->fingers;
+    lists[1] = &comp->holes;
+    lists[2] = &comp->slots;
+    for (list = 0; list < 3; list++) {
+      if (lists[list]->count > capacity) {
+        JointRun *grown =
+            realloc(runs, sizeof(JointRun) * lists[list]->count);
+
+        if (!grown)
+          continue;
+        runs = grown;
+        capacity = lists[list]->count;
+      }
+      merge_joint_list(lists[list], runs);
+    }
+  }
+  free(runs);
+}
+
+// Clear joints and stats from the previous run
+static void begin_run(DetectionContext *ctx) {
+  ComponentArray *components = ctx->components;
+  uint32_t i;
+
+  memset(&ctx->stats, 0, sizeof(DetectionStats));
+  for (i = 0; i < components->count; i++) {
+    Component3D *comp = &components->components[i];
+
+    comp->fingers.count = comp->holes.count = comp->slots.count = 0;
+    ctx->stats.vertices += (int)comp->vertex_count;
+  }
+  ctx->stats.components = (int)components->count;
+  prepare_edge_trees(components);
+  if (ctx->merge_faces)
+    ctx->stats.components_merged = merge_coplanar_components(components);
+  else
+    unmerge_components(components);
+}
+
+static void tally_joints(DetectionContext *ctx) {
+  DetectionStats *stats = &ctx->stats;
+  uint32_t i;
+
+  for (i = 0; i < ctx->components->count; i++) {
+    const Component3D *comp = &ctx->components->components[i];
+
+    stats->joints[FLAT_FINGER_JOINT] += (int)comp->fingers.count;
+    stats->joints[FLAT_HOLE_JOINT] += (int)comp->holes.count;
+    stats->joints[FLAT_SLOT_JOINT] += (int)comp->slots.count;
+  }
+  stats->joint_count = stats->joints[FLAT_FINGER_JOINT] +
+                       stats->joints[FLAT_HOLE_JOINT] +
+                       stats->joints[FLAT_SLOT_JOINT];
+}
+
+// Post-passes over the finished joints, then the joint counters
+static void end_run(DetectionContext *ctx) {
+  if (ctx->merge_joints)
+    merge_collinear_joints(ctx->components);
+  tally_joints(ctx);
+}
+
+int detection_run(DetectionContext *ctx) {
+  DetectionTrace *trace;
+
+  if (!ctx || ctx->components->count == 0)
+    return -1;
+
+  trace = trace_open(ctx->trace_path, ctx->components);
+  if (ctx->trace_path && !trace)
+    return -1;
+
+  begin_run(ctx);
+  find_and_classify_intersections(ctx->components, trace, &ctx->stats);
+  end_run(ctx);
+
+  return trace_close(trace);
+}
+
+int detection_joint_count(const DetectionContext *ctx) {
+  return ctx ? ctx->stats.joint_count : 0;
+}
+
+void detection_joints_begin(const DetectionContext *ctx, int component,
+                            DetectionJointIterator *it) {
+  int count = detection_component_count(ctx);
+
+  it->ctx = ctx;
+  it->list = 0;
+  it->index = 0;
+  if (component < 0) {
+    it->component = 0;
+    it->last_component = count - 1;
+  } else {
+    // Out-of-range components yield an empty walk
+    it->component = component;
+    it->last_component = component < count ? component : -1;
+  }
+}
+
+int detection_joints_next(DetectionJointIterator *it, DetectionJoint *joint) {
+  while (it->ctx && it->component <= it->last_component) {
+    const Component3D *comp = &it->ctx->components->components[it->component];
+    const JointArray *lists[3];
+    const JointArray *arr;
+
+    lists[0] = &comp->fingers;
+    lists[1] = &comp->holes;
+    lists[2] = &comp->slots;
+    arr = lists[it->list];
+
+    if ((uint32_t)it->index < arr->count) {
+      const Joint *src = &arr->data[it->index++];
+
+      joint->type = (int)src->type;
+      joint->component = it->component;
+      joint->component_id = comp->id;
+      joint->segment[0] = src->segment.start.x;
+      joint->segment[1] = src->segment.start.y;
+      joint->segment[2] = src->segment.start.z;
+      joint->segment[3] = src->segment.end.x;
+      joint->segment[4] = src->segment.end.y;
+      joint->segment[5] = src->segment.end.z;
+      joint->edge = src->type == FINGER_JOINT
+                        ? source_edge(comp, &src->segment)
+                        : -1;
+      joint->width = src->width;
+
+      return 1;
+    }
+
+    it->index = 0;
+    if (++it->list == 3) {
+      it->list = 0;
+      it->component++;
+    }
+  }
+
+  return 0;
+}
+
+void detection_get_stats(const DetectionContext *ctx, DetectionStats *stats) {
+  if (ctx)
+    *stats = ctx->stats;
+  else
+    memset(stats, 0, sizeof(DetectionStats));
+}
+
+/* Finger-joint teeth (see 3d_detection_algo.h) */
+
+// One finger joint laid out for cutting, in its component's local frame
+typedef struct {
+  Vector3D ends[2]; // world endpoints
+  Vector3D foot;    // point of its world line nearest the origin
+  Vector3D dir;     // unit world direction, start to end
+  double origin[2]; // joint start
+  double along[2];  // unit, start to end
+  double inward[2]; // unit, into the material
+  double length;
+  double depth;
+  int component;
+  int parent; // mates form a tree; odd is the parity against the parent
+  int odd;
+  double lo, hi; // at a root, the run's extent along its line
+  int lead;      // at a root, the lowest-indexed component's plan
+  double base;   // local position of the run's first slot boundary
+  double step;   // local change per slot, negative if running backwards
+  int slots;     // over the whole run; odd
+  int first;     // first slot cut away: 1 leaves teeth at both ends
+} FingerPlan;
+
+// Orders plans by their line's foot point; exact, so qsort sees a total
+// order and lines within tolerance end up in one window of the sweep
+static int compare_finger_lines(const void *a, const void *b) {
+  const Vector3D *fa = &((const FingerPlan *)a)->foot;
+  const Vector3D *fb = &((const FingerPlan *)b)->foot;
+
+  if (fa->x != fb->x)
+    return fa->x < fb->x ? -1 : 1;
+  if (fa->y != fb->y)
+    return fa->y < fb->y ? -1 : 1;
+
+  return (fa->z > fb->z) - (fa->z < fb->z);
+}
+
+// Position of a world point along plan's line
+static double finger_param(const FingerPlan *plan, const Vector3D *p) {
+  Vector3D d = subtract_vectors(p, &plan->foot);
+
+  return dot_product(&d, &plan->dir);
+}
+
+// Whether b's joint runs along a's world line and overlaps it there
+static int fingers_overlap(const FingerPlan *a, const FingerPlan *b) {
+  Vector3D across = cross_product(&a->dir, &b->dir);
+  double a0, a1, b0, b1;
+
+  if (fabs(a->foot.x - b->foot.x) > EDGE_TOLERANCE ||
+      fabs(a->foot.y - b->foot.y) > EDGE_TOLERANCE ||
+      fabs(a->foot.z - b->foot.z) > EDGE_TOLERANCE ||
+      dot_product(&across, &across) > EDGE_TOLERANCE * EDGE_TOLERANCE)
+    return 0;
+
+  a0 = finger_param(a, &a->ends[0]);
+  a1 = finger_param(a, &a->ends[1]);
+  b0 = finger_param(a, &b->ends[0]);
+  b1 = finger_param(a, &b->ends[1]);
+  if (b1 < b0) {
+    double swap = b0;
+
+    b0 = b1;
+    b1 = swap;
+  }
+
+  return (a1 < b1 ? a1 : b1) - (a0 > b0 ? a0 : b0) > EDGE_TOLERANCE;
+}
+
+// Root of plan p's run, compressing the path; *odd gets p's parity to it
+static int finger_root(FingerPlan *plans, int p, int *odd) {
+  int root = p, parity = 0;
+
+  while (plans[root].parent != root) {
+    parity ^= plans[root].odd;
+    root = plans[root].parent;
+  }
+  *odd = parity;
+  while (p != root) {
+    int next = plans[p].parent, own = plans[p].odd;
+
+    plans[p].parent = root;
+    plans[p].odd = parity;
+    parity ^= own;
+    p = next;
+  }
+
+  return root;
+}
+
+// Mates take opposite slots: join their runs with odd parity between them
+static void join_fingers(FingerPlan *plans, int a, int b) {
+  int odd_a, odd_b;
+  int root_a = finger_root(plans, a, &odd_a);
+  int root_b = finger_root(plans, b, &odd_b);
+
+  if (root_a != root_b) {
+    plans[root_b].parent = root_a;
+    plans[root_b].odd = odd_a ^ odd_b ^ 1;
+  }
+}
+
+// Side of the joint the outline lies on, probed just off it and then half
+// the depth out for slab joints that sit off the edge; 0 if neither
+static int finger_inward(const Component3D *comp, const FingerPlan *plan,
+                         double *inward) {
+  double mx = plan->origin[0] + plan->along[0] * plan->length * 0.5;
+  double my = plan->origin[1] + plan->along[1] * plan->length * 0.5;
+  double lx = -plan->along[1], ly = plan->along[0];
+  double steps[2];
+  int k;
+
+  steps[0] = FACE_SAMPLE;
+  steps[1] = plan->depth * 0.5;
+  for (k = 0; k < 2; k++) {
+    int left = point_in_outline(comp, mx + lx * steps[k], my + ly * steps[k]);
+    int right = point_in_outline(comp, mx - lx * steps[k], my - ly * steps[k]);
+
+    if (left != right) {
+      inward[0] = left ? lx : -lx;
+      inward[1] = left ? ly : -ly;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Every finger joint that can be cut, laid on a slot grid shared with its
+ * mates; returns the plan count or -1. Mates are joints of other components
+ * overlapping it on the same world line. With joint merging one fused joint
+ * can meet several mates, and mates of mates chain further along the line,
+ * so each such run gets one grid over its whole extent and alternate plans
+ * in it take alternate slots; the run's lowest-indexed component keeps the
+ * teeth at both ends.
+ */
+static int plan_fingers(const DetectionContext *ctx,
+                        const DetectionTeethParams *params,
+                        FingerPlan **out) {
+  ComponentArray *components = ctx->components;
+  FingerPlan *plans;
+  uint32_t i, k;
+  int count = 0, p, q;
+
+  *out = NULL;
+  if (ctx->stats.joints[FLAT_FINGER_JOINT] == 0)
+    return 0;
+  plans = malloc(sizeof(FingerPlan) * ctx->stats.joints[FLAT_FINGER_JOINT]);
+  if (!plans)
+    return -1;
+
+  for (i = 0; i < components->count; i++) {
+    const Component3D *comp = &components->components[i];
+    const Component3D *outline = comp->face ? comp->face : comp;
+
+    for (k = 0; k < comp->fingers.count; k++) {
+      const Joint *joint = &comp->fingers.data[k];
+      FingerPlan *plan = &plans[count];
+      double dx = joint->segment.end.x - joint->segment.start.x;
+      double dy = joint->segment.end.y - joint->segment.start.y;
+      double along;
+
+      plan->length = sqrt(dx * dx + dy * dy);
+      plan->depth = params->thickness > 0.0 ? params->thickness : joint->width;
+      if (plan->length < EPSILON || !(plan->depth > 0.0))
+        continue;
+      plan->origin[0] = joint->segment.start.x;
+      plan->origin[1] = joint->segment.start.y;
+      plan->along[0] = dx / plan->length;
+      plan->along[1] = dy / plan->length;
+      if (!finger_inward(outline, plan, plan->inward))
+        continue;
+
+      plan->ends[0] =
+          transform_point(&comp->transform_3d, &joint->segment.start);
+      plan->ends[1] =
+          transform_point(&comp->transform_3d, &joint->segment.end);
+      plan->dir = subtract_vectors(&plan->ends[1], &plan->ends[0]);
+      plan->dir = normalise_vector(&plan->dir);
+      along = dot_product(&plan->ends[0], &plan->dir);
+      plan->foot.x = plan->ends[0].x - plan->dir.x * along;
+      plan->foot.y = plan->ends[0].y - plan->dir.y * along;
+      plan->foot.z = plan->ends[0].z - plan->dir.z * along;
+      plan->component = (int)i;
+      count++;
+    }
+  }
+
+  // Sort and sweep on the foot point: only plans in the window can share
+  // a line
+  if (count > 1)
+    qsort(plans, count, sizeof(FingerPlan), compare_finger_lines);
+  for (p = 0; p < count; p++) {
+    plans[p].parent = p;
+    plans[p].odd = 0;
+    plans[p].lo = HUGE_VAL;
+    plans[p].hi = -HUGE_VAL;
+    plans[p].lead = p;
+  }
+  for (p = 0; p < count; p++)
+    for (q = p + 1;
+         q < count && plans[q].foot.x - plans[p].foot.x <= EDGE_TOLERANCE; q++)
+      if (plans[q].component != plans[p].component &&
+          fingers_overlap(&plans[p], &plans[q]))
+        join_fingers(plans, p, q);
+
+  // Each run's extent along its root's line, and its lead
+  for (p = 0; p < count; p++) {
+    int odd, root = finger_root(plans, p, &odd);
+    FingerPlan *run = &plans[root];
+    double t0 = finger_param(run, &plans[p].ends[0]);
+    double t1 = finger_param(run, &plans[p].ends[1]);
+
+    run->lo = fmin(run->lo, fmin(t0, t1));
+    run->hi = fmax(run->hi, fmax(t0, t1));
+    if (plans[p].component < plans[run->lead].component)
+      run->lead = p;
+  }
+
+  for (p = 0; p < count; p++) {
+    int odd, lead_odd, root = finger_root(plans, p, &odd);
+    const FingerPlan *run = &plans[root];
+    double ratio = (run->hi - run->lo) / params->tooth_width;
+    double start = finger_param(run, &plans[p].ends[0]);
+    double sign = dot_product(&plans[p].dir, &run->dir) < 0.0 ? -1.0 : 1.0;
+
+    if (ratio >= INT_MAX / 4) {
+      free(plans);
+      return -1;
+    }
+    finger_root(plans, run->lead, &lead_odd);
+    plans[p].slots = ratio < 1.0 ? 1 : (int)ratio;
+    plans[p].slots -= plans[p].slots % 2 == 0;
+    plans[p].step = sign * (run->hi - run->lo) / plans[p].slots;
+    plans[p].base = sign * (run->lo - start);
+    plans[p].first = odd == lead_odd;
+  }
+
+  *out = plans;
+
+  return count;
+}
+
+int detection_generate_teeth(const DetectionContext *ctx,
+                             const DetectionTeethParams *params,
+                             double *corners, int *components, int capacity) {
+  FingerPlan *plans;
+  int count, p, total = 0;
+
+  if (!ctx || !params || !(params->tooth_width > 0.0) ||
+      !(params->thickness >= 0.0) || !(params->kerf >= 0.0) ||
+      capacity < 0 || (capacity > 0 && !corners))
+    return -1;
+
+  count = plan_fingers(ctx, params, &plans);
+  if (count < 0)
+    return -1;
+
+  // Straight-line arithmetic per cut from here on
+  for (p = 0; p < count; p++) {
+    const FingerPlan *plan = &plans[p];
+    double half_kerf = params->kerf * 0.5;
+    double ix = plan->inward[0] * plan->depth;
+    double iy = plan->inward[1] * plan->depth;
+    // Counterclockwise: along then inward when the material is on the left
+    int flip = plan->along[0] * plan->inward[1] -
+                   plan->along[1] * plan->inward[0] <
+               0.0;
+    int slot;
+
+    for (slot = plan->first; slot < plan->slots; slot += 2) {
+      double a = plan->base + slot * plan->step;
+      double b = a + plan->step;
+      // Grid boundaries inside the run lose half a kerf, the run's ends and
+      // the ends of this joint do not
+      int low = plan->step > 0.0 ? slot : slot + 1;
+      int high = plan->step > 0.0 ? slot + 1 : slot;
+      double s0 = fmax(fmin(a, b), 0.0), s1 = fmin(fmax(a, b), plan->length);
+      double x0, y0, x1, y1, *out;
+
+      // Slots of the run that fall past this joint belong to another mate
+      if (s1 - s0 <= EPSILON)
+        continue;
+      if (total++ >= capacity)
+        continue;
+      if (low > 0 && low < plan->slots)
+        s0 = fmax(s0, fmin(a, b) + half_kerf);
+      if (high > 0 && high < plan->slots)
+        s1 = fmin(s1, fmax(a, b) - half_kerf);
+      if (s1 < s0)
+        s1 = s0;
+      x0 = plan->origin[0] + plan->along[0] * s0;
+      y0 = plan->origin[1] + plan->along[1] * s0;
+      x1 = plan->origin[0] + plan->along[0] * s1;
+      y1 = plan->origin[1] + plan->along[1] * s1;
+      out = &corners[8 * (total - 1)];
+      out[0] = flip ? x1 : x0;
+      out[1] = flip ? y1 : y0;
+      out[2] = flip ? x0 : x1;
+      out[3] = flip ? y0 : y1;
+      out[4] = (flip ? x0 : x1) + ix;
+      out[5] = (flip ? y0 : y1) + iy;
+      out[6] = (flip ? x1 : x0) + ix;
+      out[7] = (flip ? y1 : y0) + iy;
+      if (components)
+        components[total - 1] = plan->component;
+    }
+  }
+  free(plans);
+
+  return total;
+}
+
+/* Joint offsetting (see 3d_detection_algo.h) */
+
+int detection_offset_joints(const DetectionContext *ctx, int component,
+                            const DetectionOffsetParams *params,
+                            double *corners, int *types, int capacity) {
+  const Component3D *comp;
+  const JointArray *lists[2];
+  int list, total = 0;
+
+  if (!ctx || !params || component < 0 ||
+      (uint32_t)component >= ctx->components->count ||
+      !(params->thickness >= 0.0) || !(params->kerf >= 0.0) ||
+      !(params->clearance >= 0.0) || capacity < 0 ||
+      (capacity > 0 && !corners))
+    return -1;
+
+  comp = &ctx->components->components[component];
+  lists[0] = &comp->holes;
+  lists[1] = &comp->slots;
+
+  // Each opening grows by the clearance on every side, then the beam path
+  // moves half a kerf into it; both are one outset of the joint rectangle
+  for (list = 0; list < 2; list++) {
+    const JointArray *arr = lists[list];
+    uint32_t k;
+
+    for (k = 0; k < arr->count; k++) {
+      const Joint *joint = &arr->data[k];
+      double width = params->thickness > 0.0 ? params->thickness : joint->width;
+      double dx = joint->segment.end.x - joint->segment.start.x;
+      double dy = joint->segment.end.y - joint->segment.start.y;
+      double length = sqrt(dx * dx + dy * dy);
+      double outset = params->clearance - params->kerf * 0.5;
+      double half_length, half_width, cx, cy, ux, uy, ax, ay, wx, wy;
+      double *out;
+
+      if (length < EPSILON || !(width > 0.0))
+        continue;
+      if (total++ >= capacity)
+        continue;
+
+      half_length = fmax(length * 0.5 + outset, 0.0);
+      half_width = fmax(width * 0.5 + outset, 0.0);
+      cx = (joint->segment.start.x + joint->segment.end.x) * 0.5;
+      cy = (joint->segment.start.y + joint->segment.end.y) * 0.5;
+      ux = dx / length;
+      uy = dy / length;
+      ax = ux * half_length;
+      ay = uy * half_length;
+      wx = -uy * half_width;
+      wy = ux * half_width;
+
+      out = &corners[8 * (total - 1)];
+      out[0] = cx - ax - wx;
+      out[1] = cy - ay - wy;
+      out[2] = cx + ax - wx;
+      out[3] = cy + ay - wy;
+      out[4] = cx + ax + wx;
+      out[5] = cy + ay + wy;
+      out[6] = cx - ax + wx;
+      out[7] = cy - ay + wy;
+      if (types)
+        types[total - 1] = (int)joint->type;
+    }
+  }
+
+  return total;
+}
+
+/* Thread pool and tiled asynchronous detection (see 3d_detection_algo.h) */
+
+// Queue node embedded in the work item, so submitting never allocates
+typedef struct PoolJob {
+  void (*run)(struct PoolJob *job);
+  struct PoolJob *next;
+} PoolJob;
+
+typedef struct {
+  PoolJob *head;
+  PoolJob *tail;
+} PoolQueue;
+
+typedef struct {
+  DetectionPool *pool;
+  int node;
+} PoolWorker;
+
+/*
+ * Workers are spread over NUMA nodes in contiguous blocks and pinned to
+ * their node's CPUs. Each node has its own queue, drained only by that
+ * node's workers, so work submitted for a node runs (and first-touches
+ * memory) there; queues[node_count] is shared by everyone.
+ */
+struct DetectionPool {
+#ifndef DETECTION_NO_THREADS
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_t *threads;
+  PoolWorker *workers;
+  PoolQueue *queues;
+  int pending;
+  int stopping;
+#endif
+  int thread_count;
+  int node_count;
+};
+
+#ifdef DETECTION_NUMA
+// Parses a sysfs list such as "0-3,8-11" into set; returns the entry count
+static int parse_cpu_list(const char *list, cpu_set_t *set) {
+  int entries = 0;
+
+  CPU_ZERO(set);
+  while (*list) {
+    char *end;
+    long first = strtol(list, &end, 10), last;
+
+    if (end == list)
+      break;
+    last = first;
+    if (*end == '-')
+      last = strtol(end + 1, &end, 10);
+    for (; first <= last && first < CPU_SETSIZE; first++, entries++)
+      CPU_SET((int)first, set);
+    list = *end == ',' ? end + 1 : end;
+  }
+
+  return entries;
+}
+
+static int read_sysfs_list(const char *path, cpu_set_t *set) {
+  char line[4096];
+  FILE *file = fopen(path, "r");
+  int entries = 0;
+
+  if (!file)
+    return 0;
+  if (fgets(line, sizeof(line), file))
+    entries = parse_cpu_list(line, set);
+  fclose(file);
+
+  return entries;
+}
+
+// CPUs this process may run on, per online node that has any; returns the
+// node count, 0 if the layout is unavailable or there is only one node
+static int read_numa_nodes(cpu_set_t **nodes_out) {
+  cpu_set_t online, allowed, *nodes;
+  int node, count = 0;
+
+  *nodes_out = NULL;
+  if (read_sysfs_list("/sys/devices/system/node/online", &online) < 2 ||
+      sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    return 0;
+
+  nodes = malloc(sizeof(cpu_set_t) * CPU_COUNT(&online));
+  if (!nodes)
+    return 0;
+
+  for (node = 0; node < CPU_SETSIZE; node++) {
+    char path[64];
+
+    if (!CPU_ISSET(node, &online))
+      continue;
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+             node);
+    if (read_sysfs_list(path, &nodes[count]) == 0)
+      continue; // memory-only node
+    CPU_AND(&nodes[count], &nodes[count], &allowed);
+    if (CPU_COUNT(&nodes[count]) > 0)
+      count++;
+  }
+
+  if (count < 2) {
+    free(nodes);
+    return 0;
+  }
+  *nodes_out = nodes;
+
+  return count;
+}
+#endif
+
+#ifndef DETECTION_NO_THREADS
+// Own node first, then the shared queue; called with the lock held
+static PoolJob *pool_take(DetectionPool *pool, int node) {
+  PoolQueue *queues[2];
+  int q;
+
+  queues[0] = &pool->queues[node];
+  queues[1] = &pool->queues[pool->node_count];
+  for (q = 0; q < 2; q++) {
+    PoolJob *job = queues[q]->head;
+
+    if (job) {
+      queues[q]->head = job->next;
+      if (!queues[q]->head)
+        queues[q]->tail = NULL;
+      pool->pending--;
+      return job;
+    }
+  }
+
+  return NULL;
+}
+
+static void *pool_worker(void *arg) {
+  PoolWorker *worker = arg;
+  DetectionPool *pool = worker->pool;
+
+  for (;;) {
+    PoolJob *job;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!(job = pool_take(pool, worker->node)) && !pool->stopping)
+      pthread_cond_wait(&pool->wake, &pool->lock);
+
+    // Stopping only exits once the worker's queues are drained
+    if (!job) {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    job->run(job);
+  }
+}
+#endif
+
+// node < 0 (or out of range) means any worker
+static void pool_submit_on(DetectionPool *pool, int node, PoolJob *job) {
+#ifndef DETECTION_NO_THREADS
+  if (pool->thread_count > 0) {
+    PoolQueue *queue;
+
+    if (node < 0 || node >= pool->node_count)
+      node = pool->node_count;
+    queue = &pool->queues[node];
+
+    job->next = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (queue->tail)
+      queue->tail->next = job;
+    else
+      queue->head = job;
+    queue->tail = job;
+    pool->pending++;
+    // A signal could wake a worker on the wrong node
+    if (pool->node_count > 1 && node < pool->node_count)
+      pthread_cond_broadcast(&pool->wake);
+    else
+      pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    return;
+  }
+#else
+  (void)node;
+#endif
+  job->run(job);
+}
+
+static void pool_submit(DetectionPool *pool, PoolJob *job) {
+  pool_submit_on(pool, -1, job);
+}
+
+#ifndef DETECTION_NO_THREADS
+// Starts worker index on its node, pinned there when the layout is known
+static int pool_start_worker(DetectionPool *pool, int index,
+                             const void *node_cpus) {
+  pthread_attr_t attr;
+  int started;
+
+  if (pthread_attr_init(&attr) != 0)
+    return -1;
+#ifdef DETECTION_NUMA
+  if (node_cpus)
+    pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), node_cpus);
+#else
+  (void)node_cpus;
+#endif
+  started = pthread_create(&pool->threads[index], &attr, pool_worker,
+                           &pool->workers[index]) == 0;
+  pthread_attr_destroy(&attr);
+
+  return started ? 0 : -1;
+}
+#endif
+
+DetectionPool *detection_pool_create(int threads) {
+  DetectionPool *pool = calloc(1, sizeof(DetectionPool));
+#ifdef DETECTION_NUMA
+  cpu_set_t *nodes = NULL;
+#else
+  void *nodes = NULL;
+#endif
+  int node_count = 0, i;
+
+  if (!pool)
+    return NULL;
+  pool->node_count = 1;
+
+#ifndef DETECTION_NO_THREADS
+  if (threads <= 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+    threads = online > 0 ? (int)online : 1;
+  }
+
+#ifdef DETECTION_NUMA
+  node_count = read_numa_nodes(&nodes);
+#endif
+  // Every node in use needs at least one worker to drain its queue
+  if (node_count > threads)
+    node_count = threads;
+  if (node_count > 1)
+    pool->node_count = node_count;
+
+  pool->threads = malloc(sizeof(pthread_t) * threads);
+  pool->workers = malloc(sizeof(PoolWorker) * threads);
+  pool->queues = calloc(pool->node_count + 1, sizeof(PoolQueue));
+  if (!pool->threads || !pool->workers || !pool->queues ||
+      pthread_mutex_init(&pool->lock, NULL) != 0) {
+    free(nodes);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool->queues);
+    free(pool);
+    return NULL;
+  }
+  if (pthread_cond_init(&pool->wake, NULL) != 0) {
+    pthread_mutex_destroy(&pool->lock);
+    free(nodes);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool->queues);
+    free(pool);
+    return NULL;
+  }
+
+  // Keep however many workers could be started; zero degrades to inline.
+  // If that leaves a node without workers, fall back to one flat queue.
+  for (i = 0; i < threads; i++) {
+    int node = (int)((long)i * pool->node_count / threads);
+    const void *cpus = NULL;
+
+#ifdef DETECTION_NUMA
+    if (pool->node_count > 1)
+      cpus = &nodes[node];
+#endif
+    pool->workers[i].pool = pool;
+    pool->workers[i].node = node;
+    if (pool_start_worker(pool, i, cpus) != 0)
+      break;
+    pool->thread_count++;
+  }
+  if (pool->thread_count < threads && pool->node_count > 1) {
+    pthread_mutex_lock(&pool->lock);
+    pool->node_count = 1;
+    for (i = 0; i < pool->thread_count; i++)
+      pool->workers[i].node = 0;
+    pthread_mutex_unlock(&pool->lock);
+  }
+  free(nodes);
+#else
+  (void)threads;
+  (void)nodes;
+  (void)node_count;
+  (void)i;
+#endif
+
+  return pool;
+}
+
+void detection_pool_destroy(DetectionPool *pool) {
+  if (!pool)
+    return;
+
+#ifndef DETECTION_NO_THREADS
+  {
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->thread_count; i++)
+      pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool->queues);
+  }
+#endif
+  free(pool);
+}
+
+int detection_pool_threads(const DetectionPool *pool) {
+  return pool ? pool->thread_count : 0;
+}
+
+int detection_pool_nodes(const DetectionPool *pool) {
+  return pool ? pool->node_count : 0;
+}
+
+static void add_pair_stats(DetectionStats *dst, const DetectionStats *src) {
+  dst->pairs_tested += src->pairs_tested;
+  dst->pairs_parallel += src->pairs_parallel;
+  dst->pairs_coplanar += src->pairs_coplanar;
+  dst->pairs_intersecting += src->pairs_intersecting;
+}
+
+// Move joint k of a private buffer into its component's joint array
+static void add_flat_joint(ComponentArray *components, const FlatJoints *joints,
+                           int k) {
+  const double *src = &joints->segments[k * 6];
+  Component3D *comp = &components->components[joints->components[k]];
+  JointType type = (JointType)joints->types[k];
+  Segment3D segment;
+
+  segment.start.x = src[0];
+  segment.start.y = src[1];
+  segment.start.z = src[2];
+  segment.end.x = src[3];
+  segment.end.y = src[4];
+  segment.end.z = src[5];
+  add_joint(type == FINGER_JOINT ? &comp->fingers
+            : type == HOLE_JOINT ? &comp->holes
+                                 : &comp->slots,
+            type, &segment, joints->widths[k]);
+}
+
+typedef struct AsyncRun AsyncRun;
+
+// One block of rows of the pair triangle, detected into private buffers
+typedef struct {
+  PoolJob job; // first member: the job pointer is the tile pointer
+  AsyncRun *run;
+  int index;
+  int node; // NUMA node whose partition holds these rows, -1 for any
+  int first_row;
+  int end_row;
+  FlatJoints joints;
+  DetectionStats stats;
+  PairSink sink;
+} TileJob;
+
+// Rebuilds one NUMA node's rows of the component array, with their vertices
+// and joint arrays, from a worker pinned to that node (first touch)
+typedef struct {
+  PoolJob job;
+  AsyncRun *run;
+  int node;
+  int first_row;
+  int end_row;
+} PlaceJob;
+
+struct AsyncRun {
+  DetectionContext *ctx;
+  DetectionPool *pool;
+  TileJob *tiles;
+  int tile_count;
+  int remaining;
+  PlaceJob *places;
+  int placing;
+  Component3D *placed; // replaces the component array once placing is done
+#ifndef DETECTION_NO_THREADS
+  pthread_mutex_t lock;
+#endif
+  DetectionTileCallback on_tile;
+  DetectionDoneCallback on_done;
+  void *user;
+};
+
+// Replay tiles into the context in order, so joints come out exactly as a
+// sequential detection_run() would list them
+static void finish_async_run(AsyncRun *run) {
+  DetectionContext *ctx = run->ctx;
+  ComponentArray *components = ctx->components;
+  DetectionDoneCallback on_done = run->on_done;
+  void *user = run->user;
+  int t, k, status = 0;
+
+  for (t = 0; t < run->tile_count; t++) {
+    TileJob *tile = &run->tiles[t];
+
+    if (tile->sink.failed)
+      status = -1;
+
+    add_pair_stats(&ctx->stats, &tile->stats);
+    for (k = 0; k < tile->joints.count; k++)
+      add_flat_joint(components, &tile->joints, k);
+
+    free_flat_joints(&tile->joints);
+  }
+  end_run(ctx);
+
+#ifndef DETECTION_NO_THREADS
+  pthread_mutex_destroy(&run->lock);
+#endif
+  free(run->tiles);
+  free(run->places);
+  free(run);
+
+  if (on_done)
+    on_done(user, status);
+}
+
+static void run_tile(PoolJob *job) {
+  TileJob *tile = (TileJob *)job;
+  AsyncRun *run = tile->run;
+  ComponentArray *components = run->ctx->components;
+  uint32_t i, j;
+  int last;
+
+  tile->sink.stats = &tile->stats;
+  tile->sink.joints = &tile->joints;
+  for (i = (uint32_t)tile->first_row; i < (uint32_t)tile->end_row; i++)
+    for (j = i + 1; j < components->count; j++)
+      detect_pair(components, i, j, &tile->sink);
+
+  if (run->on_tile) {
+    DetectionTile view;
+
+    view.index = tile->index;
+    view.tile_count = run->tile_count;
+    view.first_component = tile->first_row;
+    view.end_component = tile->end_row;
+    view.segments = tile->joints.segments;
+    view.types = tile->joints.types;
+    view.components = tile->joints.components;
+    view.widths = tile->joints.widths;
+    view.count = tile->joints.count;
+    run->on_tile(run->user, &view);
+  }
+
+#ifndef DETECTION_NO_THREADS
+  pthread_mutex_lock(&run->lock);
+  last = --run->remaining == 0;
+  pthread_mutex_unlock(&run->lock);
+#else
+  last = --run->remaining == 0;
+#endif
+
+  if (last)
+    finish_async_run(run);
+}
+
+// Tiles go to their partition's node; the last tile frees run, so only
+// locals and not-yet-submitted tiles are touched
+static void submit_tiles(AsyncRun *run) {
+  DetectionPool *pool = run->pool;
+  TileJob *tiles = run->tiles;
+  int t, tile_count = run->tile_count;
+
+  for (t = 0; t < tile_count; t++)
+    pool_submit_on(pool, tiles[t].node, &tiles[t].job);
+}
+
+// Copies on failure keep pointing at the old storage, which stays valid
+static void place_component(Component3D *comp, Arena *arena) {
+  JointArray *arrays[3];
+  int k;
+
+  if (comp->quantized) {
+    size_t size = quantized_size(comp->vertex_count);
+    QuantizedOutline *quantized = arena_alloc(arena, size);
+
+    if (quantized) {
+      memcpy(quantized, comp->quantized, size);
+      comp->quantized = quantized;
+    }
+  } else if (comp->vertex_count > 0) {
+    Vector3D *vertices =
+        arena_alloc(arena, sizeof(Vector3D) * comp->vertex_count);
+
+    if (vertices) {
+      memcpy(vertices, comp->vertices, sizeof(Vector3D) * comp->vertex_count);
+      comp->vertices = vertices;
+    }
+  }
+  if (comp->bulges) {
+    double *bulges = arena_alloc(arena, sizeof(double) * comp->vertex_count);
+
+    if (bulges) {
+      memcpy(bulges, comp->bulges, sizeof(double) * comp->vertex_count);
+      comp->bulges = bulges;
+    }
+  }
+  if (comp->next) {
+    uint32_t *next = arena_alloc(arena, sizeof(uint32_t) * comp->vertex_count);
+
+    if (next) {
+      memcpy(next, comp->next, sizeof(uint32_t) * comp->vertex_count);
+      comp->next = next;
+    }
+  }
+
+  // Joints were cleared by begin_run(), so fresh arrays lose nothing
+  arrays[0] = &comp->fingers;
+  arrays[1] = &comp->holes;
+  arrays[2] = &comp->slots;
+  for (k = 0; k < 3; k++) {
+    JointArray fresh;
+
+    init_joint_array(&fresh, arena);
+    if (fresh.data)
+      *arrays[k] = fresh;
+  }
+}
+
+static void run_place(PoolJob *job) {
+  PlaceJob *place = (PlaceJob *)job;
+  AsyncRun *run = place->run;
+  DetectionContext *ctx = run->ctx;
+  Arena *arena = &ctx->node_arenas[place->node];
+  uint32_t i;
+  int last;
+
+  memcpy(&run->placed[place->first_row],
+         &ctx->components->components[place->first_row],
+         sizeof(Component3D) * (place->end_row - place->first_row));
+  for (i = (uint32_t)place->first_row; i < (uint32_t)place->end_row; i++)
+    place_component(&run->placed[i], arena);
+
+#ifndef DETECTION_NO_THREADS
+  pthread_mutex_lock(&run->lock);
+  last = --run->placing == 0;
+  pthread_mutex_unlock(&run->lock);
+#else
+  last = --run->placing == 0;
+#endif
+
+  if (last) {
+    // The old array and storage stay in their arenas until the next clear
+    ctx->components->components = run->placed;
+    ctx->components->capacity = ctx->components->count;
+    submit_tiles(run);
+  }
+}
+
+/*
+ * NUMA partitioning: consecutive tiles (and so consecutive rows) go to
+ * each of the pool's nodes. When the partition differs from the one last
+ * placed, sets up a PlaceJob per node so each node's rows are first
+ * touched there. Row i still reads every later component, so only its own
+ * side of each pair is local. Returns 1 if placing, 0 if not, -1 on error.
+ */
+static int plan_placement(AsyncRun *run, int n) {
+  DetectionContext *ctx = run->ctx;
+  int nodes = run->pool->node_count, t, k;
+  int *rows;
+
+  if (nodes > run->tile_count)
+    nodes = run->tile_count;
+  for (t = 0; t < run->tile_count; t++)
+    run->tiles[t].node = nodes > 1 ? (int)((long)t * nodes / run->tile_count)
+                                   : -1;
+  if (nodes < 2)
+    return 0;
+
+  rows = malloc(sizeof(int) * (nodes + 1));
+  if (!rows)
+    return -1;
+  for (t = run->tile_count - 1; t >= 0; t--)
+    rows[run->tiles[t].node] = run->tiles[t].first_row;
+  rows[nodes] = n;
+
+  if (ctx->placed_nodes == nodes &&
+      memcmp(ctx->placed_rows, rows, sizeof(int) * (nodes + 1)) == 0) {
+    free(rows);
+    return 0;
+  }
+
+  if (ctx->node_arena_count < nodes) {
+    Arena *arenas = realloc(ctx->node_arenas, sizeof(Arena) * nodes);
+
+    if (!arenas) {
+      free(rows);
+      return -1;
+    }
+    memset(&arenas[ctx->node_arena_count], 0,
+           sizeof(Arena) * (nodes - ctx->node_arena_count));
+    for (k = ctx->node_arena_count; k < nodes; k++)
+      arenas[k].huge_pages = ctx->vertex_arena.huge_pages;
+    ctx->node_arenas = arenas;
+    ctx->node_arena_count = nodes;
+  }
+
+  run->placed = arena_alloc_fresh(&ctx->component_arena,
+                                  sizeof(Component3D) * n);
+  run->places = calloc(nodes, sizeof(PlaceJob));
+  if (!run->placed || !run->places) {
+    free(run->places);
+    run->places = NULL;
+    free(rows);
+    return -1;
+  }
+
+  for (k = 0; k < nodes; k++) {
+    PlaceJob *place = &run->places[k];
+
+    place->job.run = run_place;
+    place->run = run;
+    place->node = k;
+    place->first_row = rows[k];
+    place->end_row = rows[k + 1];
+  }
+  run->placing = nodes;
+
+  free(ctx->placed_rows);
+  ctx->placed_rows = rows;
+  ctx->placed_nodes = nodes;
+
+  return 1;
+}
+
+// Split rows so every tile covers roughly the same number of pairs; row i
+// pairs with the n - 1 - i components after it
+static void plan_tiles(AsyncRun *run, int n) {
+  double total = (double)n * (n - 1) / 2.0, covered = 0.0;
+  int t, row = 0;
+
+  for (t = 0; t < run->tile_count; t++) {
+    TileJob *tile = &run->tiles[t];
+    double target = total * (t + 1) / run->tile_count;
+
+    tile->job.run = run_tile;
+    tile->run = run;
+    tile->index = t;
+    tile->first_row = row;
+    while (row < n && (covered < target || row == tile->first_row)) {
+      covered += n - 1 - row;
+      row++;
+    }
+    if (t == run->tile_count - 1)
+      row = n;
+    tile->end_row = row;
+  }
+}
+
+int detection_run_async(DetectionContext *ctx, DetectionPool *pool,
+                        int tile_count, DetectionTileCallback on_tile,
+                        DetectionDoneCallback on_done, void *user) {
+  AsyncRun *run;
+  PlaceJob *places;
+  int n, k, placing;
+
+  if (!ctx || !pool || ctx->components->count == 0)
+    return -1;
+
+  n = (int)ctx->components->count;
+  if (tile_count <= 0)
+    tile_count = pool->thread_count > 0 ? pool->thread_count * 4 : 1;
+  if (tile_count > n)
+    tile_count = n;
+
+  run = calloc(1, sizeof(AsyncRun));
+  if (!run)
+    return -1;
+  run->tiles = calloc(tile_count, sizeof(TileJob));
+  if (!run->tiles) {
+    free(run);
+    return -1;
+  }
+#ifndef DETECTION_NO_THREADS
+  if (pthread_mutex_init(&run->lock, NULL) != 0) {
+    free(run->tiles);
+    free(run);
+    return -1;
+  }
+#endif
+
+  run->ctx = ctx;
+  run->pool = pool;
+  run->tile_count = tile_count;
+  run->remaining = tile_count;
+  run->on_tile = on_tile;
+  run->on_done = on_done;
+  run->user = user;
+  plan_tiles(run, n);
+  begin_run(ctx);
+
+  placing = plan_placement(run, n);
+  if (placing < 0) {
+#ifndef DETECTION_NO_THREADS
+    pthread_mutex_destroy(&run->lock);
+#endif
+    free(run->tiles);
+    free(run);
+    return -1;
+  }
+  if (!placing) {
+    submit_tiles(run);
+    return 0;
+  }
+
+  // The last placement submits the tiles, which may free run before this
+  // loop ends; only locals and unsubmitted jobs are touched
+  places = run->places;
+  placing = run->placing;
+  for (k = 0; k < placing; k++)
+    pool_submit_on(pool, places[k].node, &places[k].job);
+
+  return 0;
+}
+
+/* Pipelined detection: streaming broad phase, concurrent narrow phase */
+
+#define PIPELINE_QUEUE_CAPACITY 1024
+#define PIPELINE_BATCH 64
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(p) __builtin_prefetch((p), 0, 3)
+#else
+#define PREFETCH(p) ((void)(p))
+#endif
+
+typedef struct {
+  uint32_t i, j;
+} CandidatePair;
+
+// Private narrow-phase results, merged once every candidate is classified
+typedef struct {
+  PairSink sink;
+  FlatJoints joints;
+  DetectionStats stats;
+} NarrowOutput;
+
+static void classify_candidate(ComponentArray *components, NarrowOutput *out,
+                               uint32_t i, uint32_t j) {
+  out->sink.pair_key = (uint64_t)i * (uint64_t)components->count + j;
+  detect_pair(components, i, j, &out->sink);
+}
+
+// Everything the narrow phase reads before the joint arrays: outline
+// pointer, transforms and normal
+static void prefetch_component(const Component3D *comp) {
+  const char *bytes = (const char *)comp;
+  size_t offset;
+
+  for (offset = 0; offset < offsetof(Component3D, fingers); offset += 64)
+    PREFETCH(bytes + offset);
+}
+
+// First few lines of an array; the rest streams in sequentially
+static void prefetch_lines(const void *data, size_t size) {
+  const char *bytes = data;
+  size_t offset;
+
+  for (offset = 0; offset < size && offset < 256; offset += 64)
+    PREFETCH(bytes + offset);
+}
+
+// The heads of what clipping walks: the outline, the edge table of outlines
+// with inner loops and the top of the edge tree, whose root every walk
+// starts from. A merged face is another struct away, so only that struct
+// is fetched and its outline comes in on demand.
+static void prefetch_outline(const Component3D *comp) {
+  if (comp->face) {
+    prefetch_component(comp->face);
+    return;
+  }
+  if (comp->quantized)
+    prefetch_lines(comp->quantized, quantized_size(comp->vertex_count));
+  else
+    prefetch_lines(comp->vertices, sizeof(Vector3D) * comp->vertex_count);
+  if (comp->next)
+    prefetch_lines(comp->next, sizeof(uint32_t) * comp->vertex_count);
+  if (comp->edges)
+    prefetch_lines(comp->edges->nodes,
+                   sizeof(EdgeNode) * comp->edges->node_count);
+}
+
+/*
+ * Candidate pairs gather components by index, so the loop fetches ahead:
+ * the structs of pair k + distance, then the outlines of pair
+ * k + distance / 2, whose vertex pointers the struct prefetch has brought
+ * in by then. distance 0 is the plain loop.
+ */
+static void classify_batch(ComponentArray *components, NarrowOutput *out,
+                           const CandidatePair *pairs, int count,
+                           int distance) {
+  const Component3D *base = components->components;
+  int k, half = distance / 2;
+
+  for (k = 0; k < distance && k < count; k++) {
+    prefetch_component(&base[pairs[k].i]);
+    prefetch_component(&base[pairs[k].j]);
+  }
+
+  for (k = 0; k < count; k++) {
+    if (distance > 0) {
+      if (k + distance < count) {
+        prefetch_component(&base[pairs[k + distance].i]);
+        prefetch_component(&base[pairs[k + distance].j]);
+      }
+      if (k + half < count) {
+        prefetch_outline(&base[pairs[k + half].i]);
+        prefetch_outline(&base[pairs[k + half].j]);
+      }
+    }
+    classify_candidate(components, out, pairs[k].i, pairs[k].j);
+  }
+}
+
+static void narrow_output_init(NarrowOutput *out) {
+  memset(out, 0, sizeof(NarrowOutput));
+  out->sink.joints = &out->joints;
+  out->sink.stats = &out->stats;
+  out->sink.keyed = 1;
+}
+
+typedef struct {
+  uint64_t key;
+  int output;
+  int index;
+} KeyedRef;
+
+static int compare_keyed_refs(const void *a, const void *b) {
+  const KeyedRef *ra = a, *rb = b;
+
+  if (ra->key != rb->key)
+    return ra->key < rb->key ? -1 : 1;
+  if (ra->output != rb->output)
+    return ra->output - rb->output;
+  return ra->index - rb->index;
+}
+
+// Replay every output in pair order, as a sequential run would have
+// produced it, then release the outputs
+static int merge_narrow_outputs(DetectionContext *ctx, NarrowOutput *outputs,
+                                int count) {
+  ComponentArray *components = ctx->components;
+  KeyedRef *refs;
+  int o, k, total = 0, r = 0, status = 0;
+
+  for (o = 0; o < count; o++) {
+    if (outputs[o].sink.failed)
+      status = -1;
+    add_pair_stats(&ctx->stats, &outputs[o].stats);
+    total += outputs[o].joints.count;
+  }
+
+  refs = malloc(sizeof(KeyedRef) * (total > 0 ? total : 1));
+  if (!refs)
+    status = -1;
+
+  if (refs) {
+    for (o = 0; o < count; o++)
+      for (k = 0; k < outputs[o].joints.count; k++, r++) {
+        refs[r].key = outputs[o].sink.joint_keys[k];
+        refs[r].output = o;
+        refs[r].index = k;
+      }
+    qsort(refs, total, sizeof(KeyedRef), compare_keyed_refs);
+    for (r = 0; r < total; r++)
+      add_flat_joint(components, &outputs[refs[r].output].joints,
+                     refs[r].index);
+    free(refs);
+  }
+
+  for (o = 0; o < count; o++) {
+    free_flat_joints(&outputs[o].joints);
+    free(outputs[o].sink.joint_keys);
+  }
+  end_run(ctx);
+
+  return status;
+}
+
+// Without workers, candidates are batched here so prefetching still has
+// pairs to look ahead at
+typedef struct {
+  ComponentArray *components;
+  NarrowOutput *output;
+  CandidatePair staged[PIPELINE_BATCH];
+  int staged_count;
+  int prefetch_distance;
+} InlineNarrow;
+
+static void inline_flush(InlineNarrow *narrow) {
+  classify_batch(narrow->components, narrow->output, narrow->staged,
+                 narrow->staged_count, narrow->prefetch_distance);
+  narrow->staged_count = 0;
+}
+
+static void inline_emit(void *user, uint32_t i, uint32_t j) {
+  InlineNarrow *narrow = user;
+  CandidatePair *pair = &narrow->staged[narrow->staged_count++];
+
+  pair->i = i;
+  pair->j = j;
+  if (narrow->staged_count == PIPELINE_BATCH)
+    inline_flush(narrow);
+}
+
+#ifndef DETECTION_NO_THREADS
+// Bounded single-producer, single-consumer ring of candidate pairs
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  CandidatePair *ring;
+  int capacity;
+  int head;
+  int count;
+  int closed;
+} PairQueue;
+
+typedef struct Pipeline Pipeline;
+
+typedef struct {
+  PoolJob job; // first member: the job pointer is the worker pointer
+  Pipeline *pipeline;
+  PairQueue queue;
+  NarrowOutput output;
+} NarrowWorker;
+
+struct Pipeline {
+  ComponentArray *components;
+  NarrowWorker *workers;
+  int worker_count;
+  CandidatePair staged[PIPELINE_BATCH]; // producer batch, one lock per flush
+  int staged_count;
+  int prefetch_distance;
+  int active;
+  pthread_mutex_t lock;
+  pthread_cond_t idle;
+};
+
+static int pair_queue_init(PairQueue *queue, int capacity) {
+  queue->ring = malloc(sizeof(CandidatePair) * capacity);
+  if (!queue->ring)
+    return -1;
+  if (pthread_mutex_init(&queue->lock, NULL) != 0) {
+    free(queue->ring);
+    return -1;
+  }
+  pthread_cond_init(&queue->not_empty, NULL);
+  pthread_cond_init(&queue->not_full, NULL);
+  queue->capacity = capacity;
+  queue->head = queue->count = queue->closed = 0;
+
+  return 0;
+}
+
+static void pair_queue_destroy(PairQueue *queue) {
+  pthread_cond_destroy(&queue->not_full);
+  pthread_cond_destroy(&queue->not_empty);
+  pthread_mutex_destroy(&queue->lock);
+  free(queue->ring);
+}
+
+// Blocks while the queue is full: this is the broad phase's backpressure
+static void pair_queue_push(PairQueue *queue, const CandidatePair *pairs,
+                            int count) {
+  pthread_mutex_lock(&queue->lock);
+  while (count > 0) {
+    while (queue->count == queue->capacity)
+      pthread_cond_wait(&queue->not_full, &queue->lock);
+
+    while (count > 0 && queue->count < queue->capacity) {
+      queue->ring[(queue->head + queue->count) % queue->capacity] = *pairs++;
+      queue->count++;
+      count--;
+    }
+    pthread_cond_signal(&queue->not_empty);
+  }
+  pthread_mutex_unlock(&queue->lock);
+}
+
+// Takes up to max pairs; returns 0 once the queue is closed and drained
+static int pair_queue_pop(PairQueue *queue, CandidatePair *pairs, int max) {
+  int taken = 0;
+
+  pthread_mutex_lock(&queue->lock);
+  while (queue->count == 0 && !queue->closed)
+    pthread_cond_wait(&queue->not_empty, &queue->lock);
+
+  while (taken < max && queue->count > 0) {
+    pairs[taken++] = queue->ring[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+  }
+  if (taken > 0)
+    pthread_cond_signal(&queue->not_full);
+  pthread_mutex_unlock(&queue->lock);
+
+  return taken;
+}
+
+static void pair_queue_close(PairQueue *queue) {
+  pthread_mutex_lock(&queue->lock);
+  queue->closed = 1;
+  pthread_cond_broadcast(&queue->not_empty);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+static void narrow_worker_run(PoolJob *job) {
+  NarrowWorker *worker = (NarrowWorker *)job;
+  Pipeline *pipeline = worker->pipeline;
+  CandidatePair batch[PIPELINE_BATCH];
+  int taken;
+
+  while ((taken = pair_queue_pop(&worker->queue, batch, PIPELINE_BATCH)) > 0)
+    classify_batch(pipeline->components, &worker->output, batch, taken,
+                   pipeline->prefetch_distance);
+
+  pthread_mutex_lock(&pipeline->lock);
+  if (--pipeline->active == 0)
+    pthread_cond_signal(&pipeline->idle);
+  pthread_mutex_unlock(&pipeline->lock);
+}
+
+// Hand the staged batch to the least loaded queue; if even that one is
+// full, every worker is behind and the push blocks
+static void pipeline_flush(Pipeline *pipeline) {
+  int w, target = 0, least = -1;
+
+  if (pipeline->staged_count == 0)
+    return;
+
+  for (w = 0; w < pipeline->worker_count; w++) {
+    PairQueue *queue = &pipeline->workers[w].queue;
+    int count;
+
+    pthread_mutex_lock(&queue->lock);
+    count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+
+    if (least < 0 || count < least) {
+      least = count;
+      target = w;
+    }
+  }
+
+  pair_queue_push(&pipeline->workers[target].queue, pipeline->staged,
+                  pipeline->staged_count);
+  pipeline->staged_count = 0;
+}
+
+static void pipeline_emit(void *user, uint32_t i, uint32_t j) {
+  Pipeline *pipeline = user;
+  CandidatePair *pair = &pipeline->staged[pipeline->staged_count++];
+
+  pair->i = i;
+  pair->j = j;
+  if (pipeline->staged_count == PIPELINE_BATCH)
+    pipeline_flush(pipeline);
+}
+
+static int run_pipeline_threaded(DetectionContext *ctx, DetectionPool *pool,
+                                 const ComponentBounds *sorted, uint32_t n,
+                                 int queue_capacity) {
+  Pipeline pipeline;
+  NarrowOutput *outputs;
+  int w, ready = 0, status;
+
+  memset(&pipeline, 0, sizeof(Pipeline));
+  pipeline.components = ctx->components;
+  pipeline.worker_count = pool->thread_count;
+  pipeline.prefetch_distance = ctx->prefetch_distance;
+  pipeline.workers = calloc(pipeline.worker_count, sizeof(NarrowWorker));
+  outputs = malloc(sizeof(NarrowOutput) * pipeline.worker_count);
+  if (!pipeline.workers || !outputs ||
+      pthread_mutex_init(&pipeline.lock, NULL) != 0) {
+    free(pipeline.workers);
+    free(outputs);
+    return -1;
+  }
+  pthread_cond_init(&pipeline.idle, NULL);
+
+  while (ready < pipeline.worker_count &&
+         pair_queue_init(&pipeline.workers[ready].queue, queue_capacity) == 0)
+    ready++;
+  status = ready == pipeline.worker_count ? 0 : -1;
+
+  if (status == 0) {
+    pipeline.active = pipeline.worker_count;
+    for (w = 0; w < pipeline.worker_count; w++) {
+      NarrowWorker *worker = &pipeline.workers[w];
+
+      worker->job.run = narrow_worker_run;
+      worker->pipeline = &pipeline;
+      narrow_output_init(&worker->output);
+      pool_submit(pool, &worker->job);
+    }
+
+    // Broad phase on this thread, overlapping the workers
+    sweep_candidates(sorted, n, pipeline_emit, &pipeline);
+    pipeline_flush(&pipeline);
+    for (w = 0; w < pipeline.worker_count; w++)
+      pair_queue_close(&pipeline.workers[w].queue);
+
+    pthread_mutex_lock(&pipeline.lock);
+    while (pipeline.active > 0)
+      pthread_cond_wait(&pipeline.idle, &pipeline.lock);
+    pthread_mutex_unlock(&pipeline.lock);
+
+    // merge_narrow_outputs() reads the buffers, not the sink pointers
+    for (w = 0; w < pipeline.worker_count; w++)
+      outputs[w] = pipeline.workers[w].output;
+    status = merge_narrow_outputs(ctx, outputs, pipeline.worker_count);
+  }
+
+  for (w = 0; w < ready; w++)
+    pair_queue_destroy(&pipeline.workers[w].queue);
+  pthread_cond_destroy(&pipeline.idle);
+  pthread_mutex_destroy(&pipeline.lock);
+  free(pipeline.workers);
+  free(outputs);
+
+  return status;
+}
+#endif /* DETECTION_NO_THREADS */
+
+int detection_run_pipelined(DetectionContext *ctx, DetectionPool *pool,
+                            int queue_capacity) {
+  ComponentBounds *sorted;
+  uint32_t i, n, count;
+  int status;
+
+  if (!ctx || !pool || ctx->components->count == 0)
+    return -1;
+
+  n = ctx->components->count;
+  if (queue_capacity <= 0)
+    queue_capacity = PIPELINE_QUEUE_CAPACITY;
+  if (queue_capacity < PIPELINE_BATCH)
+    queue_capacity = PIPELINE_BATCH;
+
+  sorted = malloc(sizeof(ComponentBounds) * n);
+  if (!sorted)
+    return -1;
+
+  // Phase 1 first: merged members never reach the sweep
+  begin_run(ctx);
+  count = 0;
+  for (i = 0; i < n; i++)
+    if (!ctx->components->components[i].merged_into)
+      component_bounds(&ctx->components->components[i], i, &sorted[count++]);
+  n = count;
+  qsort(sorted, n, sizeof(ComponentBounds), compare_bounds_min_x);
+
+#ifndef DETECTION_NO_THREADS
+  if (pool->thread_count > 0) {
+    status = run_pipeline_threaded(ctx, pool, sorted, n, queue_capacity);
+    free(sorted);
+    return status;
+  }
+#endif
+
+  {
+    NarrowOutput output;
+    InlineNarrow narrow;
+
+    narrow_output_init(&output);
+    narrow.components = ctx->components;
+    narrow.output = &output;
+    narrow.staged_count = 0;
+    narrow.prefetch_distance = ctx->prefetch_distance;
+    sweep_candidates(sorted, n, inline_emit, &narrow);
+    inline_flush(&narrow);
+    status = merge_narrow_outputs(ctx, &output, 1);
+  }
+  free(sorted);
+
+  return status;
+}
+
+int detection_context_set_prefetch_distance(DetectionContext *ctx,
+                                            int distance) {
+  if (!ctx || distance < 0)
     return -1;
 
-  find_and_classify_intersections(components);
+  // Lookahead never crosses a batch, so at most PIPELINE_BATCH - 1
+  ctx->prefetch_distance =
+      distance < PIPELINE_BATCH ? distance : PIPELINE_BATCH - 1;
 
   return 0;
 }
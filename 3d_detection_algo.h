@@ -0,0 +1,439 @@
+/*
+ * 3D Component Intersection Detection and Joint Classification Algorithm
+ * Public C API
+ *
+ * Two entry points share one engine:
+ *  - the context API: an opaque DetectionContext that owns an assembly,
+ *    runs detection and hands back joints through iterators and stats
+ *  - the flat buffer interface: bindings (Node.js, Lua, Zig, WebAssembly)
+ *    hand the engine plain arrays in a single call
+ *
+ * Link against libdetection (`make lib` in the repository root), or compile
+ * 3d_detection_algo.c with -DDETECTION_ENGINE_NO_MAIN into another program.
+ */
+
+#ifndef DETECTION_ALGO_H
+#define DETECTION_ALGO_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped on incompatible API changes; minor for additions */
+#define DETECTION_VERSION_MAJOR 1
+#define DETECTION_VERSION_MINOR 17
+
+// Shared library builds use -fvisibility=hidden; only DETECTION_API escapes
+#ifndef DETECTION_API
+#if defined(__GNUC__) && __GNUC__ >= 4
+#define DETECTION_API __attribute__((visibility("default")))
+#else
+#define DETECTION_API
+#endif
+#endif
+
+/* Joint type codes written to FlatJoints.types and DetectionJoint.type */
+#define FLAT_FINGER_JOINT 0
+#define FLAT_HOLE_JOINT 1
+#define FLAT_SLOT_JOINT 2
+
+/*
+ * Caller-owned assembly. Outlines are xyz triples in each component's local
+ * frame, stored back to back; component i uses points
+ * [vertex_offsets[i], vertex_offsets[i + 1]). Transforms are row-major 4x4
+ * rigid local-to-world matrices, 16 doubles per component. The engine reads
+ * vertices in place (no copy), so they must stay valid for the call.
+ * Offsets must start at or above 0 and never decrease; assemblies that
+ * break this are rejected with -1.
+ */
+typedef struct {
+  const double *vertices;
+  const int *vertex_offsets; /* count + 1 entries */
+  const double *transforms;  /* 16 * count entries */
+  const int *ids;            /* optional; NULL numbers components 1..count */
+  int count;
+} FlatAssembly;
+
+/*
+ * Joint results, grown by the engine. Segment k is segments[6k .. 6k+5]
+ * (start xyz, end xyz) in the local frame of component components[k].
+ * Zero-initialise before the first call; release with free_flat_joints().
+ */
+typedef struct {
+  double *segments;
+  unsigned char *types;
+  int *components;
+  int count;
+  int capacity;
+  /*
+   * Per joint, see DetectionJoint.width. The flat interface has no
+   * thickness input, so detect_flat_assembly() always writes 0 here; slab
+   * widths need the context API (detection_context_set_thickness()).
+   */
+  double *widths;
+} FlatJoints;
+
+/* Returns 0 on success, -1 on invalid input or allocation failure */
+DETECTION_API int detect_flat_assembly(const FlatAssembly *assembly,
+                                       FlatJoints *joints);
+DETECTION_API void free_flat_joints(FlatJoints *joints);
+
+/* Context API */
+
+typedef struct DetectionContext DetectionContext;
+
+// One joint as seen through an iterator; segment is start xyz, end xyz in
+// the local frame of the owning component
+typedef struct {
+  int type;         /* FLAT_*_JOINT */
+  int component;    /* zero-based index in insertion order */
+  int component_id; /* id passed to detection_add_component() */
+  double segment[6];
+  int edge; /* finger joints: outline edge as added, else -1 */
+  /*
+   * Extent of the joint across the segment, in the component's plane and
+   * centred on it: the other component's slab footprint, its thickness /
+   * sin(angle between the two). 0 when that component has no thickness.
+   */
+  double width;
+} DetectionJoint;
+
+// Iterator state; fields are private, initialise with detection_joints_begin()
+typedef struct {
+  const DetectionContext *ctx;
+  int component;
+  int last_component;
+  int list;
+  int index;
+} DetectionJointIterator;
+
+// Counters for the most recent detection_run()
+typedef struct {
+  int components;
+  int vertices;
+  unsigned long long pairs_tested; /* 64-bit: n^2 / 2 outgrows 32 bits */
+  unsigned long long pairs_parallel;
+  unsigned long long pairs_coplanar;
+  unsigned long long pairs_intersecting;
+  int joints[3]; /* indexed by FLAT_*_JOINT */
+  int joint_count;
+  int components_merged; /* folded into a coplanar neighbour's face */
+} DetectionStats;
+
+DETECTION_API const char *detection_version(void);
+
+/* Returns NULL on allocation failure */
+DETECTION_API DetectionContext *detection_context_create(void);
+DETECTION_API void detection_context_destroy(DetectionContext *ctx);
+
+/* Drops every component and joint, keeping allocations for reuse */
+DETECTION_API void detection_context_clear(DetectionContext *ctx);
+
+/*
+ * Assembly builder. vertices holds vertex_count local-frame xyz triples and
+ * is copied; transform is a row-major 4x4 rigid local-to-world matrix (NULL
+ * for identity). Returns the new component's index, or -1 on error.
+ */
+DETECTION_API int detection_add_component(DetectionContext *ctx, int id,
+                                          const double *vertices,
+                                          int vertex_count,
+                                          const double *transform);
+
+/*
+ * As above with circular arc edges: bulges holds one value per edge (edge k
+ * runs from vertex k to k + 1, the last one back to vertex 0), the DXF
+ * bulge tan(sweep / 4), positive for counterclockwise arcs in the local
+ * frame and 0 for straight edges. NULL or all-zero bulges add a plain
+ * outline. Arc edges are clipped and edge-tested exactly, so a curved
+ * panel costs about as much as the polygon of its vertices.
+ */
+DETECTION_API int detection_add_curved_component(DetectionContext *ctx, int id,
+                                                 const double *vertices,
+                                                 const double *bulges,
+                                                 int vertex_count,
+                                                 const double *transform);
+
+/*
+ * As above for outlines with inner loops (cutouts): vertices (and bulges)
+ * hold loop_count closed loops back to back, loop l starting at vertex
+ * loop_starts[l] and running up to the next loop's start. loop_starts[0]
+ * must be 0; loop_starts may be NULL for a single loop. Regions are taken
+ * even-odd, so an inner loop cuts a hole whichever way it winds.
+ */
+DETECTION_API int detection_add_component_loops(
+    DetectionContext *ctx, int id, const double *vertices,
+    const double *bulges, int vertex_count, const int *loop_starts,
+    int loop_count, const double *transform);
+
+/*
+ * Simplify outlines of components added afterwards: runs of straight edges
+ * whose vertices stay within tolerance (local units) of a single edge are
+ * merged into it (Douglas-Peucker); arc edges are kept. The original
+ * outline is kept for reporting, so DetectionJoint.edge still counts edges
+ * as they were added. 0, the default, disables it. Returns 0 or -1.
+ */
+DETECTION_API int detection_context_set_simplify_tolerance(
+    DetectionContext *ctx, double tolerance);
+
+/*
+ * Sheet thickness of components added afterwards: each becomes a slab
+ * spanning thickness / 2 either side of its outline's plane, so panels
+ * modelled as meeting at each other's faces rather than mid-planes still
+ * join, and joints report the width of the mating slab (DetectionJoint
+ * .width). 0, the default, keeps components as zero-thickness outlines.
+ * Returns 0 or -1.
+ */
+DETECTION_API int detection_context_set_thickness(DetectionContext *ctx,
+                                                  double thickness);
+
+/*
+ * Fuse collinear joints after each run: per component and joint type,
+ * joints on the same supporting line whose intervals overlap or abut (and
+ * whose widths match) become one, keeping the earliest one's place and
+ * direction. Tile callbacks still see the unfused joints. Off by default.
+ * Returns 0 or -1.
+ */
+DETECTION_API int detection_context_set_joint_merging(DetectionContext *ctx,
+                                                      int enabled);
+
+/*
+ * Phase 1 coplanar face merging (see detection_component_face()). Unlike
+ * the other passes it is on by default, since 1.12: pieces of one face then
+ * report a single set of joints rather than one per piece. Disabling it
+ * restores the per-piece joints of earlier versions. Returns 0 or -1.
+ */
+DETECTION_API int detection_context_set_face_merging(DetectionContext *ctx,
+                                                     int enabled);
+
+/* Appends every component of a flat assembly; returns 0 or -1 */
+DETECTION_API int detection_add_flat_assembly(DetectionContext *ctx,
+                                              const FlatAssembly *assembly);
+
+DETECTION_API int detection_component_count(const DetectionContext *ctx);
+
+/*
+ * Before pair testing, every run merges components that share a plane and
+ * whose straight outlines overlap or touch into one face: the union of
+ * their outlines, held by the lowest-indexed of them, which reports the
+ * face's joints (in its own local frame). Returns that component's index
+ * for a merged one, the index itself otherwise, or -1 if out of range.
+ */
+DETECTION_API int detection_component_face(const DetectionContext *ctx,
+                                           int component);
+
+/*
+ * Record every pair test and joint of later detection_run() calls to a
+ * binary trace at path (the format the C TUI demo replays with --replay),
+ * overwritten by each run. The path is copied; NULL, the default, stops
+ * tracing. Tiled and pipelined runs are not traced. Returns 0 or -1.
+ */
+DETECTION_API int detection_context_set_trace_path(DetectionContext *ctx,
+                                                   const char *path);
+
+/*
+ * Runs detection over the whole assembly, replacing joints from any earlier
+ * run. Returns 0 on success, -1 on an empty assembly, when the trace set
+ * with detection_context_set_trace_path() cannot be opened (nothing runs),
+ * or when a failed write left it truncated (the joints are still found).
+ */
+DETECTION_API int detection_run(DetectionContext *ctx);
+
+DETECTION_API int detection_joint_count(const DetectionContext *ctx);
+
+/*
+ * Joint iteration: component >= 0 restricts the walk to one component, -1
+ * visits all of them. Joints come out per component as fingers, holes,
+ * slots. detection_joints_next() returns 1 and fills *joint, or 0 at the end.
+ */
+DETECTION_API void detection_joints_begin(const DetectionContext *ctx,
+                                          int component,
+                                          DetectionJointIterator *it);
+DETECTION_API int detection_joints_next(DetectionJointIterator *it,
+                                        DetectionJoint *joint);
+
+DETECTION_API void detection_get_stats(const DetectionContext *ctx,
+                                       DetectionStats *stats);
+
+/*
+ * Finger-joint teeth for the last run. Finger joints of different
+ * components overlapping on one world line are mates; a run of mates
+ * (several, once merging fuses joints) is divided into an odd number of
+ * equal slots about tooth_width long, and each joint keeps alternate slots
+ * of it as teeth and has the rest cut away, to thickness deep on the
+ * material side. The run's lowest-indexed component keeps teeth at both
+ * ends and its mates the complement, so the parts interlock. kerf (the
+ * beam width) widens every tooth, and so narrows every inner cut, by
+ * kerf / 2 a side.
+ */
+typedef struct {
+  double thickness;   /* cut depth; 0 takes each joint's width (slabs) */
+  double tooth_width; /* > 0 */
+  double kerf;        /* >= 0 */
+} DetectionTeethParams;
+
+/*
+ * Writes up to capacity cuts into caller-owned buffers: cut k is the
+ * rectangle corners[8k .. 8k+7], four xy corners counterclockwise in the
+ * local frame of component components[k] (components may be NULL). Joints
+ * with no known depth or no material side are skipped. Returns the total
+ * number of cuts, which may exceed capacity (call with 0 to size the
+ * buffers), or -1 on invalid parameters or allocation failure.
+ */
+DETECTION_API int detection_generate_teeth(const DetectionContext *ctx,
+                                           const DetectionTeethParams *params,
+                                           double *corners, int *components,
+                                           int capacity);
+
+/*
+ * Cut-ready openings for a component's hole and slot joints. Each joint's
+ * opening is the rectangle along its segment, thickness wide (the joint's
+ * width when 0), grown by clearance on every side so the mating part fits
+ * and then shrunk by kerf / 2 so the beam's centre can follow it. Finger
+ * joints are cut from detection_generate_teeth(), which already allows for
+ * the kerf.
+ */
+typedef struct {
+  double thickness; /* opening width; 0 takes each joint's width */
+  double kerf;      /* >= 0 */
+  double clearance; /* >= 0 */
+} DetectionOffsetParams;
+
+/*
+ * Writes up to capacity openings of the given component: opening k is the
+ * rectangle corners[8k .. 8k+7], four xy corners counterclockwise in the
+ * component's local frame, of joint type types[k] (types may be NULL).
+ * Holes come before slots. Returns the total number of openings, which may
+ * exceed capacity, or -1 on invalid arguments.
+ */
+DETECTION_API int detection_offset_joints(const DetectionContext *ctx,
+                                          int component,
+                                          const DetectionOffsetParams *params,
+                                          double *corners, int *types,
+                                          int capacity);
+
+/*
+ * Component, vertex and joint storage comes from per-context arenas. With
+ * huge pages enabled, arena chunks are 2 MB aligned mappings taken from the
+ * reserved huge page pool (MAP_HUGETLB) or, failing that, advised for
+ * transparent huge pages (MADV_HUGEPAGE); either falls back to the heap.
+ * Affects chunks reserved afterwards, so enable before adding components.
+ * Returns -1 when the build has no huge page support (non-Linux, or
+ * DETECTION_NO_HUGE_PAGES).
+ */
+DETECTION_API int detection_context_set_huge_pages(DetectionContext *ctx,
+                                                   int enabled);
+
+// Bytes reserved by the context's arenas, how many of them are huge page
+// backed (always for MAP_HUGETLB; advised, not guaranteed, for THP), and
+// how many hold component outlines
+typedef struct {
+  size_t reserved;
+  size_t huge_page_backed;
+  size_t outlines;
+} DetectionMemory;
+
+DETECTION_API int detection_get_memory(const DetectionContext *ctx,
+                                       DetectionMemory *memory);
+
+/*
+ * Compressed outlines for components added afterwards: outlines lying in
+ * their local z = 0 plane (every panel) keep x and y as 16-bit steps
+ * across their local bounding box, 4 bytes a vertex instead of 24, and
+ * are decoded inside the kernels. Each outline also carries 32 bytes of
+ * origin and scale, so a four-vertex panel shrinks only 2x (48 bytes
+ * against 96) and the ratio nears 6x from a few dozen vertices on.
+ * Precision is the outline's extent / 65535 per axis, far coarser than
+ * the 1e-6 edge tolerance, so a quantized outline's on-edge tests widen by
+ * half a step: joints along its edges stay the same type and move by at
+ * most that rounding. Non-planar outlines stay in doubles. Returns 0 or -1.
+ */
+DETECTION_API int detection_context_set_vertex_quantization(
+    DetectionContext *ctx, int enabled);
+
+/* Thread pool and tiled asynchronous detection */
+
+typedef struct DetectionPool DetectionPool;
+
+/*
+ * Worker pool shared by asynchronous runs. threads <= 0 uses one thread per
+ * online CPU. Builds without threads (DETECTION_NO_THREADS, WebAssembly,
+ * Windows) get a pool that runs work inline on the calling thread.
+ * Destroying the pool waits for queued work to finish.
+ */
+DETECTION_API DetectionPool *detection_pool_create(int threads);
+DETECTION_API void detection_pool_destroy(DetectionPool *pool);
+DETECTION_API int detection_pool_threads(const DetectionPool *pool);
+
+/*
+ * NUMA nodes the workers are spread over (Linux; 1 elsewhere, on single
+ * node machines, or with -DDETECTION_NO_NUMA). On several nodes each worker
+ * is pinned to its node's CPUs, and detection_run_async() partitions tiles
+ * by node and first-touches each partition's components, vertices and
+ * joints on it before detecting.
+ */
+DETECTION_API int detection_pool_nodes(const DetectionPool *pool);
+
+// Joints found by one tile: a contiguous block of rows of the pair
+// triangle. Buffers are only valid during the callback.
+typedef struct {
+  int index;
+  int tile_count;
+  int first_component; /* rows [first_component, end_component) */
+  int end_component;
+  const double *segments; /* 6 per joint, component local frame */
+  const unsigned char *types;
+  const int *components;
+  int count;
+  const double *widths; /* per joint, see DetectionJoint.width */
+} DetectionTile;
+
+typedef void (*DetectionTileCallback)(void *user, const DetectionTile *tile);
+typedef void (*DetectionDoneCallback)(void *user, int status);
+
+/*
+ * Runs detection on the pool in tile_count tiles of roughly equal pair
+ * counts (tile_count <= 0 picks four per worker) and returns immediately.
+ * on_tile (optional) fires on a worker thread as each tile completes, in
+ * completion order and possibly concurrently. Once every tile is done the
+ * joints are merged into ctx in sequential order and on_done fires exactly
+ * once, on the worker that finished last, with 0 or -1. The context must
+ * not be touched from elsewhere until then.
+ * Returns 0 if the run was scheduled, -1 otherwise (no callbacks fire).
+ */
+DETECTION_API int detection_run_async(DetectionContext *ctx,
+                                      DetectionPool *pool, int tile_count,
+                                      DetectionTileCallback on_tile,
+                                      DetectionDoneCallback on_done,
+                                      void *user);
+
+/*
+ * Pipelined detection. The calling thread runs the broad phase (world-space
+ * bounding boxes, sort-and-sweep) and streams candidate pairs into bounded
+ * per-worker queues of queue_capacity pairs (<= 0 for the default), while
+ * every pool worker runs the narrow phase concurrently. When all queues are
+ * full the broad phase blocks, so the candidate list is never materialised.
+ * Joints come out in the same order as detection_run(); stats count only
+ * pairs that survive the broad phase. Blocks until done; never call it from
+ * a pool worker. Returns 0 or -1.
+ */
+DETECTION_API int detection_run_pipelined(DetectionContext *ctx,
+                                          DetectionPool *pool,
+                                          int queue_capacity);
+
+/*
+ * Candidate pairs index components indirectly, so the narrow phase
+ * prefetches the components of the pair distance steps ahead, then the
+ * heads of their outlines, edge tables and edge trees half as far ahead
+ * (default 8, at most 63 so the lookahead stays within a batch of 64; 0
+ * disables). Returns 0, or -1 for a negative distance.
+ */
+DETECTION_API int detection_context_set_prefetch_distance(DetectionContext *ctx,
+                                                          int distance);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DETECTION_ALGO_H */
@@ -0,0 +1,978 @@
+/*
+ * 3D Component Intersection Detection - Benchmark
+ *
+ * Builds a random assembly of rectangular panels through the context API,
+ * runs detection repeatedly and reports timings and engine stats. Linked
+ * against libdetection; see `make bench` in the repository root.
+ *
+ * Usage: detection_bench [components] [iterations] [seed] [threads] [prefetch]
+ *
+ * With threads > 0 the same assembly is also run on a worker pool, tiled
+ * through detection_run_async() and pipelined (broad phase feeding the
+ * narrow phase) through detection_run_pipelined(), and both must give
+ * exactly the sequential run's joints. The pipelined run is
+ * repeated without prefetching and with the given prefetch distance
+ * (default 8), counting L1 data cache load misses for each, and once more
+ * on a copy of the assembly stored with 16-bit quantized outlines, whose
+ * joints (and those of quantized rounded panels) must match the
+ * full-precision ones to within 1e-3. A copy built as 0.2-thick slabs
+ * must give the same joints pipelined as sequentially.
+ *
+ * The assembly is also rebuilt with every panel side split into 256 edges,
+ * which exercises the per-outline edge trees in clipping, then again with
+ * outline simplification merging them back, and as panels
+ * with rounded corners, once as native arc edges and once tessellated.
+ *
+ * Finally the assembly is rebuilt in a context with huge-page arenas and
+ * both are run under a dTLB load-miss counter. Counters use Linux perf
+ * events and print "n/a" where unavailable (perf_event_paranoid > 2, or
+ * inside some VMs).
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#define _DEFAULT_SOURCE // syscall()
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "3d_detection_algo.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static unsigned int rng_state;
+
+// xorshift32, same sequence as createRandomAssembly() in demo-web
+static double random_unit(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state / 4294967296.0;
+}
+
+static double now_seconds(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Completion latch for detection_run_async()
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+  int finished;
+  int status;
+} AsyncWait;
+
+static void on_async_done(void *user, int status) {
+  AsyncWait *wait = user;
+
+  pthread_mutex_lock(&wait->lock);
+  wait->finished = 1;
+  wait->status = status;
+  pthread_cond_signal(&wait->done);
+  pthread_mutex_unlock(&wait->lock);
+}
+
+// Best wall time of iterations tiled runs, or a negative value on failure
+static double bench_async(DetectionContext *ctx, DetectionPool *pool,
+                          int iterations) {
+  AsyncWait wait;
+  double best = -1.0;
+  int i;
+
+  pthread_mutex_init(&wait.lock, NULL);
+  pthread_cond_init(&wait.done, NULL);
+
+  for (i = 0; i < iterations; i++) {
+    double start = now_seconds(), elapsed;
+
+    wait.finished = 0;
+    if (detection_run_async(ctx, pool, 0, NULL, on_async_done, &wait) != 0) {
+      best = -1.0;
+      break;
+    }
+
+    pthread_mutex_lock(&wait.lock);
+    while (!wait.finished)
+      pthread_cond_wait(&wait.done, &wait.lock);
+    pthread_mutex_unlock(&wait.lock);
+
+    elapsed = now_seconds() - start;
+    if (wait.status != 0) {
+      best = -1.0;
+      break;
+    }
+    if (i == 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  pthread_cond_destroy(&wait.done);
+  pthread_mutex_destroy(&wait.lock);
+
+  return best;
+}
+
+// Best wall time of iterations pipelined runs, or a negative value
+static double bench_pipelined(DetectionContext *ctx, DetectionPool *pool,
+                              int iterations) {
+  double best = -1.0;
+  int i;
+
+  for (i = 0; i < iterations; i++) {
+    double start = now_seconds(), elapsed;
+
+    if (detection_run_pipelined(ctx, pool, 0) != 0)
+      return -1.0;
+
+    elapsed = now_seconds() - start;
+    if (i == 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  return best;
+}
+
+// User-space hardware cache event counter, or -1 if it cannot be opened
+static int perf_open_cache(unsigned long long cache, unsigned long long op,
+                           unsigned long long result) {
+#ifdef __linux__
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = cache | (op << 8) | (result << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+  (void)cache;
+  (void)op;
+  (void)result;
+  return -1;
+#endif
+}
+
+static void perf_start(int fd) {
+#ifdef __linux__
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#else
+  (void)fd;
+#endif
+}
+
+// Stops and closes the counter; returns the count or -1
+static long long perf_stop(int fd) {
+  long long count = -1;
+
+#ifdef __linux__
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+      count = -1;
+    close(fd);
+  }
+#else
+  (void)fd;
+#endif
+
+  return count;
+}
+
+// dTLB load misses across iterations detection_run() calls, or -1
+static long long count_dtlb_misses(DetectionContext *ctx, int iterations) {
+  int fd, i;
+
+#ifdef __linux__
+  fd = perf_open_cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                       PERF_COUNT_HW_CACHE_RESULT_MISS);
+#else
+  fd = -1;
+#endif
+  if (fd < 0)
+    return -1;
+
+  perf_start(fd);
+  for (i = 0; i < iterations; i++)
+    detection_run(ctx);
+
+  return perf_stop(fd);
+}
+
+// Best pipelined time at the given prefetch distance, plus L1 data cache
+// load misses over all iterations (-1 if unavailable)
+static double bench_prefetch(DetectionContext *ctx, DetectionPool *pool,
+                             int iterations, int distance,
+                             long long *misses) {
+  double best;
+  int fd;
+
+  detection_context_set_prefetch_distance(ctx, distance);
+#ifdef __linux__
+  fd = perf_open_cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                       PERF_COUNT_HW_CACHE_RESULT_MISS);
+#else
+  fd = -1;
+#endif
+  perf_start(fd);
+  best = bench_pipelined(ctx, pool, iterations);
+  *misses = perf_stop(fd);
+
+  return best;
+}
+
+static void print_misses(long long misses, const char *what) {
+  if (misses < 0)
+    printf("n/a %s", what);
+  else
+    printf("%lld %s", misses, what);
+}
+
+// One joint of a run, sortable so runs that emit joints in different
+// orders can be compared
+typedef struct {
+  int component;
+  int type;
+  double segment[6];
+  double width;
+} JointRecord;
+
+static int compare_records(const void *a, const void *b) {
+  const JointRecord *ra = a, *rb = b;
+  int k;
+
+  if (ra->component != rb->component)
+    return ra->component < rb->component ? -1 : 1;
+  if (ra->type != rb->type)
+    return ra->type < rb->type ? -1 : 1;
+  for (k = 0; k < 6; k++)
+    if (ra->segment[k] != rb->segment[k])
+      return ra->segment[k] < rb->segment[k] ? -1 : 1;
+
+  return 0;
+}
+
+// Sorted copy of the last run's joints; NULL with *count 0 when empty, or
+// NULL with *count -1 on allocation failure
+static JointRecord *snapshot_joints(const DetectionContext *ctx, int *count) {
+  JointRecord *records;
+  DetectionJointIterator it;
+  DetectionJoint joint;
+  int n = 0;
+
+  *count = detection_joint_count(ctx);
+  if (*count <= 0)
+    return NULL;
+  records = malloc(sizeof(JointRecord) * *count);
+  if (!records) {
+    *count = -1;
+    return NULL;
+  }
+
+  detection_joints_begin(ctx, -1, &it);
+  while (n < *count && detection_joints_next(&it, &joint)) {
+    records[n].component = joint.component;
+    records[n].type = joint.type;
+    memcpy(records[n].segment, joint.segment, sizeof(joint.segment));
+    records[n].width = joint.width;
+    n++;
+  }
+  *count = n;
+  qsort(records, n, sizeof(JointRecord), compare_records);
+
+  return records;
+}
+
+// Joints of the last run in ctx that differ from the expected snapshot by
+// more than tolerance in any coordinate or width, or in component or type,
+// counting every joint present in only one; *deviation gets the largest
+// coordinate difference among the matched ones
+static int diff_joints(const DetectionContext *ctx,
+                       const JointRecord *expected, int expected_count,
+                       double tolerance, double *deviation) {
+  int count, k, c, mismatches;
+  JointRecord *actual = snapshot_joints(ctx, &count);
+
+  *deviation = 0.0;
+  if (count < 0)
+    return -1;
+
+  mismatches = count > expected_count ? count - expected_count
+                                      : expected_count - count;
+  for (k = 0; k < count && k < expected_count; k++) {
+    const JointRecord *a = &actual[k], *e = &expected[k];
+    double worst = fabs(a->width - e->width);
+
+    for (c = 0; c < 6; c++)
+      if (fabs(a->segment[c] - e->segment[c]) > worst)
+        worst = fabs(a->segment[c] - e->segment[c]);
+    if (worst > *deviation)
+      *deviation = worst;
+    if (a->component != e->component || a->type != e->type ||
+        worst > tolerance)
+      mismatches++;
+  }
+  free(actual);
+
+  return mismatches;
+}
+
+// Random w x h panel size and a rigid transform rotating it about a random
+// axis (Rodrigues) to a random position
+static void random_pose(double side, double *w, double *h,
+                        double *transform) {
+  double ax, ay, az, len;
+  double x, y, z, angle, c, s, t;
+
+  *w = 1 + random_unit() * 4;
+  *h = 1 + random_unit() * 4;
+  ax = random_unit() - 0.5;
+  ay = random_unit() - 0.5;
+  az = random_unit() - 0.5;
+  len = sqrt(ax * ax + ay * ay + az * az);
+  if (len == 0.0)
+    len = 1.0;
+  x = ax / len;
+  y = ay / len;
+  z = az / len;
+  angle = random_unit() * M_PI;
+  c = cos(angle);
+  s = sin(angle);
+  t = 1 - c;
+
+  transform[0] = t * x * x + c;
+  transform[1] = t * x * y - s * z;
+  transform[2] = t * x * z + s * y;
+  transform[3] = random_unit() * side;
+  transform[4] = t * x * y + s * z;
+  transform[5] = t * y * y + c;
+  transform[6] = t * y * z - s * x;
+  transform[7] = random_unit() * side;
+  transform[8] = t * x * z - s * y;
+  transform[9] = t * y * z + s * x;
+  transform[10] = t * z * z + c;
+  transform[11] = random_unit() * side;
+  transform[12] = transform[13] = transform[14] = 0.0;
+  transform[15] = 1.0;
+}
+
+// Random panel with each side split into detail collinear edges
+static int add_random_panel(DetectionContext *ctx, int id, double side,
+                            int detail) {
+  double *vertices = malloc(sizeof(double) * 12 * detail);
+  double transform[16], w, h;
+  int k, index;
+
+  if (!vertices)
+    return -1;
+  random_pose(side, &w, &h, transform);
+
+  for (k = 0; k < 4 * detail; k++) {
+    double f = (double)(k % detail) / detail;
+    double *v = &vertices[3 * k];
+
+    switch (k / detail) {
+    case 0:
+      v[0] = w * f, v[1] = 0;
+      break;
+    case 1:
+      v[0] = w, v[1] = h * f;
+      break;
+    case 2:
+      v[0] = w * (1 - f), v[1] = h;
+      break;
+    default:
+      v[0] = 0, v[1] = h * (1 - f);
+    }
+    v[2] = 0;
+  }
+
+  index = detection_add_component(ctx, id, vertices, 4 * detail, transform);
+  free(vertices);
+
+  return index;
+}
+
+// Random panel with rounded corners: native quarter-circle arcs when chords
+// is 0, otherwise each corner tessellated into that many straight edges
+static int add_rounded_panel(DetectionContext *ctx, int id, double side,
+                             int chords) {
+  int steps = chords > 0 ? chords : 1, count = 4 * (steps + 1);
+  double *vertices = malloc(sizeof(double) * 3 * count);
+  double *bulges = malloc(sizeof(double) * count);
+  double transform[16], w, h, r;
+  int corner, k, index = -1;
+
+  if (vertices && bulges) {
+    random_pose(side, &w, &h, transform);
+    r = 0.25 * (w < h ? w : h);
+
+    for (corner = 0; corner < 4; corner++) {
+      double cx = corner == 0 || corner == 1 ? w - r : r;
+      double cy = corner == 1 || corner == 2 ? h - r : r;
+
+      for (k = 0; k <= steps; k++) {
+        double angle = (corner - 1 + (double)k / steps) * M_PI / 2;
+        int v = corner * (steps + 1) + k;
+
+        vertices[3 * v] = cx + r * cos(angle);
+        vertices[3 * v + 1] = cy + r * sin(angle);
+        vertices[3 * v + 2] = 0;
+        bulges[v] = chords == 0 && k == 0 ? tan(M_PI / 8) : 0.0;
+      }
+    }
+
+    index = detection_add_curved_component(ctx, id, vertices, bulges, count,
+                                           transform);
+  }
+  free(vertices);
+  free(bulges);
+
+  return index;
+}
+
+// Random panel added as strips abutting side by side in one plane, as a
+// face split into several components; returns 0 or -1
+static int add_split_panel(DetectionContext *ctx, int id, double side,
+                           int strips) {
+  double transform[16], w, h;
+  int k;
+
+  random_pose(side, &w, &h, transform);
+  for (k = 0; k < strips; k++) {
+    double x0 = w * k / strips, x1 = w * (k + 1) / strips;
+    double vertices[12] = {x0, 0, 0, x1, 0, 0, x1, h, 0, x0, h, 0};
+
+    if (detection_add_component(ctx, id, vertices, 4, transform) < 0)
+      return -1;
+  }
+
+  return 0;
+}
+
+// Same panels for the same seed, so contexts can be compared
+static int build_detailed_assembly(DetectionContext *ctx, int count,
+                                   unsigned long seed, int detail) {
+  double side = cbrt((double)count) * 3;
+  int i;
+
+  rng_state = (unsigned int)seed ? (unsigned int)seed : 1;
+  for (i = 0; i < count; i++) {
+    if (add_random_panel(ctx, i + 1, side, detail) < 0) {
+      fprintf(stderr, "ERROR: could not add component %d\n", i + 1);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static int build_assembly(DetectionContext *ctx, int count,
+                          unsigned long seed) {
+  return build_detailed_assembly(ctx, count, seed, 1);
+}
+
+// Times a run over rounded panels and returns the best time, or -1.0
+static int build_rounded_assembly(DetectionContext *ctx, int count,
+                                  unsigned long seed, int chords) {
+  double side = cbrt((double)count) * 3;
+  int i;
+
+  rng_state = (unsigned int)seed ? (unsigned int)seed : 1;
+  for (i = 0; i < count; i++)
+    if (add_rounded_panel(ctx, i + 1, side, chords) < 0)
+      return -1;
+
+  return 0;
+}
+
+static double bench_rounded(int count, unsigned long seed, int iterations,
+                            int chords, int *joints) {
+  DetectionContext *rounded = detection_context_create();
+  double best = 0.0;
+  DetectionStats stats;
+  int i;
+
+  if (!rounded)
+    return -1.0;
+  if (build_rounded_assembly(rounded, count, seed, chords) != 0) {
+    detection_context_destroy(rounded);
+    return -1.0;
+  }
+
+  for (i = 0; i < iterations; i++) {
+    double start = now_seconds(), elapsed;
+
+    if (detection_run(rounded) != 0) {
+      detection_context_destroy(rounded);
+      return -1.0;
+    }
+    elapsed = now_seconds() - start;
+    if (i == 0 || elapsed < best)
+      best = elapsed;
+  }
+  detection_get_stats(rounded, &stats);
+  *joints = stats.joint_count;
+  detection_context_destroy(rounded);
+
+  return best;
+}
+
+// Panels split into strips: phase 1 merges each back into one face, so the
+// pair loop sees as many faces as the unsplit assembly
+static int bench_split(int count, unsigned long seed, int iterations,
+                       int strips) {
+  DetectionContext *split = detection_context_create();
+  double side = cbrt((double)count) * 3, best = 0.0;
+  DetectionStats stats;
+  int i;
+
+  if (!split)
+    return -1;
+  rng_state = (unsigned int)seed ? (unsigned int)seed : 1;
+  for (i = 0; i < count; i++) {
+    if (add_split_panel(split, i + 1, side, strips) != 0) {
+      detection_context_destroy(split);
+      return -1;
+    }
+  }
+
+  for (i = 0; i < iterations; i++) {
+    double start = now_seconds(), elapsed;
+
+    if (detection_run(split) != 0) {
+      detection_context_destroy(split);
+      return -1;
+    }
+    elapsed = now_seconds() - start;
+    if (i == 0 || elapsed < best)
+      best = elapsed;
+  }
+  detection_get_stats(split, &stats);
+  printf("split %d ways: best %.3f ms, %d of %d components merged, "
+         "%llu pairs tested, %d joints\n",
+         strips, best * 1e3, stats.components_merged, stats.components,
+         stats.pairs_tested, stats.joint_count);
+  detection_context_destroy(split);
+
+  return 0;
+}
+
+// Rounded-corner panels with native arcs against 16-chord tessellation
+static int bench_arcs(int count, unsigned long seed, int iterations) {
+  int native_joints, chord_joints;
+  double native = bench_rounded(count, seed, iterations, 0, &native_joints);
+  double chords = bench_rounded(count, seed, iterations, 16, &chord_joints);
+
+  if (native < 0.0 || chords < 0.0)
+    return -1;
+
+  printf("arcs:         best %.3f ms native, %.3f ms as 16 chords a corner "
+         "(%d / %d joints)\n",
+         native * 1e3, chords * 1e3, native_joints, chord_joints);
+
+  return 0;
+}
+
+static void print_dtlb(const char *label, long long misses,
+                       const DetectionMemory *memory) {
+  printf("%s", label);
+  print_misses(misses, "dTLB misses");
+  printf(", %.1f MB arenas (%.1f MB huge)\n", memory->reserved / 1048576.0,
+         memory->huge_page_backed / 1048576.0);
+}
+
+// Rebuilds the assembly with huge-page arenas and compares dTLB misses
+static int bench_huge_pages(DetectionContext *ctx, int count,
+                            unsigned long seed, int iterations) {
+  DetectionContext *huge = detection_context_create();
+  DetectionMemory memory;
+  long long small_misses, huge_misses;
+
+  if (!huge)
+    return -1;
+  if (detection_context_set_huge_pages(huge, 1) != 0) {
+    printf("huge pages:   not supported by this build\n");
+    detection_context_destroy(huge);
+    return 0;
+  }
+  if (build_assembly(huge, count, seed) != 0) {
+    detection_context_destroy(huge);
+    return -1;
+  }
+
+  small_misses = count_dtlb_misses(ctx, iterations);
+  huge_misses = count_dtlb_misses(huge, iterations);
+
+  detection_get_memory(ctx, &memory);
+  print_dtlb("4k pages:     ", small_misses, &memory);
+  detection_get_memory(huge, &memory);
+  print_dtlb("huge pages:   ", huge_misses, &memory);
+
+  detection_context_destroy(huge);
+
+  return 0;
+}
+
+// Rebuilds the assembly with quantized outlines and times the pipelined
+// run, whose broad phase decodes every vertex. Its joints must match the
+// full-precision ones in ctx's last run to within QUANTIZED_TOLERANCE:
+// panels here are at most 5 across, a quantization step of under 1e-4.
+#define QUANTIZED_TOLERANCE 1e-3
+
+// Rectangles quantize exactly (every vertex sits on its bounding box), so
+// the rounded panels tessellated into chords, whose vertices fall between
+// steps, check the tolerance for real
+static int compare_quantized_rounded(int count, unsigned long seed) {
+  DetectionContext *full = detection_context_create();
+  DetectionContext *quantized = detection_context_create();
+  DetectionMemory full_memory, packed_memory;
+  JointRecord *expected = NULL;
+  double deviation = 0.0;
+  int expected_count = -1, mismatches = -1;
+
+  if (full && quantized) {
+    detection_context_set_vertex_quantization(quantized, 1);
+    if (build_rounded_assembly(full, count, seed, 16) == 0 &&
+        build_rounded_assembly(quantized, count, seed, 16) == 0 &&
+        detection_run(full) == 0 && detection_run(quantized) == 0) {
+      expected = snapshot_joints(full, &expected_count);
+      if (expected_count >= 0)
+        mismatches = diff_joints(quantized, expected, expected_count,
+                                 QUANTIZED_TOLERANCE, &deviation);
+    }
+    detection_get_memory(full, &full_memory);
+    detection_get_memory(quantized, &packed_memory);
+  }
+  free(expected);
+  detection_context_destroy(full);
+  detection_context_destroy(quantized);
+  if (mismatches < 0)
+    return -1;
+
+  printf("  68 vertices: outlines %.1f KB (%.1f KB as doubles, %.1fx), "
+         "%d joints within %.1e\n",
+         packed_memory.outlines / 1024.0, full_memory.outlines / 1024.0,
+         packed_memory.outlines > 0
+             ? (double)full_memory.outlines / packed_memory.outlines
+             : 0.0,
+         expected_count, deviation);
+  if (mismatches != 0) {
+    fprintf(stderr, "ERROR: %d quantized joints differ from full precision\n",
+            mismatches);
+    return -1;
+  }
+
+  return 0;
+}
+
+static int bench_quantized(DetectionContext *ctx, DetectionPool *pool,
+                           int count, unsigned long seed, int iterations) {
+  DetectionContext *quantized = detection_context_create();
+  DetectionMemory full, packed;
+  JointRecord *expected;
+  double best, deviation = 0.0;
+  int expected_count, mismatches = 0;
+
+  if (!quantized)
+    return -1;
+  expected = snapshot_joints(ctx, &expected_count);
+  detection_context_set_vertex_quantization(quantized, 1);
+  if (expected_count < 0 || build_assembly(quantized, count, seed) != 0) {
+    free(expected);
+    detection_context_destroy(quantized);
+    return -1;
+  }
+
+  best = bench_pipelined(quantized, pool, iterations);
+  if (best >= 0.0)
+    mismatches = diff_joints(quantized, expected, expected_count,
+                             QUANTIZED_TOLERANCE, &deviation);
+  detection_get_memory(ctx, &full);
+  detection_get_memory(quantized, &packed);
+  detection_context_destroy(quantized);
+  free(expected);
+  if (best < 0.0)
+    return -1;
+
+  printf("quantized:    best %.3f ms, outlines %.1f KB (%.1f KB as doubles, "
+         "%.1fx), joints within %.1e\n",
+         best * 1e3, packed.outlines / 1024.0, full.outlines / 1024.0,
+         packed.outlines > 0 ? (double)full.outlines / packed.outlines : 0.0,
+         deviation);
+  if (mismatches != 0) {
+    fprintf(stderr, "ERROR: %d quantized joints differ from full precision\n",
+            mismatches);
+    return -1;
+  }
+
+  return compare_quantized_rounded(count, seed);
+}
+
+// Rebuilds the assembly as slabs, whose joints lie off the bare
+// intersection line, and checks the pipelined run's broad phase culls no
+// pair the sequential run finds joints for
+#define SLAB_THICKNESS 0.2
+
+static int compare_slabs_pipelined(DetectionPool *pool, int count,
+                                   unsigned long seed) {
+  DetectionContext *slabs = detection_context_create();
+  JointRecord *expected = NULL;
+  double deviation = 0.0;
+  int expected_count = -1, mismatches = -1;
+
+  if (slabs && detection_context_set_thickness(slabs, SLAB_THICKNESS) == 0 &&
+      build_assembly(slabs, count, seed) == 0 && detection_run(slabs) == 0) {
+    expected = snapshot_joints(slabs, &expected_count);
+    if (expected_count >= 0 && detection_run_pipelined(slabs, pool, 0) == 0)
+      mismatches = diff_joints(slabs, expected, expected_count, 0.0,
+                               &deviation);
+  }
+  free(expected);
+  detection_context_destroy(slabs);
+  if (mismatches < 0)
+    return -1;
+
+  printf("slabs:        %d joints at thickness %.1f, %d differ pipelined\n",
+         expected_count, SLAB_THICKNESS, mismatches);
+  if (mismatches != 0) {
+    fprintf(stderr, "ERROR: %d pipelined slab joints differ from sequential\n",
+            mismatches);
+    return -1;
+  }
+
+  return 0;
+}
+
+// Rebuilds the assembly with every panel side split into many edges; the
+// outline edge trees should keep the clipping cost per intersecting pair
+// close to the four-edge case, and simplification (tolerance > 0) should
+// merge the collinear edges back into four
+static int bench_outline_detail(int count, unsigned long seed, int iterations,
+                                int detail, double tolerance, double plain) {
+  DetectionContext *detailed = detection_context_create();
+  DetectionStats stats;
+  double best = 0.0;
+  int i;
+
+  if (!detailed)
+    return -1;
+  detection_context_set_simplify_tolerance(detailed, tolerance);
+  if (build_detailed_assembly(detailed, count, seed, detail) != 0) {
+    detection_context_destroy(detailed);
+    return -1;
+  }
+
+  for (i = 0; i < iterations; i++) {
+    double start = now_seconds(), elapsed;
+
+    if (detection_run(detailed) != 0) {
+      detection_context_destroy(detailed);
+      return -1;
+    }
+    elapsed = now_seconds() - start;
+    if (i == 0 || elapsed < best)
+      best = elapsed;
+  }
+  detection_get_stats(detailed, &stats);
+  detection_context_destroy(detailed);
+
+  printf("%5d edges:  best %.3f ms (%.2fx of 4 edges), %d joints%s\n",
+         4 * detail, best * 1e3, plain > 0.0 ? best / plain : 0.0,
+         stats.joint_count, tolerance > 0.0 ? ", simplified" : "");
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 1000;
+  int iterations = argc > 2 ? atoi(argv[2]) : 10;
+  unsigned long seed = argc > 3 ? strtoul(argv[3], NULL, 10) : 1;
+  int threads = argc > 4 ? atoi(argv[4]) : 0;
+  int prefetch = argc > 5 ? atoi(argv[5]) : 8;
+  double start, build_time, best = 0.0, total = 0.0;
+  DetectionContext *ctx;
+  DetectionStats stats;
+  DetectionJointIterator it;
+  DetectionJoint joint;
+  int i, iterated = 0;
+
+  if (count <= 0 || iterations <= 0 || prefetch < 0) {
+    fprintf(stderr,
+            "usage: %s [components] [iterations] [seed] [threads] "
+            "[prefetch]\n",
+            argv[0]);
+    return 1;
+  }
+
+  ctx = detection_context_create();
+  if (!ctx) {
+    fprintf(stderr, "ERROR: could not create detection context\n");
+    return 1;
+  }
+
+  start = now_seconds();
+  if (build_assembly(ctx, count, seed) != 0) {
+    detection_context_destroy(ctx);
+    return 1;
+  }
+  build_time = now_seconds() - start;
+
+  for (i = 0; i < iterations; i++) {
+    double elapsed;
+
+    start = now_seconds();
+    if (detection_run(ctx) != 0) {
+      fprintf(stderr, "ERROR: detection failed\n");
+      detection_context_destroy(ctx);
+      return 1;
+    }
+    elapsed = now_seconds() - start;
+
+    total += elapsed;
+    if (i == 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  // Walk every joint once so iterator cost shows up alongside detection
+  start = now_seconds();
+  detection_joints_begin(ctx, -1, &it);
+  while (detection_joints_next(&it, &joint))
+    iterated++;
+
+  detection_get_stats(ctx, &stats);
+
+  printf("libdetection %s benchmark\n", detection_version());
+  printf("components:   %d (%d vertices), seed %lu\n", stats.components,
+         stats.vertices, seed);
+  printf("build:        %.3f ms\n", build_time * 1e3);
+  printf("detect:       best %.3f ms, mean %.3f ms over %d runs\n", best * 1e3,
+         total / iterations * 1e3, iterations);
+  printf("pairs:        %llu tested (%llu parallel, %llu coplanar, "
+         "%llu intersecting), %.1f M pairs/s\n",
+         stats.pairs_tested, stats.pairs_parallel, stats.pairs_coplanar,
+         stats.pairs_intersecting,
+         best > 0.0 ? stats.pairs_tested / best * 1e-6 : 0.0);
+  printf("joints:       %d (%d finger, %d hole, %d slot), iterated %d in "
+         "%.3f ms\n",
+         stats.joint_count, stats.joints[FLAT_FINGER_JOINT],
+         stats.joints[FLAT_HOLE_JOINT], stats.joints[FLAT_SLOT_JOINT],
+         iterated, (now_seconds() - start) * 1e3);
+
+  if (threads > 0) {
+    DetectionPool *pool = detection_pool_create(threads);
+    int sequential_count, tiled_diff = -1, pipelined_diff = -1;
+    // Every mode must reproduce the sequential joints exactly
+    JointRecord *sequential = snapshot_joints(ctx, &sequential_count);
+    double deviation;
+    double tiled = pool ? bench_async(ctx, pool, iterations) : -1.0;
+    double pipelined;
+    long long plain_misses = -1, prefetch_misses = -1;
+    double plain, fetched;
+
+    if (tiled >= 0.0 && sequential_count >= 0)
+      tiled_diff = diff_joints(ctx, sequential, sequential_count, 0.0,
+                               &deviation);
+    pipelined = pool ? bench_pipelined(ctx, pool, iterations) : -1.0;
+    if (pipelined >= 0.0 && sequential_count >= 0)
+      pipelined_diff = diff_joints(ctx, sequential, sequential_count, 0.0,
+                                   &deviation);
+    free(sequential);
+    plain = pool ? bench_prefetch(ctx, pool, iterations, 0, &plain_misses)
+                 : -1.0;
+    fetched = pool ? bench_prefetch(ctx, pool, iterations, prefetch,
+                                    &prefetch_misses)
+                   : -1.0;
+
+    if (tiled < 0.0 || pipelined < 0.0 || plain < 0.0 || fetched < 0.0 ||
+        tiled_diff < 0 || pipelined_diff < 0) {
+      fprintf(stderr, "ERROR: threaded detection failed\n");
+      detection_pool_destroy(pool);
+      detection_context_destroy(ctx);
+      return 1;
+    }
+
+    // Pipelined stats only count broad-phase survivors
+    detection_get_stats(ctx, &stats);
+    printf("tiled:        best %.3f ms on %d threads (%.2fx), %d joints "
+           "differ\n",
+           tiled * 1e3, detection_pool_threads(pool),
+           tiled > 0.0 ? best / tiled : 0.0, tiled_diff);
+    printf("pipelined:    best %.3f ms (%.2fx), %llu candidate pairs, %d "
+           "joints differ\n",
+           pipelined * 1e3, pipelined > 0.0 ? best / pipelined : 0.0,
+           stats.pairs_tested, pipelined_diff);
+    if (tiled_diff != 0 || pipelined_diff != 0) {
+      fprintf(stderr, "ERROR: threaded joints differ from sequential\n");
+      detection_pool_destroy(pool);
+      detection_context_destroy(ctx);
+      return 1;
+    }
+    printf("no prefetch:  best %.3f ms, ", plain * 1e3);
+    print_misses(plain_misses, "L1d misses\n");
+    printf("prefetch %-4d best %.3f ms, ", prefetch, fetched * 1e3);
+    print_misses(prefetch_misses, "L1d misses\n");
+
+    if (bench_quantized(ctx, pool, count, seed, iterations) != 0) {
+      fprintf(stderr, "ERROR: quantized detection failed\n");
+      detection_pool_destroy(pool);
+      detection_context_destroy(ctx);
+      return 1;
+    }
+    if (compare_slabs_pipelined(pool, count, seed) != 0) {
+      fprintf(stderr, "ERROR: slab detection failed\n");
+      detection_pool_destroy(pool);
+      detection_context_destroy(ctx);
+      return 1;
+    }
+    detection_pool_destroy(pool);
+  }
+
+  if (bench_outline_detail(count, seed, iterations, 256, 0.0, best) != 0 ||
+      bench_outline_detail(count, seed, iterations, 256, 1e-9, best) != 0) {
+    fprintf(stderr, "ERROR: detailed outline detection failed\n");
+    detection_context_destroy(ctx);
+    return 1;
+  }
+
+  if (bench_arcs(count, seed, iterations) != 0) {
+    fprintf(stderr, "ERROR: rounded panel detection failed\n");
+    detection_context_destroy(ctx);
+    return 1;
+  }
+
+  if (bench_split(count, seed, iterations, 4) != 0) {
+    fprintf(stderr, "ERROR: split panel detection failed\n");
+    detection_context_destroy(ctx);
+    return 1;
+  }
+
+  if (bench_huge_pages(ctx, count, seed, iterations) != 0) {
+    fprintf(stderr, "ERROR: huge page comparison failed\n");
+    detection_context_destroy(ctx);
+    return 1;
+  }
+
+  detection_context_destroy(ctx);
+
+  return 0;
+}
@@ -0,0 +1,66 @@
+// Coroutine API: await a whole run, then stream tile batches
+#include <cstdio>
+#include <exception>
+#include <future>
+
+#include "detection_async.hpp"
+
+// Minimal fire-and-forget task so main() can wait on a coroutine
+struct task {
+  struct promise_type {
+    std::promise<void> done;
+
+    task get_return_object() { return task{done.get_future()}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() { done.set_value(); }
+    void unhandled_exception() { done.set_exception(std::current_exception()); }
+  };
+
+  std::future<void> finished;
+};
+
+static detection::Assembly<> make_assembly(int count) {
+  detection::Assembly<> assembly;
+  const std::vector<std::array<double, 3>> panel = {
+      {0, 0, 0}, {2, 0, 0}, {2, 2, 0}, {0, 2, 0}};
+
+  for (int i = 0; i < count; i++) {
+    detection::Transform transform = detection::identity_transform;
+    transform[3] = i * 0.5;
+    if (i % 2) { // stand every other panel upright
+      transform[5] = 0;
+      transform[6] = -1;
+      transform[9] = 1;
+      transform[10] = 0;
+    }
+    assembly.add_component(i + 1, panel, transform);
+  }
+  return assembly;
+}
+
+static task run(detection::Context &context, detection::Pool &pool) {
+  co_await detection::detect_async(context, pool);
+  DetectionStats stats = context.stats();
+  std::printf("detect_async: %llu pairs, %d joints\n", stats.pairs_tested,
+              stats.joint_count);
+
+  auto stream = detection::detect_tiles(context, pool, 8);
+  std::size_t tiles = 0, joints = 0;
+  while (auto batch = co_await stream.next()) {
+    tiles++;
+    joints += batch->size();
+  }
+  std::printf("detect_tiles: %zu tiles, %zu joints\n", tiles, joints);
+}
+
+int main() {
+  detection::Pool pool;
+  detection::Context context;
+  context.load(make_assembly(400));
+
+  std::printf("pool: %d threads\n", pool.threads());
+  run(context, pool).finished.get();
+
+  return 0;
+}
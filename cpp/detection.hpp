@@ -0,0 +1,510 @@
+/*
+ * 3D Component Intersection Detection - header-only C++17/20 wrapper
+ *
+ * RAII and type-safe access to libdetection (../3d_detection_algo.h):
+ *
+ *   detection::Assembly<float, detection::SoA> assembly;
+ *   assembly.add_component(1, outline, transform);
+ *   detection::Joints joints = detection::detect(assembly);
+ *   for (auto joint : joints) ...
+ *
+ * Assemblies are templated on the vertex scalar (float, double or
+ * detection::fixed<FracBits>, an int64 fixed-point value) and on the
+ * storage layout (AoS: interleaved xyz, SoA: separate x/y/z columns). The
+ * ingestion kernel that feeds the engine is picked at compile time; double
+ * AoS is handed to the engine in place with no conversion at all.
+ * Joint results are zero-copy views over the engine's output buffers.
+ */
+
+#ifndef DETECTION_HPP
+#define DETECTION_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+
+#include "3d_detection_algo.h"
+
+namespace detection {
+
+/* Spans: std::span under C++20, a minimal read-only stand-in under C++17 */
+
+#if defined(__cpp_lib_span)
+template <typename T> using span = std::span<T>;
+#else
+template <typename T> class span {
+public:
+  using element_type = T;
+  using value_type = std::remove_cv_t<T>;
+  using iterator = T *;
+
+  constexpr span() noexcept = default;
+  constexpr span(T *data, std::size_t size) noexcept
+      : data_(data), size_(size) {}
+
+  constexpr T *data() const noexcept { return data_; }
+  constexpr std::size_t size() const noexcept { return size_; }
+  constexpr bool empty() const noexcept { return size_ == 0; }
+  constexpr T &operator[](std::size_t i) const noexcept { return data_[i]; }
+  constexpr iterator begin() const noexcept { return data_; }
+  constexpr iterator end() const noexcept { return data_ + size_; }
+
+private:
+  T *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+#endif
+
+/* Scalars */
+
+// Signed 64-bit fixed point with FracBits fractional bits
+template <int FracBits = 32> struct fixed {
+  static_assert(FracBits > 0 && FracBits < 63, "FracBits out of range");
+  static constexpr double scale = double(std::int64_t{1} << FracBits);
+
+  std::int64_t raw = 0;
+
+  constexpr fixed() noexcept = default;
+  constexpr fixed(double value) noexcept
+      : raw(static_cast<std::int64_t>(value * scale)) {}
+
+  static constexpr fixed from_raw(std::int64_t raw) noexcept {
+    fixed f;
+    f.raw = raw;
+    return f;
+  }
+
+  constexpr double to_double() const noexcept { return double(raw) / scale; }
+};
+
+template <typename Scalar> struct scalar_traits;
+
+template <> struct scalar_traits<double> {
+  static constexpr double to_double(double v) noexcept { return v; }
+};
+
+template <> struct scalar_traits<float> {
+  static constexpr double to_double(float v) noexcept { return v; }
+};
+
+template <int FracBits> struct scalar_traits<fixed<FracBits>> {
+  static constexpr double to_double(fixed<FracBits> v) noexcept {
+    return v.to_double();
+  }
+};
+
+/* Layouts */
+
+struct AoS {}; // x0 y0 z0 x1 y1 z1 ...
+struct SoA {}; // x0 x1 ... / y0 y1 ... / z0 z1 ...
+
+enum class JointType : unsigned char {
+  finger = FLAT_FINGER_JOINT,
+  hole = FLAT_HOLE_JOINT,
+  slot = FLAT_SLOT_JOINT
+};
+
+// Row-major rigid local-to-world transform
+using Transform = std::array<double, 16>;
+
+inline constexpr Transform identity_transform = {1, 0, 0, 0, 0, 1, 0, 0,
+                                                 0, 0, 1, 0, 0, 0, 0, 1};
+
+/* Assemblies */
+
+namespace detail {
+
+template <typename Scalar, typename Layout> struct vertex_storage;
+
+template <typename Scalar> struct vertex_storage<Scalar, AoS> {
+  std::vector<Scalar> xyz;
+
+  std::size_t size() const noexcept { return xyz.size() / 3; }
+
+  void reserve(std::size_t n) { xyz.reserve(n * 3); }
+
+  void push_back(Scalar x, Scalar y, Scalar z) {
+    xyz.push_back(x);
+    xyz.push_back(y);
+    xyz.push_back(z);
+  }
+
+  void clear() noexcept { xyz.clear(); }
+
+  // Ingestion kernel: widen to the engine's interleaved doubles
+  void pack(double *out) const noexcept {
+    const Scalar *src = xyz.data();
+    const std::size_t n = xyz.size();
+
+    for (std::size_t i = 0; i < n; i++)
+      out[i] = scalar_traits<Scalar>::to_double(src[i]);
+  }
+};
+
+template <typename Scalar> struct vertex_storage<Scalar, SoA> {
+  std::vector<Scalar> x, y, z;
+
+  std::size_t size() const noexcept { return x.size(); }
+
+  void reserve(std::size_t n) {
+    x.reserve(n);
+    y.reserve(n);
+    z.reserve(n);
+  }
+
+  void push_back(Scalar vx, Scalar vy, Scalar vz) {
+    x.push_back(vx);
+    y.push_back(vy);
+    z.push_back(vz);
+  }
+
+  void clear() noexcept {
+    x.clear();
+    y.clear();
+    z.clear();
+  }
+
+  // Ingestion kernel: interleave columns into the engine's xyz triples
+  void pack(double *out) const noexcept {
+    const std::size_t n = x.size();
+
+    for (std::size_t i = 0; i < n; i++) {
+      out[i * 3 + 0] = scalar_traits<Scalar>::to_double(x[i]);
+      out[i * 3 + 1] = scalar_traits<Scalar>::to_double(y[i]);
+      out[i * 3 + 2] = scalar_traits<Scalar>::to_double(z[i]);
+    }
+  }
+};
+
+} // namespace detail
+
+template <typename Scalar = double, typename Layout = AoS> class Assembly {
+public:
+  using scalar_type = Scalar;
+  using layout_type = Layout;
+  using point_type = std::array<Scalar, 3>;
+
+  // Engine reads double AoS vertices in place, everything else is packed
+  static constexpr bool zero_copy =
+      std::is_same_v<Scalar, double> && std::is_same_v<Layout, AoS>;
+
+  Assembly() { offsets_.push_back(0); }
+
+  // Outline points are in the component's local frame; returns its index
+  std::size_t add_component(int id, span<const point_type> outline,
+                            const Transform &transform = identity_transform) {
+    vertices_.reserve(vertices_.size() + outline.size());
+    for (const point_type &p : outline)
+      vertices_.push_back(p[0], p[1], p[2]);
+
+    offsets_.push_back(static_cast<int>(vertices_.size()));
+    transforms_.insert(transforms_.end(), transform.begin(), transform.end());
+    ids_.push_back(id);
+
+    return ids_.size() - 1;
+  }
+
+  std::size_t add_component(int id, const std::vector<point_type> &outline,
+                            const Transform &transform = identity_transform) {
+    return add_component(
+        id, span<const point_type>(outline.data(), outline.size()), transform);
+  }
+
+  void clear() noexcept {
+    vertices_.clear();
+    offsets_.resize(1);
+    transforms_.clear();
+    ids_.clear();
+  }
+
+  std::size_t size() const noexcept { return ids_.size(); }
+  std::size_t vertex_count() const noexcept { return vertices_.size(); }
+
+  const detail::vertex_storage<Scalar, Layout> &storage() const noexcept {
+    return vertices_;
+  }
+
+  // Borrowed view for the C API; valid until the assembly is modified
+  FlatAssembly flat() const {
+    FlatAssembly assembly;
+
+    if constexpr (zero_copy) {
+      assembly.vertices = vertices_.xyz.data();
+    } else {
+      staging_.resize(vertices_.size() * 3);
+      vertices_.pack(staging_.data());
+      assembly.vertices = staging_.data();
+    }
+    assembly.vertex_offsets = offsets_.data();
+    assembly.transforms = transforms_.data();
+    assembly.ids = ids_.data();
+    assembly.count = static_cast<int>(ids_.size());
+
+    return assembly;
+  }
+
+private:
+  detail::vertex_storage<Scalar, Layout> vertices_;
+  std::vector<int> offsets_;
+  std::vector<double> transforms_;
+  std::vector<int> ids_;
+  mutable std::vector<double> staging_; // reused across detect() calls
+};
+
+/* Results */
+
+// One joint; segment points into the owning result buffer
+struct Joint {
+  JointType type;
+  int component;
+  span<const double> segment; // start xyz, end xyz, component local frame
+};
+
+// Owns the engine's joint buffers; move-only
+class Joints {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = Joint;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Joint;
+
+    iterator() noexcept = default;
+    iterator(const FlatJoints *joints, std::size_t index) noexcept
+        : joints_(joints), index_(index) {}
+
+    Joint operator*() const noexcept {
+      return Joint{static_cast<JointType>(joints_->types[index_]),
+                   joints_->components[index_],
+                   span<const double>(joints_->segments + index_ * 6, 6)};
+    }
+    Joint operator[](difference_type n) const noexcept {
+      return *(*this + n);
+    }
+
+    iterator &operator++() noexcept { return ++index_, *this; }
+    iterator operator++(int) noexcept { return iterator(joints_, index_++); }
+    iterator &operator--() noexcept { return --index_, *this; }
+    iterator operator--(int) noexcept { return iterator(joints_, index_--); }
+    iterator &operator+=(difference_type n) noexcept {
+      return index_ += n, *this;
+    }
+    iterator &operator-=(difference_type n) noexcept {
+      return index_ -= n, *this;
+    }
+    friend iterator operator+(iterator it, difference_type n) noexcept {
+      return it += n;
+    }
+    friend iterator operator+(difference_type n, iterator it) noexcept {
+      return it += n;
+    }
+    friend iterator operator-(iterator it, difference_type n) noexcept {
+      return it -= n;
+    }
+    friend difference_type operator-(iterator a, iterator b) noexcept {
+      return difference_type(a.index_) - difference_type(b.index_);
+    }
+    friend bool operator==(iterator a, iterator b) noexcept {
+      return a.index_ == b.index_;
+    }
+    friend bool operator!=(iterator a, iterator b) noexcept {
+      return a.index_ != b.index_;
+    }
+    friend bool operator<(iterator a, iterator b) noexcept {
+      return a.index_ < b.index_;
+    }
+    friend bool operator>(iterator a, iterator b) noexcept { return b < a; }
+    friend bool operator<=(iterator a, iterator b) noexcept {
+      return !(b < a);
+    }
+    friend bool operator>=(iterator a, iterator b) noexcept {
+      return !(a < b);
+    }
+
+  private:
+    const FlatJoints *joints_ = nullptr;
+    std::size_t index_ = 0;
+  };
+
+  Joints() noexcept = default;
+  explicit Joints(FlatJoints raw) noexcept : raw_(raw) {}
+  Joints(Joints &&other) noexcept : raw_(std::exchange(other.raw_, {})) {}
+  Joints &operator=(Joints &&other) noexcept {
+    if (this != &other) {
+      free_flat_joints(&raw_);
+      raw_ = std::exchange(other.raw_, {});
+    }
+    return *this;
+  }
+  Joints(const Joints &) = delete;
+  Joints &operator=(const Joints &) = delete;
+  ~Joints() { free_flat_joints(&raw_); }
+
+  std::size_t size() const noexcept { return std::size_t(raw_.count); }
+  bool empty() const noexcept { return raw_.count == 0; }
+
+  iterator begin() const noexcept { return iterator(&raw_, 0); }
+  iterator end() const noexcept { return iterator(&raw_, size()); }
+  Joint operator[](std::size_t i) const noexcept { return begin()[i]; }
+
+  // Zero-copy column views over the engine's buffers
+  span<const double> segments() const noexcept {
+    return span<const double>(raw_.segments, size() * 6);
+  }
+  span<const JointType> types() const noexcept {
+    static_assert(sizeof(JointType) == sizeof(unsigned char));
+    return span<const JointType>(
+        reinterpret_cast<const JointType *>(raw_.types), size());
+  }
+  span<const int> components() const noexcept {
+    return span<const int>(raw_.components, size());
+  }
+
+  const FlatJoints &raw() const noexcept { return raw_; }
+
+private:
+  FlatJoints raw_{};
+};
+
+class error : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+// One-shot detection over an assembly
+template <typename Scalar, typename Layout>
+Joints detect(const Assembly<Scalar, Layout> &assembly) {
+  FlatAssembly flat = assembly.flat();
+  FlatJoints raw{};
+
+  if (detect_flat_assembly(&flat, &raw) != 0) {
+    free_flat_joints(&raw);
+    throw error("detection failed");
+  }
+
+  return Joints(raw);
+}
+
+/* Context: RAII over DetectionContext for repeated runs with stats */
+
+class Context {
+public:
+  class joint_range;
+
+  Context() : ctx_(detection_context_create()) {
+    if (!ctx_)
+      throw std::bad_alloc();
+  }
+
+  void clear() noexcept { detection_context_clear(ctx_.get()); }
+
+  // Copies the assembly into the context (after any existing components)
+  template <typename Scalar, typename Layout>
+  void load(const Assembly<Scalar, Layout> &assembly) {
+    FlatAssembly flat = assembly.flat();
+
+    if (detection_add_flat_assembly(ctx_.get(), &flat) != 0)
+      throw error("could not load assembly");
+  }
+
+  void run() {
+    if (detection_run(ctx_.get()) != 0)
+      throw error("detection failed");
+  }
+
+  std::size_t size() const noexcept {
+    return std::size_t(detection_component_count(ctx_.get()));
+  }
+
+  DetectionStats stats() const noexcept {
+    DetectionStats stats;
+    detection_get_stats(ctx_.get(), &stats);
+    return stats;
+  }
+
+  // Joints of one component, or of every component when component < 0
+  joint_range joints(int component = -1) const noexcept;
+
+  DetectionContext *get() const noexcept { return ctx_.get(); }
+
+private:
+  struct deleter {
+    void operator()(DetectionContext *ctx) const noexcept {
+      detection_context_destroy(ctx);
+    }
+  };
+
+  std::unique_ptr<DetectionContext, deleter> ctx_;
+};
+
+// Input range over DetectionJointIterator
+class Context::joint_range {
+public:
+  struct sentinel {};
+
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = DetectionJoint;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const DetectionJoint *;
+    using reference = const DetectionJoint &;
+
+    iterator() noexcept = default;
+    iterator(const DetectionContext *ctx, int component) noexcept {
+      detection_joints_begin(ctx, component, &it_);
+      ++*this;
+    }
+
+    reference operator*() const noexcept { return joint_; }
+    pointer operator->() const noexcept { return &joint_; }
+    iterator &operator++() noexcept {
+      done_ = !detection_joints_next(&it_, &joint_);
+      return *this;
+    }
+    void operator++(int) noexcept { ++*this; }
+
+    friend bool operator==(const iterator &it, sentinel) noexcept {
+      return it.done_;
+    }
+    friend bool operator!=(const iterator &it, sentinel s) noexcept {
+      return !(it == s);
+    }
+
+  private:
+    DetectionJointIterator it_{};
+    DetectionJoint joint_{};
+    bool done_ = true;
+  };
+
+  joint_range(const DetectionContext *ctx, int component) noexcept
+      : ctx_(ctx), component_(component) {}
+
+  iterator begin() const noexcept { return iterator(ctx_, component_); }
+  sentinel end() const noexcept { return {}; }
+
+private:
+  const DetectionContext *ctx_;
+  int component_;
+};
+
+inline Context::joint_range Context::joints(int component) const noexcept {
+  return joint_range(ctx_.get(), component);
+}
+
+} // namespace detection
+
+#endif /* DETECTION_HPP */
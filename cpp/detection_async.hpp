@@ -0,0 +1,230 @@
+/*
+ * 3D Component Intersection Detection - C++20 coroutine API
+ *
+ * Builds on detection.hpp and the engine's worker pool:
+ *
+ *   detection::Pool pool;                       // engine threads
+ *   co_await detection::detect_async(context, pool);
+ *
+ *   auto stream = detection::detect_tiles(context, pool);
+ *   while (auto batch = co_await stream.next())
+ *     consume(*batch);                          // one tile's joints
+ *
+ * Detection never runs on the awaiting thread. Coroutines resume on the
+ * engine worker that finished the work, so hop back to your own executor
+ * after co_await if the continuation must not run there.
+ */
+
+#ifndef DETECTION_ASYNC_HPP
+#define DETECTION_ASYNC_HPP
+
+#include <coroutine>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include "detection.hpp"
+
+namespace detection {
+
+// RAII over DetectionPool; threads <= 0 uses one per online CPU
+class Pool {
+public:
+  explicit Pool(int threads = 0) : pool_(detection_pool_create(threads)) {
+    if (!pool_)
+      throw std::bad_alloc();
+  }
+
+  int threads() const noexcept { return detection_pool_threads(pool_.get()); }
+  DetectionPool *get() const noexcept { return pool_.get(); }
+
+private:
+  struct deleter {
+    void operator()(DetectionPool *pool) const noexcept {
+      detection_pool_destroy(pool);
+    }
+  };
+
+  std::unique_ptr<DetectionPool, deleter> pool_;
+};
+
+// Awaitable for a whole run; joints land in the context
+class detect_awaiter {
+public:
+  detect_awaiter(Context &context, Pool &pool, int tiles) noexcept
+      : context_(context), pool_(pool), tiles_(tiles) {}
+
+  bool await_ready() const noexcept { return false; }
+
+  bool await_suspend(std::coroutine_handle<> caller) {
+    caller_ = caller;
+    // on_done may resume the caller before this returns; touch nothing after
+    if (detection_run_async(context_.get(), pool_.get(), tiles_, nullptr,
+                            on_done, this) != 0) {
+      status_ = -1;
+      return false;
+    }
+    return true;
+  }
+
+  void await_resume() const {
+    if (status_ != 0)
+      throw error("detection failed");
+  }
+
+private:
+  static void on_done(void *user, int status) {
+    auto *self = static_cast<detect_awaiter *>(user);
+    self->status_ = status;
+    self->caller_.resume();
+  }
+
+  Context &context_;
+  Pool &pool_;
+  int tiles_;
+  int status_ = 0;
+  std::coroutine_handle<> caller_;
+};
+
+// co_await detect_async(context, pool) runs detection on the pool; the
+// context must stay alive and untouched until the await completes
+inline detect_awaiter detect_async(Context &context, Pool &pool,
+                                   int tiles = 0) noexcept {
+  return detect_awaiter(context, pool, tiles);
+}
+
+// Joints from one completed tile; copied out of the engine's tile buffers
+struct TileBatch {
+  int tile = 0;
+  int tile_count = 0;
+  int first_component = 0; // rows [first_component, end_component)
+  int end_component = 0;
+  std::vector<double> segments; // 6 per joint, component local frame
+  std::vector<JointType> types;
+  std::vector<int> components;
+
+  std::size_t size() const noexcept { return types.size(); }
+};
+
+/*
+ * Async generator of tile batches. Tiles arrive in completion order;
+ * next() yields std::nullopt once every tile has been delivered and the
+ * joints have been merged into the context. Drain the stream before using
+ * or destroying the context; dropping it early is safe for the stream
+ * itself (the engine keeps its state alive) but the run keeps going.
+ */
+class TileStream {
+  struct State {
+    std::mutex lock;
+    std::deque<TileBatch> ready;
+    std::coroutine_handle<> waiter;
+    bool done = false;
+    int status = 0;
+    std::shared_ptr<State> keep_alive; // held by the engine until on_done
+  };
+
+public:
+  class next_awaiter {
+  public:
+    explicit next_awaiter(State &state) noexcept : state_(state) {}
+
+    bool await_ready() {
+      std::lock_guard<std::mutex> guard(state_.lock);
+      return !state_.ready.empty() || state_.done;
+    }
+
+    bool await_suspend(std::coroutine_handle<> caller) {
+      std::lock_guard<std::mutex> guard(state_.lock);
+      if (!state_.ready.empty() || state_.done)
+        return false;
+      state_.waiter = caller;
+      return true;
+    }
+
+    std::optional<TileBatch> await_resume() {
+      std::lock_guard<std::mutex> guard(state_.lock);
+      if (!state_.ready.empty()) {
+        std::optional<TileBatch> batch(std::move(state_.ready.front()));
+        state_.ready.pop_front();
+        return batch;
+      }
+      if (state_.status != 0)
+        throw error("detection failed");
+      return std::nullopt;
+    }
+
+  private:
+    State &state_;
+  };
+
+  TileStream(Context &context, Pool &pool, int tiles)
+      : state_(std::make_shared<State>()) {
+    state_->keep_alive = state_;
+    if (detection_run_async(context.get(), pool.get(), tiles, on_tile,
+                            on_done, state_.get()) != 0) {
+      state_->keep_alive.reset();
+      throw error("could not schedule detection");
+    }
+  }
+
+  TileStream(TileStream &&) noexcept = default;
+  TileStream &operator=(TileStream &&) = delete;
+  TileStream(const TileStream &) = delete;
+  TileStream &operator=(const TileStream &) = delete;
+
+  // One consumer at a time: await next() before calling it again
+  next_awaiter next() noexcept { return next_awaiter(*state_); }
+
+private:
+  static void on_tile(void *user, const DetectionTile *tile) {
+    auto *state = static_cast<State *>(user);
+    const auto *types = reinterpret_cast<const JointType *>(tile->types);
+    TileBatch batch;
+    std::coroutine_handle<> waiter;
+
+    batch.tile = tile->index;
+    batch.tile_count = tile->tile_count;
+    batch.first_component = tile->first_component;
+    batch.end_component = tile->end_component;
+    batch.segments.assign(tile->segments, tile->segments + tile->count * 6);
+    batch.types.assign(types, types + tile->count);
+    batch.components.assign(tile->components,
+                            tile->components + tile->count);
+
+    {
+      std::lock_guard<std::mutex> guard(state->lock);
+      state->ready.push_back(std::move(batch));
+      waiter = std::exchange(state->waiter, nullptr);
+    }
+    if (waiter)
+      waiter.resume();
+  }
+
+  static void on_done(void *user, int status) {
+    auto *state = static_cast<State *>(user);
+    std::shared_ptr<State> keep_alive;
+    std::coroutine_handle<> waiter;
+
+    {
+      std::lock_guard<std::mutex> guard(state->lock);
+      state->done = true;
+      state->status = status;
+      waiter = std::exchange(state->waiter, nullptr);
+      keep_alive = std::move(state->keep_alive);
+    }
+    if (waiter)
+      waiter.resume();
+  }
+
+  std::shared_ptr<State> state_;
+};
+
+// Starts a tiled run; the context must outlive the returned stream
+inline TileStream detect_tiles(Context &context, Pool &pool, int tiles = 0) {
+  return TileStream(context, pool, tiles);
+}
+
+} // namespace detection
+
+#endif /* DETECTION_ASYNC_HPP */
@@ -0,0 +1,54 @@
+// Two 2x2 panels through the C++ wrapper, once per scalar/layout flavour
+#include <cstdio>
+
+#include "detection.hpp"
+
+template <typename Scalar, typename Layout>
+static void run(const char *name) {
+  using Point = typename detection::Assembly<Scalar, Layout>::point_type;
+  const std::vector<Point> panel = {
+      {Scalar(0), Scalar(0), Scalar(0)},
+      {Scalar(2), Scalar(0), Scalar(0)},
+      {Scalar(2), Scalar(2), Scalar(0)},
+      {Scalar(0), Scalar(2), Scalar(0)}};
+  // Second panel stood upright on the first along y = 1: local y maps to
+  // world z, so its bottom edge rests across the first panel's face
+  const detection::Transform upright = {1, 0, 0, 1, 0, 0, -1, 1,
+                                        0, 1, 0, 0, 0, 0, 0,  1};
+
+  detection::Assembly<Scalar, Layout> assembly;
+  assembly.add_component(1, panel);
+  assembly.add_component(2, panel, upright);
+
+  detection::Joints joints = detection::detect(assembly);
+  std::printf("%-14s %zu joints%s\n", name, joints.size(),
+              assembly.zero_copy ? " (zero-copy input)" : "");
+  for (const detection::Joint &joint : joints)
+    std::printf("  component %d type %d (%.2f, %.2f, %.2f)\n",
+                joint.component, int(joint.type), joint.segment[0],
+                joint.segment[1], joint.segment[2]);
+}
+
+int main() {
+  run<double, detection::AoS>("double/AoS");
+  run<float, detection::SoA>("float/SoA");
+  run<detection::fixed<16>, detection::SoA>("fixed<16>/SoA");
+
+  // Context keeps the assembly for repeated runs and reports stats
+  detection::Assembly<> assembly;
+  assembly.add_component(1, {{0, 0, 0}, {2, 0, 0}, {2, 2, 0}, {0, 2, 0}});
+  assembly.add_component(2, {{0, 0, 0}, {2, 0, 0}, {2, 2, 0}, {0, 2, 0}},
+                         {1, 0, 0, 1, 0, 0, -1, 1, 0, 1, 0, 0, 0, 0, 0, 1});
+
+  detection::Context context;
+  context.load(assembly);
+  context.run();
+
+  DetectionStats stats = context.stats();
+  std::printf("context        %llu pairs tested, %d joints\n",
+              stats.pairs_tested, stats.joint_count);
+  for (const DetectionJoint &joint : context.joints())
+    std::printf("  component %d type %d\n", joint.component_id, joint.type);
+
+  return 0;
+}
@@ -3,21 +3,33 @@
  * Using ncurses for terminal-based visualization
  */
 
-#define _POSIX_C_SOURCE 199309L
+#define _POSIX_C_SOURCE 200809L
 
 #include <curses.h>
+#include <limits.h>
 #include <math.h>
+#include <poll.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
+
 #define EPSILON 1e-9
 #define MAX_COMPONENTS 10
 #define MAX_SEGMENTS 100
 #define MAX_JOINTS 500
 #define MAX_LOG_LINES 100
+#define FRAME_MS 33
+
+/* Events reported by wait_event */
+#define EVENT_INPUT 1
+#define EVENT_TIMER 2
 
 /* 3D Vector */
 typedef struct {
@@ -78,6 +90,53 @@ typedef struct {
   int capacity;
 } ComponentArray;
 
+/* Detection trace (binary format shared with 3d_detection_algo.c) */
+#define TRACE_MAGIC "D3TR"
+#define TRACE_VERSION 2
+#define TRACE_EVENT_PAIR 1
+#define TRACE_EVENT_JOINT 2
+#define TRACE_EVENT_END 3
+
+#define TRACE_PAIR_PARALLEL 0
+#define TRACE_PAIR_COPLANAR 1
+#define TRACE_PAIR_NO_INTERSECTION 2
+#define TRACE_PAIR_INTERSECTION 3
+
+/* One decoded trace event (pair test or joint) */
+typedef struct {
+  unsigned char kind;
+  unsigned char code; /* pair result or joint type */
+  int a, b;           /* pair indices, or component index for joints */
+  Segment3D segment;
+} TraceEvent;
+
+/* Loaded trace with a replay cursor over its pair events */
+typedef struct {
+  TraceEvent *events;
+  int event_count;
+  int *pair_starts; /* event index of each pair event, plus a sentinel */
+  int pair_count;
+  int cursor;       /* number of pair events applied */
+  int playing;
+  double speed;     /* pairs per second */
+  double pending;   /* fractional pairs carried between ticks */
+} TraceReplay;
+
+/* Orbit camera looking at the centre of the assembly's bounding sphere */
+typedef struct {
+  double yaw, pitch; /* radians */
+  double zoom;
+  Vector3D target;
+  double radius;
+} Camera;
+
+/* One character cell of the canvas raster */
+typedef struct {
+  char glyph;
+  unsigned char color;
+  unsigned char priority; /* joints overwrite outlines, labels overwrite all */
+} CanvasCell;
+
 /* Log entry */
 typedef struct {
   char message[256];
@@ -101,6 +160,19 @@ typedef struct {
   int show_normals;
   int current_step;
   int total_steps;
+  const char *record_path;
+  FILE *recorder;
+  TraceReplay *replay;
+  Camera camera;
+  CanvasCell *cells;    /* canvas raster, cells_w x cells_h */
+  int cells_w, cells_h;
+  Vector3D *projected;  /* per-vertex scratch: x, y cell coords, z depth */
+  int projected_capacity;
+  int timer_fd;         /* timerfd on Linux, -1 where unavailable */
+  int timer_armed;
+  long timer_interval;  /* ms, 0 for one-shot */
+  long timer_deadline;  /* monotonic ms, used without timerfd */
+  unsigned long timer_ticks; /* expirations reported by last wait */
 } UIState;
 
 /* Color pairs */
@@ -124,6 +196,19 @@ static void draw_status(UIState *ui, ComponentArray *components);
 static void draw_controls(UIState *ui);
 static void add_log(UIState *ui, const char *message, int color);
 static void init_test_components(ComponentArray *components);
+static void camera_fit(UIState *ui, ComponentArray *components);
+static int handle_camera_key(UIState *ui, int ch);
+static void timer_arm(UIState *ui, long first_ms, long interval_ms);
+static void timer_disarm(UIState *ui);
+static int wait_event(UIState *ui);
+static FILE *trace_record_open(const char *path, ComponentArray *components);
+static void trace_record_pair(FILE *f, int i, int j, int result);
+static void trace_record_joint(FILE *f, int component, JointType type,
+                               const Segment3D *segment);
+static int trace_record_close(FILE *f);
+static TraceReplay *trace_load(const char *path, ComponentArray *components);
+static void trace_free(TraceReplay *replay);
+static void free_components(ComponentArray *components);
 
 /* Vector operations */
 static inline double dot_product(const Vector3D *a, const Vector3D *b) {
@@ -153,6 +238,18 @@ static inline Vector3D subtract_vectors(const Vector3D *a, const Vector3D *b) {
   return result;
 }
 
+static inline Vector3D transform_point(const Matrix4x4 *matrix,
+                                       const Vector3D *point) {
+  Vector3D result = {
+      matrix->m[0][0] * point->x + matrix->m[0][1] * point->y +
+          matrix->m[0][2] * point->z + matrix->m[0][3],
+      matrix->m[1][0] * point->x + matrix->m[1][1] * point->y +
+          matrix->m[1][2] * point->z + matrix->m[1][3],
+      matrix->m[2][0] * point->x + matrix->m[2][1] * point->y +
+          matrix->m[2][2] * point->z + matrix->m[2][3]};
+  return result;
+}
+
 /* Check if components are coplanar */
 static int are_coplanar(const Component3D *c1, const Component3D *c2) {
   if (c1->vertex_count == 0 || c2->vertex_count == 0)
@@ -219,6 +316,12 @@ static void init_test_components(ComponentArray *components) {
 
     c->normal = (Vector3D){0.0, 0.0, 1.0};
 
+    /* Vertices are already in world space */
+    memset(&c->transform_3d, 0, sizeof(Matrix4x4));
+    for (int k = 0; k < 4; k++)
+      c->transform_3d.m[k][k] = 1.0;
+    c->inverse_transform = c->transform_3d;
+
     /* Initialize joint arrays */
     c->fingers.capacity = MAX_JOINTS;
     c->fingers.count = 0;
@@ -234,6 +337,471 @@ static void init_test_components(ComponentArray *components) {
   }
 }
 
+/* Frame timer: a timerfd where available, otherwise a poll() deadline */
+static long monotonic_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static void timer_arm(UIState *ui, long first_ms, long interval_ms) {
+  ui->timer_armed = 1;
+  ui->timer_interval = interval_ms;
+  ui->timer_deadline = monotonic_ms() + first_ms;
+
+#ifdef __linux__
+  if (ui->timer_fd >= 0) {
+    struct itimerspec spec = {{0, 0}, {0, 0}};
+    if (first_ms <= 0)
+      first_ms = 1; /* zero would disarm */
+    spec.it_value.tv_sec = first_ms / 1000;
+    spec.it_value.tv_nsec = (first_ms % 1000) * 1000000L;
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+    timerfd_settime(ui->timer_fd, 0, &spec, NULL);
+  }
+#endif
+}
+
+static void timer_disarm(UIState *ui) {
+  ui->timer_armed = 0;
+
+#ifdef __linux__
+  if (ui->timer_fd >= 0) {
+    struct itimerspec spec = {{0, 0}, {0, 0}};
+    uint64_t expirations;
+    timerfd_settime(ui->timer_fd, 0, &spec, NULL);
+    /* Drop an expiry that fired before disarming */
+    while (read(ui->timer_fd, &expirations, sizeof(expirations)) > 0)
+      ;
+  }
+#endif
+}
+
+/*
+ * Block until there is keyboard input or the frame timer expires. With the
+ * timer disarmed this sleeps in poll() indefinitely, so an idle UI uses no
+ * CPU and keys are handled as soon as they arrive.
+ */
+static int wait_event(UIState *ui) {
+  struct pollfd fds[2];
+  int nfds = 1;
+  int timeout = -1;
+  int events = 0;
+
+  ui->timer_ticks = 0;
+  fds[0].fd = STDIN_FILENO;
+  fds[0].events = POLLIN;
+
+  if (ui->timer_armed) {
+    if (ui->timer_fd >= 0) {
+      fds[1].fd = ui->timer_fd;
+      fds[1].events = POLLIN;
+      nfds = 2;
+    } else {
+      long remaining = ui->timer_deadline - monotonic_ms();
+      timeout = remaining > 0 ? (int)remaining : 0;
+    }
+  }
+
+  if (poll(fds, nfds, timeout) < 0)
+    return 0; /* EINTR, e.g. SIGWINCH: caller just loops */
+
+  if (fds[0].revents & POLLIN)
+    events |= EVENT_INPUT;
+
+  if (!ui->timer_armed)
+    return events;
+
+  if (nfds == 2) {
+    uint64_t expirations;
+    if ((fds[1].revents & POLLIN) &&
+        read(ui->timer_fd, &expirations, sizeof(expirations)) ==
+            sizeof(expirations))
+      ui->timer_ticks = expirations;
+  } else {
+    long now = monotonic_ms();
+    if (now >= ui->timer_deadline) {
+      ui->timer_ticks = 1;
+      if (ui->timer_interval > 0) {
+        ui->timer_ticks += (now - ui->timer_deadline) / ui->timer_interval;
+        ui->timer_deadline += ui->timer_ticks * ui->timer_interval;
+      }
+    }
+  }
+
+  if (ui->timer_ticks > 0) {
+    events |= EVENT_TIMER;
+    if (ui->timer_interval == 0)
+      ui->timer_armed = 0;
+  }
+
+  return events;
+}
+
+/* Trace recording: little-endian writers */
+static void trace_put_u8(FILE *f, unsigned int v) { fputc((int)(v & 0xFF), f); }
+
+static void trace_put_u16(FILE *f, unsigned int v) {
+  trace_put_u8(f, v);
+  trace_put_u8(f, v >> 8);
+}
+
+static void trace_put_u32(FILE *f, uint32_t v) {
+  trace_put_u16(f, v & 0xFFFF);
+  trace_put_u16(f, v >> 16);
+}
+
+static void trace_put_f32(FILE *f, double v) {
+  float fv = (float)v;
+  uint32_t bits;
+  memcpy(&bits, &fv, sizeof(bits));
+  trace_put_u32(f, bits);
+}
+
+static FILE *trace_record_open(const char *path, ComponentArray *components) {
+  FILE *f = fopen(path, "wb");
+  if (!f)
+    return NULL;
+
+  if (fwrite(TRACE_MAGIC, 1, 4, f) != 4) {
+    fclose(f);
+    return NULL;
+  }
+  trace_put_u16(f, TRACE_VERSION);
+  trace_put_u16(f, 0);
+  trace_put_u32(f, components->count);
+
+  for (int i = 0; i < components->count; i++) {
+    Component3D *c = &components->components[i];
+    trace_put_u32(f, c->id);
+    trace_put_f32(f, c->normal.x);
+    trace_put_f32(f, c->normal.y);
+    trace_put_f32(f, c->normal.z);
+    for (int r = 0; r < 12; r++)
+      trace_put_f32(f, c->transform_3d.m[r / 4][r % 4]);
+    trace_put_u32(f, c->vertex_count);
+    for (int v = 0; v < c->vertex_count; v++) {
+      trace_put_f32(f, c->vertices[v].x);
+      trace_put_f32(f, c->vertices[v].y);
+      trace_put_f32(f, c->vertices[v].z);
+    }
+  }
+
+  /* Put errors are sticky on the stream; give up before any event */
+  if (ferror(f)) {
+    fclose(f);
+    return NULL;
+  }
+
+  return f;
+}
+
+static void trace_record_pair(FILE *f, int i, int j, int result) {
+  if (!f || ferror(f))
+    return;
+  trace_put_u8(f, TRACE_EVENT_PAIR);
+  trace_put_u8(f, result);
+  trace_put_u16(f, 0);
+  trace_put_u32(f, i);
+  trace_put_u32(f, j);
+}
+
+static void trace_record_joint(FILE *f, int component, JointType type,
+                               const Segment3D *segment) {
+  if (!f || ferror(f))
+    return;
+  trace_put_u8(f, TRACE_EVENT_JOINT);
+  trace_put_u8(f, type);
+  trace_put_u16(f, 0);
+  trace_put_u32(f, component);
+  trace_put_f32(f, segment->start.x);
+  trace_put_f32(f, segment->start.y);
+  trace_put_f32(f, segment->start.z);
+  trace_put_f32(f, segment->end.x);
+  trace_put_f32(f, segment->end.y);
+  trace_put_f32(f, segment->end.z);
+}
+
+/* Returns -1 if any write since trace_record_open() failed */
+static int trace_record_close(FILE *f) {
+  int failed;
+
+  if (!f)
+    return 0;
+  trace_put_u8(f, TRACE_EVENT_END);
+  failed = ferror(f);
+  if (fclose(f) != 0)
+    failed = 1;
+  return failed ? -1 : 0;
+}
+
+/* Trace loading: little-endian readers over an in-memory buffer */
+typedef struct {
+  const unsigned char *data;
+  size_t size;
+  size_t pos;
+  int error;
+} TraceReader;
+
+static uint32_t trace_get_u32(TraceReader *r) {
+  if (r->pos + 4 > r->size) {
+    r->error = 1;
+    return 0;
+  }
+  const unsigned char *p = r->data + r->pos;
+  r->pos += 4;
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static double trace_get_f32(TraceReader *r) {
+  uint32_t bits = trace_get_u32(r);
+  float fv;
+  memcpy(&fv, &bits, sizeof(fv));
+  return fv;
+}
+
+static Vector3D trace_get_vec(TraceReader *r) {
+  Vector3D v;
+  v.x = trace_get_f32(r);
+  v.y = trace_get_f32(r);
+  v.z = trace_get_f32(r);
+  return v;
+}
+
+/* Load a whole trace file, replacing the contents of components */
+static TraceReplay *trace_load(const char *path, ComponentArray *components) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (size < 12) {
+    fclose(f);
+    return NULL;
+  }
+
+  unsigned char *data = malloc(size);
+  if (!data || fread(data, 1, size, f) != (size_t)size) {
+    free(data);
+    fclose(f);
+    return NULL;
+  }
+  fclose(f);
+
+  /* Version 1 traces carry no transforms; their outlines are world space */
+  TraceReader r = {data, (size_t)size, 0, 0};
+  int version = data[4] | (data[5] << 8);
+  if (memcmp(data, TRACE_MAGIC, 4) != 0 || version < 1 ||
+      version > TRACE_VERSION) {
+    free(data);
+    return NULL;
+  }
+  r.pos = 8;
+
+  /* Every component takes at least its fixed fields; reject counts the
+     remaining bytes cannot hold before allocating for them */
+  uint32_t count = trace_get_u32(&r);
+  size_t fixed = version >= 2 ? 68 : 20;
+  if (r.error || count > (r.size - r.pos) / fixed || count > INT_MAX / 3) {
+    free(data);
+    return NULL;
+  }
+  components->capacity = count > 0 ? count : 1;
+  components->count = 0;
+  components->components = calloc(components->capacity, sizeof(Component3D));
+  if (!components->components) {
+    free(data);
+    return NULL;
+  }
+
+  for (uint32_t i = 0; i < count && !r.error; i++) {
+    Component3D *c = &components->components[components->count++];
+    c->id = trace_get_u32(&r);
+    c->normal = trace_get_vec(&r);
+    memset(&c->transform_3d, 0, sizeof(Matrix4x4));
+    c->transform_3d.m[3][3] = 1.0;
+    for (int k = 0; k < 12; k++)
+      c->transform_3d.m[k / 4][k % 4] =
+          version >= 2 ? trace_get_f32(&r) : (k % 5 == 0 ? 1.0 : 0.0);
+    uint32_t vertex_count = trace_get_u32(&r);
+    if (r.error || vertex_count > (r.size - r.pos) / 12) {
+      r.error = 1;
+      break;
+    }
+    c->vertex_count = vertex_count;
+    c->vertices = malloc(sizeof(Vector3D) * (vertex_count ? vertex_count : 1));
+    if (!c->vertices) {
+      r.error = 1;
+      break;
+    }
+    for (uint32_t v = 0; v < vertex_count; v++)
+      c->vertices[v] = trace_get_vec(&r);
+  }
+
+  /* Events: at most one per 12 bytes remaining */
+  TraceReplay *replay = calloc(1, sizeof(TraceReplay));
+  size_t max_events = (r.size - r.pos) / 12 + 1;
+  int *joint_totals = calloc(count > 0 ? count : 1, sizeof(int) * 3);
+  if (replay) {
+    replay->events = malloc(sizeof(TraceEvent) * max_events);
+    replay->pair_starts = malloc(sizeof(int) * (max_events + 1));
+  }
+  if (!replay || !replay->events || !replay->pair_starts || !joint_totals)
+    r.error = 1;
+
+  while (!r.error && r.pos < r.size) {
+    unsigned char kind = data[r.pos];
+    if (kind == TRACE_EVENT_END)
+      break;
+    if (r.pos + 4 > r.size) {
+      r.error = 1;
+      break;
+    }
+
+    TraceEvent *e = &replay->events[replay->event_count];
+    e->kind = kind;
+    e->code = data[r.pos + 1];
+    r.pos += 4;
+
+    if (kind == TRACE_EVENT_PAIR) {
+      e->a = trace_get_u32(&r);
+      e->b = trace_get_u32(&r);
+      if ((uint32_t)e->a >= count || (uint32_t)e->b >= count) {
+        r.error = 1;
+        break;
+      }
+      replay->pair_starts[replay->pair_count++] = replay->event_count;
+    } else if (kind == TRACE_EVENT_JOINT) {
+      e->a = trace_get_u32(&r);
+      e->b = 0;
+      e->segment.start = trace_get_vec(&r);
+      e->segment.end = trace_get_vec(&r);
+      if ((uint32_t)e->a >= count || e->code > SLOT_JOINT ||
+          replay->pair_count == 0) {
+        r.error = 1;
+        break;
+      }
+      joint_totals[e->a * 3 + e->code]++;
+    } else {
+      r.error = 1;
+      break;
+    }
+
+    if (!r.error)
+      replay->event_count++;
+  }
+  free(data);
+
+  /* Size joint storage so replay never reallocates while scrubbing */
+  for (int i = 0; i < components->count && !r.error; i++) {
+    Component3D *c = &components->components[i];
+    JointArray *arrays[3] = {&c->fingers, &c->holes, &c->slots};
+    for (int t = 0; t < 3; t++) {
+      arrays[t]->capacity = joint_totals[i * 3 + t] + 1;
+      arrays[t]->count = 0;
+      arrays[t]->data = malloc(sizeof(Joint) * arrays[t]->capacity);
+      if (!arrays[t]->data)
+        r.error = 1;
+    }
+  }
+  free(joint_totals);
+
+  if (r.error) {
+    trace_free(replay);
+    free_components(components);
+    return NULL;
+  }
+
+  replay->pair_starts[replay->pair_count] = replay->event_count;
+  replay->speed = 10.0;
+  return replay;
+}
+
+static void trace_free(TraceReplay *replay) {
+  if (replay) {
+    free(replay->events);
+    free(replay->pair_starts);
+    free(replay);
+  }
+}
+
+static void free_components(ComponentArray *components) {
+  for (int i = 0; i < components->count; i++) {
+    Component3D *c = &components->components[i];
+    free(c->vertices);
+    free(c->fingers.data);
+    free(c->holes.data);
+    free(c->slots.data);
+  }
+  free(components->components);
+  components->components = NULL;
+  components->count = components->capacity = 0;
+}
+
+static JointArray *joint_array_for(Component3D *c, int type) {
+  return type == FINGER_JOINT ? &c->fingers
+         : type == HOLE_JOINT ? &c->holes
+                              : &c->slots;
+}
+
+/* Apply (direction > 0) or revert (direction < 0) one recorded pair */
+static void replay_apply_pair(TraceReplay *replay, ComponentArray *components,
+                              int pair, int direction) {
+  int first = replay->pair_starts[pair] + 1;
+  int last = replay->pair_starts[pair + 1];
+
+  if (direction > 0) {
+    for (int e = first; e < last; e++) {
+      TraceEvent *ev = &replay->events[e];
+      JointArray *arr = joint_array_for(&components->components[ev->a], ev->code);
+      arr->data[arr->count].type = ev->code;
+      arr->data[arr->count].segment = ev->segment;
+      arr->count++;
+    }
+  } else {
+    for (int e = last - 1; e >= first; e--) {
+      TraceEvent *ev = &replay->events[e];
+      joint_array_for(&components->components[ev->a], ev->code)->count--;
+    }
+  }
+}
+
+/* Move the replay cursor to target, logging the last pair crossed */
+static void replay_seek(UIState *ui, ComponentArray *components, int target) {
+  TraceReplay *replay = ui->replay;
+
+  if (target < 0)
+    target = 0;
+  if (target > replay->pair_count)
+    target = replay->pair_count;
+
+  while (replay->cursor < target)
+    replay_apply_pair(replay, components, replay->cursor++, 1);
+  while (replay->cursor > target)
+    replay_apply_pair(replay, components, --replay->cursor, -1);
+
+  ui->current_step = replay->cursor;
+
+  if (replay->cursor > 0) {
+    static const char *results[] = {"parallel - skipped", "coplanar - skipped",
+                                    "no intersection", "intersection"};
+    static const int colors[] = {COLOR_WARNING, COLOR_WARNING, COLOR_INFO,
+                                 COLOR_SUCCESS};
+    TraceEvent *ev = &replay->events[replay->pair_starts[replay->cursor - 1]];
+    int result = ev->code <= TRACE_PAIR_INTERSECTION ? ev->code : 0;
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "[%d/%d] C%d <-> C%d: %s",
+             replay->cursor, replay->pair_count,
+             components->components[ev->a].id,
+             components->components[ev->b].id, results[result]);
+    add_log(ui, log_msg, colors[result]);
+  }
+}
+
 /* Initialize UI */
 static void init_ui(UIState *ui) {
   initscr();
@@ -272,6 +840,13 @@ static void init_ui(UIState *ui) {
   ui->show_normals = 1;
   ui->current_step = 0;
   ui->total_steps = 0;
+  ui->timer_armed = 0;
+
+#ifdef __linux__
+  ui->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+#else
+  ui->timer_fd = -1;
+#endif
 
   draw_borders(ui);
   refresh();
@@ -279,6 +854,10 @@ static void init_ui(UIState *ui) {
 
 /* Cleanup UI */
 static void cleanup_ui(UIState *ui) {
+  free(ui->cells);
+  free(ui->projected);
+  if (ui->timer_fd >= 0)
+    close(ui->timer_fd);
   delwin(ui->canvas_win);
   delwin(ui->log_win);
   delwin(ui->status_win);
@@ -325,72 +904,409 @@ static void draw_borders(UIState *ui) {
   wattroff(ui->controls_win, COLOR_PAIR(COLOR_TITLE) | A_BOLD);
 }
 
-/* Draw canvas with components */
-static void draw_canvas(UIState *ui, ComponentArray *components) {
-  int max_y, max_x;
-  getmaxyx(ui->canvas_win, max_y, max_x);
+/* Wireframe rendering */
+#define PRIORITY_GRID 1
+#define PRIORITY_OUTLINE 2
+#define PRIORITY_NORMAL 3
+#define PRIORITY_JOINT 4
+#define PRIORITY_LABEL 5
+#define CAMERA_DISTANCE 3.0 /* in bounding-sphere radii */
+#define CAMERA_NEAR 0.05    /* fraction of the radius */
 
-  /* Clear content area */
-  for (int y = 1; y < max_y - 1; y++) {
-    for (int x = 1; x < max_x - 1; x++) {
-      mvwaddch(ui->canvas_win, y, x, ' ');
+/* Aim the camera at the bounding sphere of every outline in world space */
+static void camera_fit(UIState *ui, ComponentArray *components) {
+  Vector3D lo = {INFINITY, INFINITY, INFINITY};
+  Vector3D hi = {-INFINITY, -INFINITY, -INFINITY};
+
+  for (int i = 0; i < components->count; i++) {
+    Component3D *c = &components->components[i];
+    for (int v = 0; v < c->vertex_count; v++) {
+      Vector3D p = transform_point(&c->transform_3d, &c->vertices[v]);
+      lo.x = fmin(lo.x, p.x), hi.x = fmax(hi.x, p.x);
+      lo.y = fmin(lo.y, p.y), hi.y = fmax(hi.y, p.y);
+      lo.z = fmin(lo.z, p.z), hi.z = fmax(hi.z, p.z);
     }
   }
 
-  /* Draw grid if enabled */
-  if (ui->show_grid) {
-    wattron(ui->canvas_win, COLOR_PAIR(COLOR_BORDER));
-    for (int y = 3; y < max_y - 1; y += 2) {
-      for (int x = 3; x < max_x - 1; x += 4) {
-        mvwaddch(ui->canvas_win, y, x, '.');
-      }
+  Camera *cam = &ui->camera;
+  if (lo.x > hi.x) {
+    cam->target = (Vector3D){0.0, 0.0, 0.0};
+    cam->radius = 1.0;
+  } else {
+    cam->target = (Vector3D){(lo.x + hi.x) * 0.5, (lo.y + hi.y) * 0.5,
+                             (lo.z + hi.z) * 0.5};
+    Vector3D half = subtract_vectors(&hi, &cam->target);
+    cam->radius = fmax(vector_magnitude(&half), EPSILON);
+  }
+  cam->yaw = 0.6;
+  cam->pitch = 0.5;
+  cam->zoom = 1.0;
+}
+
+/* Orbit/zoom keys shared by the live and replay loops */
+static int handle_camera_key(UIState *ui, int ch) {
+  Camera *cam = &ui->camera;
+
+  switch (ch) {
+  case 'a':
+  case 'A':
+    cam->yaw -= 0.15;
+    return 1;
+  case 'd':
+  case 'D':
+    cam->yaw += 0.15;
+    return 1;
+  case 'w':
+  case 'W':
+    cam->pitch = fmin(cam->pitch + 0.15, 1.5);
+    return 1;
+  case 's':
+  case 'S':
+    cam->pitch = fmax(cam->pitch - 0.15, -1.5);
+    return 1;
+  case 'z':
+  case 'Z':
+    cam->zoom = fmin(cam->zoom * 1.25, 64.0);
+    return 1;
+  case 'x':
+  case 'X':
+    cam->zoom = fmax(cam->zoom / 1.25, 0.1);
+    return 1;
+  case 'c':
+  case 'C': {
+    double radius = cam->radius;
+    Vector3D target = cam->target;
+    cam->yaw = 0.6;
+    cam->pitch = 0.5;
+    cam->zoom = 1.0;
+    cam->radius = radius;
+    cam->target = target;
+    return 1;
+  }
+  }
+  return 0;
+}
+
+/* Camera basis and projection constants for one frame */
+typedef struct {
+  Vector3D eye, right, up, forward;
+  double focal;    /* cells per unit of view-space x/z */
+  double cx, cy;   /* canvas centre in cells */
+  double near;
+} View;
+
+static View make_view(const Camera *cam, int w, int h) {
+  View view;
+  double cp = cos(cam->pitch), sp = sin(cam->pitch);
+  double cy = cos(cam->yaw), sy = sin(cam->yaw);
+  double distance = CAMERA_DISTANCE * cam->radius;
+
+  Vector3D back = {cp * sy, cp * cy, sp}; /* from target towards the eye */
+  Vector3D world_up = {0.0, 0.0, 1.0};
+
+  view.eye = (Vector3D){cam->target.x + back.x * distance,
+                        cam->target.y + back.y * distance,
+                        cam->target.z + back.z * distance};
+  view.forward = (Vector3D){-back.x, -back.y, -back.z};
+  view.right = cross_product(&view.forward, &world_up);
+  view.right = normalise_vector(&view.right);
+  view.up = cross_product(&view.right, &view.forward);
+
+  /* Cells are roughly twice as tall as wide: fit the sphere to w and 2h */
+  double fit = (w < 2 * h ? w : 2 * h) * 0.5;
+  view.focal = fit * (distance / cam->radius) * 0.9 * cam->zoom;
+  view.cx = w * 0.5;
+  view.cy = h * 0.5;
+  view.near = CAMERA_NEAR * cam->radius;
+  return view;
+}
+
+/* World point to view space (x right, y up, z depth) */
+static Vector3D view_space(const View *view, const Vector3D *p) {
+  Vector3D d = subtract_vectors(p, &view->eye);
+  Vector3D v = {dot_product(&d, &view->right), dot_product(&d, &view->up),
+                dot_product(&d, &view->forward)};
+  return v;
+}
+
+/* View space to cell coordinates; z keeps the depth */
+static Vector3D project(const View *view, const Vector3D *v) {
+  Vector3D c = {view->cx + v->x / v->z * view->focal,
+                view->cy - v->y / v->z * view->focal * 0.5, v->z};
+  return c;
+}
+
+/* Cohen-Sutherland outcode against the [0, w) x [0, h) canvas */
+static int outcode(double x, double y, int w, int h) {
+  return (x < 0.0) | (x > w - 1.0) << 1 | (y < 0.0) << 2 | (y > h - 1.0) << 3;
+}
+
+static int clip_to_canvas(double *x0, double *y0, double *x1, double *y1,
+                          int w, int h) {
+  int c0 = outcode(*x0, *y0, w, h);
+  int c1 = outcode(*x1, *y1, w, h);
+
+  while (c0 | c1) {
+    if (c0 & c1)
+      return 0;
+
+    int c = c0 ? c0 : c1;
+    double x, y;
+    if (c & 8) {
+      x = *x0 + (*x1 - *x0) * (h - 1.0 - *y0) / (*y1 - *y0);
+      y = h - 1.0;
+    } else if (c & 4) {
+      x = *x0 + (*x1 - *x0) * (0.0 - *y0) / (*y1 - *y0);
+      y = 0.0;
+    } else if (c & 2) {
+      y = *y0 + (*y1 - *y0) * (w - 1.0 - *x0) / (*x1 - *x0);
+      x = w - 1.0;
+    } else {
+      y = *y0 + (*y1 - *y0) * (0.0 - *x0) / (*x1 - *x0);
+      x = 0.0;
+    }
+
+    if (c == c0) {
+      *x0 = x, *y0 = y;
+      c0 = outcode(x, y, w, h);
+    } else {
+      *x1 = x, *y1 = y;
+      c1 = outcode(x, y, w, h);
+    }
+  }
+  return 1;
+}
+
+static void plot(UIState *ui, int x, int y, char glyph, int color,
+                 int priority) {
+  if (x < 0 || y < 0 || x >= ui->cells_w || y >= ui->cells_h)
+    return;
+  CanvasCell *cell = &ui->cells[y * ui->cells_w + x];
+  if (priority >= cell->priority) {
+    cell->glyph = glyph;
+    cell->color = color;
+    cell->priority = priority;
+  }
+}
+
+/* Rasterize a cell-space segment with Bresenham, choosing a slope glyph */
+static void raster_line(UIState *ui, double fx0, double fy0, double fx1,
+                        double fy1, int color, int priority) {
+  if (!clip_to_canvas(&fx0, &fy0, &fx1, &fy1, ui->cells_w, ui->cells_h))
+    return;
+
+  int x0 = (int)lround(fx0), y0 = (int)lround(fy0);
+  int x1 = (int)lround(fx1), y1 = (int)lround(fy1);
+  int dx = abs(x1 - x0), dy = -abs(y1 - y0);
+  int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+  int err = dx + dy;
+
+  /* Compare slopes in screen units: a cell is about twice as tall as wide */
+  double ex = fabs(fx1 - fx0), ey = fabs(fy1 - fy0) * 2.0;
+  char glyph = ey < ex * 0.4   ? '-'
+               : ex < ey * 0.4 ? '|'
+               : ((fx1 - fx0) * (fy1 - fy0) < 0.0) ? '/'
+                                                   : '\\';
+
+  for (;;) {
+    plot(ui, x0, y0, glyph, color, priority);
+    if (x0 == x1 && y0 == y1)
+      break;
+    int e2 = 2 * err;
+    if (e2 >= dy) {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      y0 += sy;
     }
-    wattroff(ui->canvas_win, COLOR_PAIR(COLOR_BORDER));
   }
+}
 
-  /* Draw components */
-  int start_y = 5;
-  int start_x = 5;
-  int spacing = (max_x - 10) / (components->count + 1);
+/* Clip a world segment against the near plane, then rasterize it */
+static void draw_world_segment(UIState *ui, const View *view,
+                               const Vector3D *a, const Vector3D *b,
+                               int color, int priority) {
+  Vector3D va = view_space(view, a);
+  Vector3D vb = view_space(view, b);
+
+  if (va.z < view->near && vb.z < view->near)
+    return;
+  if (va.z < view->near || vb.z < view->near) {
+    double t = (view->near - va.z) / (vb.z - va.z);
+    Vector3D m = {va.x + (vb.x - va.x) * t, va.y + (vb.y - va.y) * t,
+                  view->near};
+    if (va.z < view->near)
+      va = m;
+    else
+      vb = m;
+  }
+
+  Vector3D pa = project(view, &va);
+  Vector3D pb = project(view, &vb);
+  raster_line(ui, pa.x, pa.y, pb.x, pb.y, color, priority);
+}
+
+static void draw_joint_segments(UIState *ui, const View *view,
+                                Component3D *c, JointArray *joints,
+                                int color) {
+  for (int k = 0; k < joints->count; k++) {
+    Segment3D *seg = &joints->data[k].segment;
+    Vector3D d = subtract_vectors(&seg->end, &seg->start);
+    if (vector_magnitude(&d) < EPSILON)
+      continue; /* stub joints carry no geometry */
+    Vector3D a = transform_point(&c->transform_3d, &seg->start);
+    Vector3D b = transform_point(&c->transform_3d, &seg->end);
+    draw_world_segment(ui, view, &a, &b, color, PRIORITY_JOINT);
+  }
+}
+
+/*
+ * Project every outline and joint through the camera into the cell raster.
+ * Components whose projected vertices all fall outside the same canvas edge
+ * (or behind the camera) are culled before any edge is rasterized.
+ */
+static void render_wireframe(UIState *ui, ComponentArray *components) {
+  View view = make_view(&ui->camera, ui->cells_w, ui->cells_h);
 
   for (int i = 0; i < components->count; i++) {
     Component3D *c = &components->components[i];
-    int x = start_x + i * spacing;
-    int y = start_y + (i % 3) * 3;
+    if (c->vertex_count == 0)
+      continue;
+
+    if (c->vertex_count > ui->projected_capacity) {
+      Vector3D *grown =
+          realloc(ui->projected, sizeof(Vector3D) * c->vertex_count);
+      if (!grown)
+        continue;
+      ui->projected = grown;
+      ui->projected_capacity = c->vertex_count;
+    }
 
-    /* Draw component representation */
-    wattron(ui->canvas_win, COLOR_PAIR(COLOR_INFO) | A_BOLD);
-    mvwprintw(ui->canvas_win, y, x, "[C%d]", c->id);
-    wattroff(ui->canvas_win, COLOR_PAIR(COLOR_INFO) | A_BOLD);
+    int all_out = ~0, behind = 0;
+    Vector3D world_centroid = {0.0, 0.0, 0.0};
+    for (int v = 0; v < c->vertex_count; v++) {
+      Vector3D w = transform_point(&c->transform_3d, &c->vertices[v]);
+      Vector3D vs = view_space(&view, &w);
+      world_centroid.x += w.x;
+      world_centroid.y += w.y;
+      world_centroid.z += w.z;
+      if (vs.z < view.near) {
+        behind++;
+        ui->projected[v] = vs; /* flagged by z below near */
+        continue;
+      }
+      ui->projected[v] = project(&view, &vs);
+      all_out &= outcode(ui->projected[v].x, ui->projected[v].y,
+                         ui->cells_w, ui->cells_h);
+    }
+    if (behind == c->vertex_count || (behind == 0 && all_out))
+      continue;
+
+    /* Outline edges */
+    for (int v = 0; v < c->vertex_count; v++) {
+      int n = (v + 1) % c->vertex_count;
+      Vector3D *p0 = &ui->projected[v], *p1 = &ui->projected[n];
+      if (p0->z >= view.near && p1->z >= view.near) {
+        raster_line(ui, p0->x, p0->y, p1->x, p1->y, COLOR_INFO,
+                    PRIORITY_OUTLINE);
+      } else {
+        Vector3D a = transform_point(&c->transform_3d, &c->vertices[v]);
+        Vector3D b = transform_point(&c->transform_3d, &c->vertices[n]);
+        draw_world_segment(ui, &view, &a, &b, COLOR_INFO, PRIORITY_OUTLINE);
+      }
+    }
+    for (int v = 0; v < c->vertex_count; v++)
+      if (ui->projected[v].z >= view.near)
+        plot(ui, (int)lround(ui->projected[v].x),
+             (int)lround(ui->projected[v].y), '+', COLOR_INFO,
+             PRIORITY_OUTLINE);
 
-    /* Draw simplified 3D box */
-    mvwprintw(ui->canvas_win, y + 1, x, " +--+");
-    mvwprintw(ui->canvas_win, y + 2, x, " |  |");
-    mvwprintw(ui->canvas_win, y + 3, x, " +--+");
+    world_centroid.x /= c->vertex_count;
+    world_centroid.y /= c->vertex_count;
+    world_centroid.z /= c->vertex_count;
 
-    /* Draw normal vector if enabled */
+    /* Normal as a short world-space segment from the centroid */
     if (ui->show_normals) {
-      wattron(ui->canvas_win, COLOR_PAIR(COLOR_SUCCESS));
-      mvwprintw(ui->canvas_win, y - 1, x + 2, "^");
-      wattroff(ui->canvas_win, COLOR_PAIR(COLOR_SUCCESS));
+      Vector3D tip = {
+          world_centroid.x + c->normal.x * ui->camera.radius * 0.25,
+          world_centroid.y + c->normal.y * ui->camera.radius * 0.25,
+          world_centroid.z + c->normal.z * ui->camera.radius * 0.25};
+      draw_world_segment(ui, &view, &world_centroid, &tip, COLOR_SUCCESS,
+                         PRIORITY_NORMAL);
+      Vector3D vt = view_space(&view, &tip);
+      if (vt.z >= view.near) {
+        Vector3D pt = project(&view, &vt);
+        plot(ui, (int)lround(pt.x), (int)lround(pt.y), '*', COLOR_SUCCESS,
+             PRIORITY_NORMAL);
+      }
     }
 
-    /* Draw joint indicators */
-    int joint_y = y + 4;
-    if (c->fingers.count > 0) {
-      wattron(ui->canvas_win, COLOR_PAIR(COLOR_FINGER));
-      mvwprintw(ui->canvas_win, joint_y++, x, "F:%d", c->fingers.count);
-      wattroff(ui->canvas_win, COLOR_PAIR(COLOR_FINGER));
+    draw_joint_segments(ui, &view, c, &c->fingers, COLOR_FINGER);
+    draw_joint_segments(ui, &view, c, &c->holes, COLOR_HOLE);
+    draw_joint_segments(ui, &view, c, &c->slots, COLOR_SLOT);
+
+    /* Label with joint counts at the centroid */
+    Vector3D vc = view_space(&view, &world_centroid);
+    if (vc.z >= view.near) {
+      Vector3D pc = project(&view, &vc);
+      char label[48];
+      int len = snprintf(label, sizeof(label), "C%d", c->id);
+      if (c->fingers.count + c->holes.count + c->slots.count > 0)
+        len += snprintf(label + len, sizeof(label) - len, " %d/%d/%d",
+                        c->fingers.count, c->holes.count, c->slots.count);
+      int lx = (int)lround(pc.x) - len / 2, ly = (int)lround(pc.y);
+      for (int k = 0; k < len; k++)
+        plot(ui, lx + k, ly, label[k], COLOR_TITLE, PRIORITY_LABEL);
     }
-    if (c->holes.count > 0) {
-      wattron(ui->canvas_win, COLOR_PAIR(COLOR_HOLE));
-      mvwprintw(ui->canvas_win, joint_y++, x, "H:%d", c->holes.count);
-      wattroff(ui->canvas_win, COLOR_PAIR(COLOR_HOLE));
+  }
+}
+
+/* Draw canvas with components */
+static void draw_canvas(UIState *ui, ComponentArray *components) {
+  int max_y, max_x;
+  getmaxyx(ui->canvas_win, max_y, max_x);
+
+  /* Clear content area */
+  for (int y = 1; y < max_y - 1; y++) {
+    for (int x = 1; x < max_x - 1; x++) {
+      mvwaddch(ui->canvas_win, y, x, ' ');
     }
-    if (c->slots.count > 0) {
-      wattron(ui->canvas_win, COLOR_PAIR(COLOR_SLOT));
-      mvwprintw(ui->canvas_win, joint_y++, x, "S:%d", c->slots.count);
-      wattroff(ui->canvas_win, COLOR_PAIR(COLOR_SLOT));
+  }
+
+  /* Rasterize into the cell buffer, then blit the non-empty cells */
+  int w = max_x - 2, h = max_y - 2;
+  if (w <= 0 || h <= 0) {
+    wrefresh(ui->canvas_win);
+    return;
+  }
+  if (w != ui->cells_w || h != ui->cells_h) {
+    CanvasCell *cells = realloc(ui->cells, sizeof(CanvasCell) * w * h);
+    if (!cells)
+      return;
+    ui->cells = cells;
+    ui->cells_w = w;
+    ui->cells_h = h;
+  }
+  memset(ui->cells, 0, sizeof(CanvasCell) * w * h);
+
+  if (ui->show_grid)
+    for (int y = 2; y < h; y += 2)
+      for (int x = 2; x < w; x += 4)
+        plot(ui, x, y, '.', COLOR_BORDER, PRIORITY_GRID);
+
+  render_wireframe(ui, components);
+
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      CanvasCell *cell = &ui->cells[y * w + x];
+      if (!cell->priority)
+        continue;
+      attr_t attr = COLOR_PAIR(cell->color);
+      if (cell->priority >= PRIORITY_JOINT)
+        attr |= A_BOLD;
+      mvwaddch(ui->canvas_win, y + 1, x + 1, (chtype)cell->glyph | attr);
     }
   }
 
@@ -479,8 +1395,14 @@ static void draw_status(UIState *ui, ComponentArray *components) {
 
   /* Display status */
   mvwprintw(ui->status_win, 1, 2, "Components: %d", components->count);
-  mvwprintw(ui->status_win, 2, 2, "Status: %s",
-            ui->is_running ? (ui->paused ? "PAUSED" : "RUNNING") : "STOPPED");
+  if (ui->replay)
+    mvwprintw(ui->status_win, 2, 2, "Status: REPLAY %s  pair %d/%d",
+              ui->replay->playing ? "PLAYING" : "PAUSED", ui->replay->cursor,
+              ui->replay->pair_count);
+  else
+    mvwprintw(ui->status_win, 2, 2, "Status: %s",
+              ui->is_running ? (ui->paused ? "PAUSED" : "RUNNING")
+                             : "STOPPED");
 
   wattron(ui->status_win, COLOR_PAIR(COLOR_FINGER));
   mvwprintw(ui->status_win, 3, 2, "Finger Joints: %d", total_fingers);
@@ -494,9 +1416,15 @@ static void draw_status(UIState *ui, ComponentArray *components) {
   mvwprintw(ui->status_win, 3, 45, "Slot Joints: %d", total_slots);
   wattroff(ui->status_win, COLOR_PAIR(COLOR_SLOT));
 
-  mvwprintw(ui->status_win, 4, 2, "Speed: %dms | Grid: %s | Normals: %s",
-            ui->delay_ms, ui->show_grid ? "ON" : "OFF",
-            ui->show_normals ? "ON" : "OFF");
+  if (ui->replay)
+    mvwprintw(ui->status_win, 4, 2,
+              "Speed: %g pairs/s | Grid: %s | Normals: %s", ui->replay->speed,
+              ui->show_grid ? "ON" : "OFF", ui->show_normals ? "ON" : "OFF");
+  else
+    mvwprintw(ui->status_win, 4, 2, "Speed: %dms | Grid: %s | Normals: %s%s",
+              ui->delay_ms, ui->show_grid ? "ON" : "OFF",
+              ui->show_normals ? "ON" : "OFF",
+              ui->record_path ? " | REC" : "");
 
   wrefresh(ui->status_win);
 }
@@ -514,11 +1442,21 @@ static void draw_controls(UIState *ui) {
   }
 
   wattron(ui->controls_win, COLOR_PAIR(COLOR_INFO));
-  mvwprintw(ui->controls_win, 1, 2,
-            "[SPACE] Start/Pause  [R] Reset  [Q] Quit");
-  mvwprintw(ui->controls_win, 2, 2,
-            "[+/-] Speed  [G] Toggle Grid  [N] Toggle Normals");
+  if (ui->replay) {
+    mvwprintw(ui->controls_win, 1, 2,
+              "[SPACE] Play/Pause  [LEFT/RIGHT] Step  [[/]] Scrub 10%%  "
+              "[HOME/END] Jump  [Q] Quit");
+    mvwprintw(ui->controls_win, 2, 2,
+              "[+/-] Speed  [0-9] Seek  [G] Toggle Grid  [N] Toggle Normals");
+  } else {
+    mvwprintw(ui->controls_win, 1, 2,
+              "[SPACE] Start/Pause  [R] Reset  [Q] Quit");
+    mvwprintw(ui->controls_win, 2, 2,
+              "[+/-] Speed  [G] Toggle Grid  [N] Toggle Normals");
+  }
   mvwprintw(ui->controls_win, 3, 2,
+            "[W/A/S/D] Orbit  [Z/X] Zoom In/Out  [C] Reset View");
+  mvwprintw(ui->controls_win, 4, 2,
             "3D Component Intersection Detection & Joint Classification v1.0");
   wattroff(ui->controls_win, COLOR_PAIR(COLOR_INFO));
 
@@ -533,6 +1471,12 @@ static void run_algorithm(UIState *ui, ComponentArray *components) {
 
   add_log(ui, "Algorithm started", COLOR_SUCCESS);
 
+  if (ui->record_path) {
+    ui->recorder = trace_record_open(ui->record_path, components);
+    if (!ui->recorder)
+      add_log(ui, "Could not open trace file for recording", COLOR_ERROR);
+  }
+
   int step = 0;
   for (int i = 0; i < components->count - 1; i++) {
     for (int j = i + 1; j < components->count; j++) {
@@ -550,30 +1494,37 @@ static void run_algorithm(UIState *ui, ComponentArray *components) {
       draw_status(ui, components);
       refresh();
 
-      /* Handle pause and input during execution */
-      int elapsed = 0;
-      while (elapsed < ui->delay_ms) {
-        int ch = getch();
-        if (ch == ' ') {
-          ui->paused = !ui->paused;
-          draw_status(ui, components);
-        } else if (ch == 'q' || ch == 'Q') {
-          ui->is_running = 0;
-          return;
+      /* Wait out the step delay; pausing disarms the timer entirely */
+      if (!ui->paused)
+        timer_arm(ui, ui->delay_ms, 0);
+      for (;;) {
+        int events = wait_event(ui);
+
+        if (events & EVENT_INPUT) {
+          int ch;
+          while ((ch = getch()) != ERR) {
+            if (ch == ' ') {
+              ui->paused = !ui->paused;
+              if (ui->paused)
+                timer_disarm(ui);
+              else
+                timer_arm(ui, ui->delay_ms, 0);
+              draw_status(ui, components);
+            } else if (ch == 'q' || ch == 'Q') {
+              timer_disarm(ui);
+              ui->is_running = 0;
+              if (trace_record_close(ui->recorder) != 0)
+                add_log(ui, "Trace write failed", COLOR_ERROR);
+              ui->recorder = NULL;
+              return;
+            } else if (handle_camera_key(ui, ch)) {
+              draw_canvas(ui, components);
+            }
+          }
         }
 
-        if (ui->paused) {
-          usleep(50000);
-          continue;
-        }
-
-        usleep(50000);
-        elapsed += 50;
-      }
-
-      if (ui->paused) {
-        j--;
-        continue;
+        if ((events & EVENT_TIMER) && !ui->paused)
+          break;
       }
 
       /* Check coplanar */
@@ -582,6 +1533,7 @@ static void run_algorithm(UIState *ui, ComponentArray *components) {
           snprintf(log_msg, sizeof(log_msg),
                    "C%d and C%d are coplanar - skipping", c1->id, c2->id);
           add_log(ui, log_msg, COLOR_WARNING);
+          trace_record_pair(ui->recorder, i, j, TRACE_PAIR_COPLANAR);
           draw_log(ui);
           continue;
         }
@@ -616,18 +1568,138 @@ static void run_algorithm(UIState *ui, ComponentArray *components) {
           add_log(ui, log_msg, COLOR_SLOT);
         }
 
+        Segment3D none = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+        trace_record_pair(ui->recorder, i, j, TRACE_PAIR_INTERSECTION);
+        trace_record_joint(ui->recorder, i, joint_type, &none);
+        trace_record_joint(ui->recorder, j, joint_type, &none);
+
         draw_canvas(ui, components);
         draw_log(ui);
         draw_status(ui, components);
+      } else {
+        trace_record_pair(ui->recorder, i, j, TRACE_PAIR_NO_INTERSECTION);
       }
     }
   }
 
   add_log(ui, "Algorithm completed!", COLOR_SUCCESS);
+  if (ui->recorder) {
+    if (trace_record_close(ui->recorder) == 0)
+      add_log(ui, "Trace written", COLOR_INFO);
+    else
+      add_log(ui, "Trace write failed", COLOR_ERROR);
+    ui->recorder = NULL;
+  }
   draw_log(ui);
   ui->is_running = 0;
 }
 
+/* Replay a loaded trace: stepping and scrubbing without re-executing */
+static void run_replay(UIState *ui, ComponentArray *components) {
+  TraceReplay *replay = ui->replay;
+  int running = 1;
+
+  ui->is_running = 1;
+  ui->total_steps = replay->pair_count > 0 ? replay->pair_count : 1;
+
+  while (running) {
+    int events = wait_event(ui);
+    int redraw = 0;
+
+    if (events & EVENT_INPUT) {
+      int ch;
+      while (running && (ch = getch()) != ERR) {
+        redraw = 1;
+
+        switch (ch) {
+        case ' ':
+          replay->playing = !replay->playing;
+          if (replay->playing && replay->cursor == replay->pair_count)
+            replay_seek(ui, components, 0);
+          replay->pending = 0.0;
+          break;
+        case KEY_RIGHT:
+        case 'l':
+          replay->playing = 0;
+          replay_seek(ui, components, replay->cursor + 1);
+          break;
+        case KEY_LEFT:
+        case 'h':
+          replay->playing = 0;
+          replay_seek(ui, components, replay->cursor - 1);
+          break;
+        case ']':
+          replay_seek(ui, components, replay->cursor + replay->pair_count / 10 + 1);
+          break;
+        case '[':
+          replay_seek(ui, components, replay->cursor - replay->pair_count / 10 - 1);
+          break;
+        case KEY_HOME:
+          replay_seek(ui, components, 0);
+          break;
+        case KEY_END:
+          replay_seek(ui, components, replay->pair_count);
+          break;
+        case '+':
+        case '=':
+          if (replay->speed < 1e6)
+            replay->speed *= 2.0;
+          break;
+        case '-':
+        case '_':
+          if (replay->speed > 0.5)
+            replay->speed /= 2.0;
+          break;
+        case 'g':
+        case 'G':
+          ui->show_grid = !ui->show_grid;
+          break;
+        case 'n':
+        case 'N':
+          ui->show_normals = !ui->show_normals;
+          break;
+        case 'q':
+        case 'Q':
+          running = 0;
+          break;
+        default:
+          if (ch >= '0' && ch <= '9')
+            replay_seek(ui, components,
+                        (int)((long)replay->pair_count * (ch - '0') / 10));
+          else
+            handle_camera_key(ui, ch);
+          break;
+        }
+      }
+    }
+
+    if (replay->playing && (events & EVENT_TIMER)) {
+      replay->pending += replay->speed * FRAME_MS / 1000.0 * ui->timer_ticks;
+      int advance = (int)replay->pending;
+      replay->pending -= advance;
+      if (advance > 0)
+        replay_seek(ui, components, replay->cursor + advance);
+      if (replay->cursor == replay->pair_count)
+        replay->playing = 0;
+      redraw = 1;
+    }
+
+    /* Only tick frames while playing */
+    if (replay->playing && !ui->timer_armed)
+      timer_arm(ui, FRAME_MS, FRAME_MS);
+    else if (!replay->playing && ui->timer_armed)
+      timer_disarm(ui);
+
+    if (redraw) {
+      draw_canvas(ui, components);
+      draw_log(ui);
+      draw_status(ui, components);
+    }
+  }
+
+  ui->is_running = 0;
+}
+
 /* Reset components */
 static void reset_components(ComponentArray *components) {
   for (int i = 0; i < components->count; i++) {
@@ -639,12 +1711,34 @@ static void reset_components(ComponentArray *components) {
 }
 
 /* Main */
-int main(void) {
+int main(int argc, char **argv) {
   UIState ui = {0};
   ComponentArray components = {0};
+  const char *replay_path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      ui.record_path = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else {
+      fprintf(stderr, "Usage: %s [--record FILE | --replay FILE]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (replay_path) {
+    ui.replay = trace_load(replay_path, &components);
+    if (!ui.replay) {
+      fprintf(stderr, "ERROR: cannot read trace '%s'\n", replay_path);
+      return 1;
+    }
+  } else {
+    init_test_components(&components);
+  }
 
   init_ui(&ui);
-  init_test_components(&components);
+  camera_fit(&ui, &components);
 
   draw_borders(&ui);
   draw_controls(&ui);
@@ -654,82 +1748,95 @@ int main(void) {
   refresh();
 
   add_log(&ui, "Welcome to 3D Detection Algorithm TUI Demo", COLOR_INFO);
-  add_log(&ui, "Press SPACE to start the algorithm", COLOR_INFO);
+  if (ui.replay) {
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "Loaded trace: %d pairs, %d events",
+             ui.replay->pair_count, ui.replay->event_count);
+    add_log(&ui, log_msg, COLOR_INFO);
+    add_log(&ui, "Press SPACE to play the trace", COLOR_INFO);
+  } else {
+    add_log(&ui, "Press SPACE to start the algorithm", COLOR_INFO);
+  }
   draw_log(&ui);
 
   /* Main loop */
   int running = 1;
+  if (ui.replay) {
+    run_replay(&ui, &components);
+    running = 0;
+  }
   while (running) {
-    int ch = getch();
-
-    switch (ch) {
-    case ' ':
-      if (!ui.is_running) {
-        run_algorithm(&ui, &components);
-      }
-      break;
-
-    case 'r':
-    case 'R':
-      reset_components(&components);
-      ui.log_count = 0;
-      ui.current_step = 0;
-      add_log(&ui, "Reset complete", COLOR_INFO);
-      draw_canvas(&ui, &components);
-      draw_log(&ui);
-      draw_status(&ui, &components);
-      break;
-
-    case '+':
-    case '=':
-      if (ui.delay_ms > 100) {
-        ui.delay_ms -= 100;
-        draw_status(&ui, &components);
-      }
-      break;
-
-    case '-':
-    case '_':
-      if (ui.delay_ms < 2000) {
-        ui.delay_ms += 100;
-        draw_status(&ui, &components);
-      }
-      break;
-
-    case 'g':
-    case 'G':
-      ui.show_grid = !ui.show_grid;
-      draw_canvas(&ui, &components);
-      draw_status(&ui, &components);
-      break;
-
-    case 'n':
-    case 'N':
-      ui.show_normals = !ui.show_normals;
-      draw_canvas(&ui, &components);
-      draw_status(&ui, &components);
-      break;
-
-    case 'q':
-    case 'Q':
-      running = 0;
-      break;
+    if (!(wait_event(&ui) & EVENT_INPUT))
+      continue;
+
+    int ch;
+    while (running && (ch = getch()) != ERR) {
+        switch (ch) {
+        case ' ':
+          if (!ui.is_running) {
+            run_algorithm(&ui, &components);
+          }
+          break;
+
+        case 'r':
+        case 'R':
+          reset_components(&components);
+          ui.log_count = 0;
+          ui.current_step = 0;
+          add_log(&ui, "Reset complete", COLOR_INFO);
+          draw_canvas(&ui, &components);
+          draw_log(&ui);
+          draw_status(&ui, &components);
+          break;
+
+        case '+':
+        case '=':
+          if (ui.delay_ms > 100) {
+            ui.delay_ms -= 100;
+            draw_status(&ui, &components);
+          }
+          break;
+
+        case '-':
+        case '_':
+          if (ui.delay_ms < 2000) {
+            ui.delay_ms += 100;
+            draw_status(&ui, &components);
+          }
+          break;
+
+        case 'g':
+        case 'G':
+          ui.show_grid = !ui.show_grid;
+          draw_canvas(&ui, &components);
+          draw_status(&ui, &components);
+          break;
+
+        case 'n':
+        case 'N':
+          ui.show_normals = !ui.show_normals;
+          draw_canvas(&ui, &components);
+          draw_status(&ui, &components);
+          break;
+
+        case 'q':
+        case 'Q':
+          running = 0;
+          break;
+
+        default:
+          if (handle_camera_key(&ui, ch))
+            draw_canvas(&ui, &components);
+          break;
+        }
     }
-
-    usleep(50000); /* 50ms sleep to reduce CPU usage */
   }
 
   cleanup_ui(&ui);
 
   /* Cleanup */
-  for (int i = 0; i < components.count; i++) {
-    Component3D *c = &components.components[i];
-    free(c->vertices);
-    free(c->fingers.data);
-    free(c->holes.data);
-    free(c->slots.data);
-  }
-  free(components.components);
+  free_components(&components);
+  trace_free(ui.replay);
 
   printf("Thank you for using 3D Detection Algorithm TUI Demo!\n");
 
@@ -4,17 +4,44 @@ pub fn build(b: *std.Build) void {
     const target = b.standardTargetOptions(.{});
     const optimize = b.standardOptimizeOption(.{});
 
+    // -Dc-engine=true runs detection through the shared C engine
+    const c_engine = b.option(bool, "c-engine", "Use the C engine (../3d_detection_algo.c) as the detection backend") orelse false;
+
+    const options = b.addOptions();
+    options.addOption(bool, "c_engine", c_engine);
+
     const exe = b.addExecutable(.{
         .name = "demo",
         .root_source_file = b.path("demo.zig"),
         .target = target,
         .optimize = optimize,
     });
+    exe.root_module.addOptions("build_options", options);
 
     // Link ncurses library
     exe.linkSystemLibrary("ncurses");
     exe.linkLibC();
 
+    if (c_engine) {
+        // Engine as a static library; main() is compiled out
+        const engine = b.addStaticLibrary(.{
+            .name = "detection_engine",
+            .target = target,
+            .optimize = optimize,
+        });
+        engine.addCSourceFile(.{
+            .file = b.path("../3d_detection_algo.c"),
+            .flags = &.{ "-std=c99", "-DDETECTION_ENGINE_NO_MAIN" },
+        });
+        engine.addIncludePath(b.path(".."));
+        engine.linkLibC();
+        engine.installHeader(b.path("../3d_detection_algo.h"), "3d_detection_algo.h");
+        b.installArtifact(engine);
+
+        exe.addIncludePath(b.path(".."));
+        exe.linkLibrary(engine);
+    }
+
     b.installArtifact(exe);
 
     const run_cmd = b.addRunArtifact(exe);
@@ -7,6 +7,9 @@ const c = @cImport({
     @cInclude("time.h");
     @cInclude("unistd.h");
 });
+const build_options = @import("build_options");
+// Shared C engine backend (zig build -Dc-engine=true)
+const engine = if (build_options.c_engine) @import("engine.zig") else struct {};
 
 const EPSILON = 1e-9;
 const MAX_COMPONENTS = 10;
@@ -419,7 +422,7 @@ const UIState = struct {
         _ = c.mvwprintw(self.status_win, 3, 45, "Slot Joints: %d", total_slots);
         _ = c.wattroff(self.status_win, c.COLOR_PAIR(COLOR_SLOT));
 
-        _ = c.mvwprintw(self.status_win, 4, 2, "Speed: %dms | Grid: %s | Normals: %s", self.delay_ms, if (self.show_grid) "ON" else "OFF", if (self.show_normals) "ON" else "OFF");
+        _ = c.mvwprintw(self.status_win, 4, 2, "Speed: %dms | Grid: %s | Normals: %s | Engine: %s", self.delay_ms, if (self.show_grid) "ON" else "OFF", if (self.show_normals) "ON" else "OFF", if (build_options.c_engine) "C" else "Zig");
 
         _ = c.wrefresh(self.status_win);
     }
@@ -446,6 +449,8 @@ const UIState = struct {
     }
 
     fn runAlgorithm(self: *UIState, components: []Component3D) !void {
+        if (build_options.c_engine) return self.runEngine(components);
+
         self.is_running = true;
         self.current_step = 0;
         self.total_steps = @divTrunc(@as(u32, @intCast(components.len)) * (@as(u32, @intCast(components.len)) - 1), 2);
@@ -533,6 +538,67 @@ const UIState = struct {
         self.drawLog();
         self.is_running = false;
     }
+
+    // Run the whole assembly through the C engine in one call
+    fn runEngine(self: *UIState, components: []Component3D) !void {
+        self.is_running = true;
+        defer self.is_running = false;
+
+        try self.addLog("Algorithm started (C engine)", COLOR_SUCCESS);
+
+        // Flatten outlines; demo components are authored in world space,
+        // so every transform is the identity
+        var vertices = std.ArrayList(f64).init(self.allocator);
+        defer vertices.deinit();
+        var offsets = std.ArrayList(c_int).init(self.allocator);
+        defer offsets.deinit();
+        var transforms = std.ArrayList(f64).init(self.allocator);
+        defer transforms.deinit();
+        var ids = std.ArrayList(c_int).init(self.allocator);
+        defer ids.deinit();
+
+        const identity = [16]f64{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+        try offsets.append(0);
+        for (components) |comp| {
+            for (comp.vertices.items) |v| {
+                try vertices.appendSlice(&.{ v.x, v.y, v.z });
+            }
+            try offsets.append(@intCast(vertices.items.len / 3));
+            try transforms.appendSlice(&identity);
+            try ids.append(@intCast(comp.id));
+        }
+
+        const start = std.time.nanoTimestamp();
+        var joints = try engine.detect(.{
+            .vertices = vertices.items,
+            .offsets = offsets.items,
+            .transforms = transforms.items,
+            .ids = ids.items,
+        });
+        defer joints.deinit();
+        const elapsed_us = @divTrunc(std.time.nanoTimestamp() - start, 1000);
+
+        for (0..joints.len()) |k| {
+            const seg = joints.segment(k);
+            const segment = Segment3D{
+                .start = Vector3D{ .x = seg[0], .y = seg[1], .z = seg[2] },
+                .end = Vector3D{ .x = seg[3], .y = seg[4], .z = seg[5] },
+            };
+            const comp = &components[joints.component(k)];
+            switch (joints.jointType(k)) {
+                .finger => try comp.fingers.append(Joint{ .joint_type = .finger, .segment = segment }),
+                .hole => try comp.holes.append(Joint{ .joint_type = .hole, .segment = segment }),
+                .slot => try comp.slots.append(Joint{ .joint_type = .slot, .segment = segment }),
+            }
+        }
+
+        var log_buf: [256]u8 = undefined;
+        const done_msg = try std.fmt.bufPrint(&log_buf, "Algorithm completed: {d} joints in {d} us", .{ joints.len(), elapsed_us });
+        try self.addLog(done_msg, COLOR_SUCCESS);
+        self.drawCanvas(components);
+        self.drawLog();
+        self.drawStatus(components);
+    }
 };
 
 fn initTestComponents(allocator: std.mem.Allocator) ![]Component3D {
@@ -0,0 +1,86 @@
+// Thin Zig wrapper over the C engine's flat buffer interface
+// (../3d_detection_algo.h). Built only with -Dc-engine=true.
+
+const std = @import("std");
+const c = @cImport({
+    @cInclude("3d_detection_algo.h");
+});
+
+pub const Error = error{ InvalidAssembly, DetectionFailed };
+
+pub const JointType = enum(u8) {
+    finger = c.FLAT_FINGER_JOINT,
+    hole = c.FLAT_HOLE_JOINT,
+    slot = c.FLAT_SLOT_JOINT,
+};
+
+/// Caller-owned geometry, read in place by the engine. Component i uses
+/// points offsets[i]..offsets[i + 1] of `vertices` (xyz triples in its local
+/// frame) and transforms[16 * i ..][0..16] (row-major, rigid).
+pub const Assembly = struct {
+    vertices: []const f64,
+    offsets: []const c_int,
+    transforms: []const f64,
+    ids: ?[]const c_int = null,
+
+    pub fn count(self: Assembly) usize {
+        return if (self.offsets.len > 0) self.offsets.len - 1 else 0;
+    }
+};
+
+/// Joints returned by the engine; buffers are owned by the C side.
+pub const Joints = struct {
+    raw: c.FlatJoints,
+
+    pub fn len(self: Joints) usize {
+        return @intCast(self.raw.count);
+    }
+
+    pub fn segment(self: Joints, i: usize) [6]f64 {
+        return self.raw.segments[i * 6 ..][0..6].*;
+    }
+
+    pub fn jointType(self: Joints, i: usize) JointType {
+        return @enumFromInt(self.raw.types[i]);
+    }
+
+    pub fn component(self: Joints, i: usize) usize {
+        return @intCast(self.raw.components[i]);
+    }
+
+    /// The other panel's slab footprint across joint i. Always 0: the flat
+    /// interface the engine is driven through has no thickness input.
+    pub fn width(self: Joints, i: usize) f64 {
+        return self.raw.widths[i];
+    }
+
+    pub fn deinit(self: *Joints) void {
+        c.free_flat_joints(&self.raw);
+    }
+};
+
+pub fn detect(assembly: Assembly) Error!Joints {
+    const n = assembly.count();
+    if (n == 0 or n > std.math.maxInt(c_int)) return error.InvalidAssembly;
+    if (assembly.transforms.len != n * 16) return error.InvalidAssembly;
+    if (assembly.ids) |ids| {
+        if (ids.len != n) return error.InvalidAssembly;
+    }
+    const last = assembly.offsets[n];
+    if (last < 0 or @as(usize, @intCast(last)) * 3 > assembly.vertices.len) return error.InvalidAssembly;
+
+    const flat = c.FlatAssembly{
+        .vertices = assembly.vertices.ptr,
+        .vertex_offsets = assembly.offsets.ptr,
+        .transforms = assembly.transforms.ptr,
+        .ids = if (assembly.ids) |ids| ids.ptr else null,
+        .count = @intCast(n),
+    };
+
+    var joints = Joints{ .raw = std.mem.zeroes(c.FlatJoints) };
+    if (c.detect_flat_assembly(&flat, &joints.raw) != 0) {
+        joints.deinit();
+        return error.DetectionFailed;
+    }
+    return joints;
+}
@@ -4,6 +4,7 @@
  */
 
 import { createDemoScene, JointType } from './3d_detection_algo_browser.js';
+import { createRandomAssembly } from './engine_wasm.js';
 
 // DOM Elements
 const canvas = document.getElementById('visualization-canvas');
@@ -18,6 +19,9 @@ const autoRotateCheckbox = document.getElementById('auto-rotate');
 const stepIndicator = document.getElementById('current-step');
 const logContainer = document.getElementById('algorithm-log');
 const resultsContainer = document.getElementById('results-container');
+const stressSlider = document.getElementById('stress-count');
+const stressValue = document.getElementById('stress-value');
+const stressBtn = document.getElementById('stress-btn');
 
 // State
 let detector = null;
@@ -26,6 +30,9 @@ let rotationAngle = 0;
 let autoRotate = false;
 let showNormals = true;
 let showGrid = true;
+let engineWorker = null;
+let engineReady = null;
+let stressRunId = 0;
 
 // Colors
 const COLORS = {
@@ -71,6 +78,87 @@ function setupEventListeners() {
   autoRotateCheckbox.addEventListener('change', (e) => {
     autoRotate = e.target.checked;
   });
+
+  stressSlider.addEventListener('input', (e) => {
+    stressValue.textContent = e.target.value;
+  });
+
+  stressBtn.addEventListener('click', handleStressTest);
+}
+
+/**
+ * Start the WebAssembly engine worker once; resolves when it is ready
+ */
+function getEngineWorker() {
+  if (!engineReady) {
+    engineWorker = new Worker(new URL('./detection_worker.js', import.meta.url), { type: 'module' });
+    engineReady = new Promise((resolve, reject) => {
+      const onMessage = (event) => {
+        if (event.data.type === 'ready') {
+          engineWorker.removeEventListener('message', onMessage);
+          resolve(engineWorker);
+        } else if (event.data.type === 'error') {
+          engineWorker.removeEventListener('message', onMessage);
+          engineReady = null;
+          reject(new Error(event.data.message));
+        }
+      };
+      engineWorker.addEventListener('message', onMessage);
+      engineWorker.postMessage({
+        type: 'init',
+        wasmUrl: new URL('./detection_engine.wasm', import.meta.url).href
+      });
+    });
+  }
+  return engineReady;
+}
+
+/**
+ * Run a random assembly through the WebAssembly engine in a Web Worker.
+ * Joints stream back in batches, so the page stays responsive throughout.
+ */
+async function handleStressTest() {
+  const count = parseInt(stressSlider.value);
+  const id = ++stressRunId;
+  stressBtn.disabled = true;
+
+  try {
+    const worker = await getEngineWorker();
+    const geometry = createRandomAssembly(count, id);
+    const totals = [0, 0, 0];
+    const shared = geometry.vertices.buffer instanceof ArrayBuffer ? 'copied' : 'shared';
+
+    addLogEntry(`WASM worker: ${count} components (${shared} buffers)`, 'info');
+
+    await new Promise((resolve, reject) => {
+      const onMessage = (event) => {
+        const message = event.data;
+        if (message.id !== id) return;
+
+        if (message.type === 'joints') {
+          message.types.forEach((type) => totals[type]++);
+          stepIndicator.textContent = `WASM worker: ${message.start + message.types.length} joints received`;
+        } else if (message.type === 'done') {
+          worker.removeEventListener('message', onMessage);
+          addLogEntry(
+            `WASM worker: ${message.count} joints in ${message.elapsedMs.toFixed(1)}ms ` +
+            `(F ${totals[0]} / H ${totals[1]} / S ${totals[2]})`,
+            'success'
+          );
+          resolve();
+        } else if (message.type === 'error') {
+          worker.removeEventListener('message', onMessage);
+          reject(new Error(message.message));
+        }
+      };
+      worker.addEventListener('message', onMessage);
+      worker.postMessage({ type: 'detect', id, geometry, batchSize: 4096 });
+    });
+  } catch (error) {
+    addLogEntry(`WASM worker error: ${error.message} (build wasm/ first)`, 'error');
+  } finally {
+    stressBtn.disabled = false;
+  }
 }
 
 /**
@@ -0,0 +1,53 @@
+/**
+ * 3D Component Intersection Detection Algorithm
+ * Web Worker running the WebAssembly engine
+ *
+ * Messages in:
+ *   { type: 'init', wasmUrl }
+ *   { type: 'detect', id, geometry: { vertices, offsets, transforms }, batchSize }
+ * Messages out:
+ *   { type: 'ready' }
+ *   { type: 'joints', id, start, segments, types, components, widths }
+ *     (transferred)
+ *   { type: 'done', id, count, elapsedMs }
+ *   { type: 'error', id, message }
+ *
+ * Geometry arrays may be backed by SharedArrayBuffer; they are copied once
+ * into the module's linear memory and never touched on the main thread.
+ */
+
+import { instantiateEngine } from './engine_wasm.js';
+
+let engine = null;
+
+self.addEventListener('message', async (event) => {
+  const message = event.data;
+
+  try {
+    if (message.type === 'init') {
+      const response = await fetch(message.wasmUrl);
+      engine = await instantiateEngine(await response.arrayBuffer());
+      self.postMessage({ type: 'ready' });
+    } else if (message.type === 'detect') {
+      if (!engine) throw new Error('engine not initialised');
+
+      const started = performance.now();
+      const count = engine.detectBatches(message.geometry, message.batchSize || 4096, (batch) => {
+        self.postMessage(
+          { type: 'joints', id: message.id, ...batch },
+          [batch.segments.buffer, batch.types.buffer, batch.components.buffer,
+            batch.widths.buffer]
+        );
+      });
+
+      self.postMessage({
+        type: 'done',
+        id: message.id,
+        count,
+        elapsedMs: performance.now() - started
+      });
+    }
+  } catch (error) {
+    self.postMessage({ type: 'error', id: message.id, message: error.message });
+  }
+});
@@ -0,0 +1,184 @@
+/**
+ * 3D Component Intersection Detection Algorithm
+ * WebAssembly engine loader
+ *
+ * Instantiates detection_engine.wasm (built from wasm/) and exposes the C
+ * engine's flat buffer interface. Runs unchanged in a Web Worker and in
+ * Node.js, which is what wasm/headless.mjs uses.
+ */
+
+const WASI_ENOSYS = 52;
+
+/**
+ * Satisfy every import with a stub. The engine only reaches WASI through
+ * stdio paths (trace files) that the flat interface never uses.
+ */
+function stubImports(module) {
+  const imports = {};
+
+  for (const { module: name, name: field, kind } of WebAssembly.Module.imports(module)) {
+    if (kind !== 'function') continue;
+    imports[name] = imports[name] || {};
+    imports[name][field] = field === 'proc_exit'
+      ? (code) => { throw new Error(`wasm proc_exit(${code})`); }
+      : () => WASI_ENOSYS;
+  }
+
+  return imports;
+}
+
+/**
+ * @param {BufferSource|WebAssembly.Module} source - module bytes or compiled module
+ */
+export async function instantiateEngine(source) {
+  const module = source instanceof WebAssembly.Module
+    ? source
+    : await WebAssembly.compile(source);
+  const instance = await WebAssembly.instantiate(module, stubImports(module));
+  const exports = instance.exports;
+
+  if (typeof exports._initialize === 'function') {
+    exports._initialize();
+  }
+
+  return new WasmEngine(exports);
+}
+
+export class WasmEngine {
+  constructor(exports) {
+    this.exports = exports;
+  }
+
+  /**
+   * Copy one typed array into linear memory as doubles or int32s.
+   * Float32Array input is widened by TypedArray#set.
+   */
+  copyIn(array, ArrayType) {
+    const ptr = this.exports.wasm_alloc(array.length * ArrayType.BYTES_PER_ELEMENT) >>> 0;
+    if (!ptr) throw new Error('wasm allocation failed');
+    new ArrayType(this.exports.memory.buffer, ptr, array.length).set(array);
+    return ptr;
+  }
+
+  /**
+   * Run detection and hand the joints to onBatch in slices of batchSize.
+   * Each batch owns copies of its arrays, so they can be transferred.
+   *
+   * @param {{vertices: Float64Array|Float32Array, offsets: Int32Array|Uint32Array,
+   *          transforms: Float64Array|Float32Array}} geometry
+   * @param {number} batchSize
+   * @param {(batch: {start: number, segments: Float64Array, types: Uint8Array,
+   *                  components: Int32Array, widths: Float64Array}) => void} onBatch
+   * @returns {number} total joint count
+   */
+  detectBatches(geometry, batchSize, onBatch) {
+    const { vertices, offsets, transforms } = geometry;
+    const count = offsets.length - 1;
+
+    if (count < 1 || vertices.length % 3 !== 0 || transforms.length !== count * 16 ||
+        offsets[count] * 3 > vertices.length) {
+      throw new TypeError('invalid flat assembly');
+    }
+
+    const e = this.exports;
+    const ptrs = [];
+    let joints = 0;
+
+    try {
+      ptrs.push(this.copyIn(vertices, Float64Array));
+      ptrs.push(this.copyIn(offsets, Int32Array));
+      ptrs.push(this.copyIn(transforms, Float64Array));
+      joints = e.wasm_detect(ptrs[0], ptrs[1], ptrs[2], count) >>> 0;
+    } finally {
+      ptrs.forEach((ptr) => e.wasm_release(ptr));
+    }
+
+    if (!joints) throw new Error('detection failed');
+
+    try {
+      const total = e.wasm_joint_count(joints);
+      // Views are taken after detection: memory growth detaches old buffers
+      const buffer = e.memory.buffer;
+      const segments = new Float64Array(buffer, e.wasm_joint_segments(joints) >>> 0, total * 6);
+      const types = new Uint8Array(buffer, e.wasm_joint_types(joints) >>> 0, total);
+      const components = new Int32Array(buffer, e.wasm_joint_components(joints) >>> 0, total);
+      const widths = new Float64Array(buffer, e.wasm_joint_widths(joints) >>> 0, total);
+
+      for (let start = 0; start < total; start += batchSize) {
+        const end = Math.min(start + batchSize, total);
+        onBatch({
+          start,
+          segments: segments.slice(start * 6, end * 6),
+          types: types.slice(start, end),
+          components: components.slice(start, end),
+          widths: widths.slice(start, end)
+        });
+      }
+
+      return total;
+    } finally {
+      e.wasm_free_joints(joints);
+    }
+  }
+
+  /** Run detection and return every joint at once */
+  detect(geometry) {
+    const batches = [];
+    const count = this.detectBatches(geometry, Infinity, (batch) => batches.push(batch));
+    const first = batches[0];
+
+    return {
+      count,
+      segments: first ? first.segments : new Float64Array(0),
+      types: first ? first.types : new Uint8Array(0),
+      components: first ? first.components : new Int32Array(0),
+      widths: first ? first.widths : new Float64Array(0)
+    };
+  }
+}
+
+/**
+ * Random assembly of count panels with rigid transforms, for stress tests.
+ * Allocates from SharedArrayBuffer when available so a worker can read it
+ * without a copy.
+ */
+export function createRandomAssembly(count, seed = 1) {
+  const Buffer = typeof SharedArrayBuffer !== 'undefined' && globalThis.crossOriginIsolated !== false
+    ? SharedArrayBuffer
+    : ArrayBuffer;
+  const vertices = new Float64Array(new Buffer(count * 4 * 3 * 8));
+  const offsets = new Int32Array(new Buffer((count + 1) * 4));
+  const transforms = new Float64Array(new Buffer(count * 16 * 8));
+
+  let state = seed >>> 0 || 1;
+  const random = () => {
+    state ^= state << 13;
+    state ^= state >>> 17;
+    state ^= state << 5;
+    return (state >>> 0) / 4294967296;
+  };
+
+  for (let i = 0; i < count; i++) {
+    const w = 1 + random() * 4;
+    const h = 1 + random() * 4;
+    vertices.set([0, 0, 0, w, 0, 0, w, h, 0, 0, h, 0], i * 12);
+    offsets[i + 1] = (i + 1) * 4;
+
+    // Rotation about a random axis (Rodrigues), random translation
+    const ax = random() - 0.5, ay = random() - 0.5, az = random() - 0.5;
+    const len = Math.hypot(ax, ay, az) || 1;
+    const x = ax / len, y = ay / len, z = az / len;
+    const angle = random() * Math.PI;
+    const c = Math.cos(angle), s = Math.sin(angle), t = 1 - c;
+    const side = Math.cbrt(count) * 3;
+
+    transforms.set([
+      t * x * x + c, t * x * y - s * z, t * x * z + s * y, random() * side,
+      t * x * y + s * z, t * y * y + c, t * y * z - s * x, random() * side,
+      t * x * z - s * y, t * y * z + s * x, t * z * z + c, random() * side,
+      0, 0, 0, 1
+    ], i * 16);
+  }
+
+  return { vertices, offsets, transforms };
+}
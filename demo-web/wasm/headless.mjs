@@ -0,0 +1,73 @@
+/**
+ * Headless check of the WebAssembly engine in Node's WASM runtime.
+ *
+ *   node headless.mjs [path/to/detection_engine.wasm] [component count]
+ *
+ * Loads the module through the same loader the Web Worker uses, runs a
+ * two-panel assembly and a random stress assembly, and exits non-zero if
+ * the engine rejects valid input or returns malformed joint arrays.
+ */
+
+import { readFile } from 'node:fs/promises';
+import { fileURLToPath } from 'node:url';
+import path from 'node:path';
+import { instantiateEngine, createRandomAssembly } from '../engine_wasm.js';
+
+const here = path.dirname(fileURLToPath(import.meta.url));
+const wasmPath = process.argv[2] || path.join(here, '..', 'detection_engine.wasm');
+const stressCount = parseInt(process.argv[3] || '1000', 10);
+
+function check(condition, message) {
+  if (!condition) {
+    console.error(`FAILED: ${message}`);
+    process.exit(1);
+  }
+}
+
+function checkJoints(result, componentCount) {
+  check(result.segments.length === result.count * 6, 'segments length');
+  check(result.types.length === result.count, 'types length');
+  check(result.components.length === result.count, 'components length');
+  check(result.widths.length === result.count, 'widths length');
+  for (let k = 0; k < result.count; k++) {
+    check(result.types[k] <= 2, `joint ${k} type`);
+    check(result.components[k] >= 0 && result.components[k] < componentCount,
+      `joint ${k} component`);
+  }
+}
+
+const engine = await instantiateEngine(await readFile(wasmPath));
+
+const square = [0, 0, 0, 2, 0, 0, 2, 2, 0, 0, 2, 0];
+const pair = {
+  vertices: new Float64Array([...square, ...square]),
+  offsets: new Int32Array([0, 4, 8]),
+  transforms: new Float64Array([
+    1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1,
+    1, 0, 0, 1, 0, 0, -1, 1, 0, 1, 0, 0, 0, 0, 0, 1
+  ])
+};
+const pairJoints = engine.detect(pair);
+checkJoints(pairJoints, 2);
+check(pairJoints.count === 2, 'upright panel meets the base');
+
+const stress = createRandomAssembly(stressCount);
+const started = performance.now();
+let streamed = 0;
+const total = engine.detectBatches(stress, 1024, (batch) => {
+  check(batch.start === streamed, 'batches arrive in order');
+  streamed += batch.types.length;
+});
+check(streamed === total, 'every joint streamed');
+checkJoints(engine.detect(stress), stressCount);
+
+let rejected = false;
+try {
+  engine.detect({ ...pair, transforms: new Float64Array(16) });
+} catch {
+  rejected = true;
+}
+check(rejected, 'malformed assembly rejected');
+
+console.log(`PASSED: ${stressCount} components, ${total} joints in ` +
+  `${(performance.now() - started).toFixed(1)} ms`);
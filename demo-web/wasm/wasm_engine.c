@@ -0,0 +1,73 @@
+/*
+ * 3D Component Intersection Detection - WebAssembly entry points
+ *
+ * Wraps the flat buffer interface with plain int/pointer signatures so
+ * JavaScript never has to mirror C struct layouts. All pointers are offsets
+ * into the module's linear memory.
+ */
+
+#include <stdlib.h>
+
+#include "../../3d_detection_algo.h"
+
+#define WASM_EXPORT(name) __attribute__((used, export_name(#name)))
+
+WASM_EXPORT(wasm_alloc)
+void *wasm_alloc(size_t bytes) { return malloc(bytes ? bytes : 1); }
+
+WASM_EXPORT(wasm_release)
+void wasm_release(void *ptr) { free(ptr); }
+
+/* Returns a joint set to read with the accessors below, or NULL on error */
+WASM_EXPORT(wasm_detect)
+FlatJoints *wasm_detect(const double *vertices, const int *offsets,
+                        const double *transforms, int count) {
+  FlatAssembly assembly;
+  FlatJoints *joints = calloc(1, sizeof(FlatJoints));
+
+  if (!joints)
+    return NULL;
+
+  assembly.vertices = vertices;
+  assembly.vertex_offsets = offsets;
+  assembly.transforms = transforms;
+  assembly.ids = NULL;
+  assembly.count = count;
+
+  if (detect_flat_assembly(&assembly, joints) != 0) {
+    free_flat_joints(joints);
+    free(joints);
+    return NULL;
+  }
+
+  return joints;
+}
+
+WASM_EXPORT(wasm_joint_count)
+int wasm_joint_count(const FlatJoints *joints) { return joints->count; }
+
+WASM_EXPORT(wasm_joint_segments)
+double *wasm_joint_segments(const FlatJoints *joints) {
+  return joints->segments;
+}
+
+WASM_EXPORT(wasm_joint_types)
+unsigned char *wasm_joint_types(const FlatJoints *joints) {
+  return joints->types;
+}
+
+WASM_EXPORT(wasm_joint_components)
+int *wasm_joint_components(const FlatJoints *joints) {
+  return joints->components;
+}
+
+WASM_EXPORT(wasm_joint_widths)
+double *wasm_joint_widths(const FlatJoints *joints) {
+  return joints->widths;
+}
+
+WASM_EXPORT(wasm_free_joints)
+void wasm_free_joints(FlatJoints *joints) {
+  free_flat_joints(joints);
+  free(joints);
+}
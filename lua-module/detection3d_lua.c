@@ -0,0 +1,293 @@
+/*
+ * 3D Component Intersection Detection - Lua C module
+ *
+ * Exposes the C engine to Lua 5.4 as `require("detection3d")`. Geometry and
+ * joints live in userdata-backed flat arrays (doubles, ints, bytes) that the
+ * engine reads and writes directly, so large assemblies never go through
+ * nested Lua tables.
+ */
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "3d_detection_algo.h"
+
+#define ARRAY_METATABLE "detection3d.array"
+
+typedef enum { ARRAY_DOUBLE, ARRAY_INT, ARRAY_BYTE } ArrayKind;
+
+static const char *const array_kind_names[] = {"doubles", "ints", "bytes"};
+static const size_t array_kind_sizes[] = {sizeof(double), sizeof(int),
+                                          sizeof(unsigned char)};
+
+/* Flat array userdata; element storage is a separate malloc'd block */
+typedef struct {
+  ArrayKind kind;
+  lua_Integer length;
+  void *data;
+} FlatArray;
+
+static FlatArray *check_array(lua_State *L, int index) {
+  return luaL_checkudata(L, index, ARRAY_METATABLE);
+}
+
+static FlatArray *check_array_kind(lua_State *L, int index, ArrayKind kind) {
+  FlatArray *arr = check_array(L, index);
+
+  if (arr->kind != kind)
+    luaL_argerror(L, index,
+                  lua_pushfstring(L, "expected %s array, got %s",
+                                  array_kind_names[kind],
+                                  array_kind_names[arr->kind]));
+  return arr;
+}
+
+/* Push a new array; takes ownership of data (NULL allocates zeroed) */
+static FlatArray *push_array(lua_State *L, ArrayKind kind, lua_Integer length,
+                             void *data) {
+  FlatArray *arr = lua_newuserdatauv(L, sizeof(FlatArray), 0);
+
+  arr->kind = kind;
+  arr->length = 0;
+  arr->data = NULL;
+  luaL_setmetatable(L, ARRAY_METATABLE);
+
+  if (!data && length > 0) {
+    data = calloc((size_t)length, array_kind_sizes[kind]);
+    if (!data)
+      luaL_error(L, "out of memory allocating %d %s", (int)length,
+                 array_kind_names[kind]);
+  }
+  arr->data = data;
+  arr->length = length;
+
+  return arr;
+}
+
+static lua_Integer check_element(lua_State *L, FlatArray *arr, int index) {
+  lua_Integer i = luaL_checkinteger(L, index);
+
+  luaL_argcheck(L, i >= 1 && i <= arr->length, index, "index out of range");
+  return i - 1;
+}
+
+static void push_element(lua_State *L, const FlatArray *arr, lua_Integer i) {
+  switch (arr->kind) {
+  case ARRAY_DOUBLE:
+    lua_pushnumber(L, ((const double *)arr->data)[i]);
+    break;
+  case ARRAY_INT:
+    lua_pushinteger(L, ((const int *)arr->data)[i]);
+    break;
+  case ARRAY_BYTE:
+    lua_pushinteger(L, ((const unsigned char *)arr->data)[i]);
+    break;
+  }
+}
+
+static void store_element(lua_State *L, FlatArray *arr, lua_Integer i,
+                          int value) {
+  switch (arr->kind) {
+  case ARRAY_DOUBLE:
+    ((double *)arr->data)[i] = luaL_checknumber(L, value);
+    break;
+  case ARRAY_INT:
+    ((int *)arr->data)[i] = (int)luaL_checkinteger(L, value);
+    break;
+  case ARRAY_BYTE:
+    ((unsigned char *)arr->data)[i] =
+        (unsigned char)luaL_checkinteger(L, value);
+    break;
+  }
+}
+
+/* arr[i] (1-based) or arr:method(...) */
+static int array_index(lua_State *L) {
+  FlatArray *arr = check_array(L, 1);
+
+  if (lua_type(L, 2) == LUA_TSTRING) {
+    luaL_getmetatable(L, ARRAY_METATABLE);
+    lua_getfield(L, -1, "__methods");
+    lua_getfield(L, -1, lua_tostring(L, 2));
+    return 1;
+  }
+
+  push_element(L, arr, check_element(L, arr, 2));
+  return 1;
+}
+
+static int array_newindex(lua_State *L) {
+  FlatArray *arr = check_array(L, 1);
+
+  store_element(L, arr, check_element(L, arr, 2), 3);
+  return 0;
+}
+
+static int array_len(lua_State *L) {
+  lua_pushinteger(L, check_array(L, 1)->length);
+  return 1;
+}
+
+static int array_gc(lua_State *L) {
+  FlatArray *arr = check_array(L, 1);
+
+  free(arr->data);
+  arr->data = NULL;
+  arr->length = 0;
+  return 0;
+}
+
+static int array_tostring(lua_State *L) {
+  FlatArray *arr = check_array(L, 1);
+
+  lua_pushfstring(L, "detection3d.%s(%d)", array_kind_names[arr->kind],
+                  (int)arr->length);
+  return 1;
+}
+
+/* arr:totable() -> plain Lua sequence (for small arrays and debugging) */
+static int array_totable(lua_State *L) {
+  FlatArray *arr = check_array(L, 1);
+  lua_Integer i;
+
+  lua_createtable(L, (int)arr->length, 0);
+  for (i = 0; i < arr->length; i++) {
+    push_element(L, arr, i);
+    lua_rawseti(L, -2, i + 1);
+  }
+  return 1;
+}
+
+/* arr:fill(value [, first [, last]]) */
+static int array_fill(lua_State *L) {
+  FlatArray *arr = check_array(L, 1);
+  lua_Integer first = luaL_optinteger(L, 3, 1);
+  lua_Integer last = luaL_optinteger(L, 4, arr->length);
+  lua_Integer i;
+
+  luaL_argcheck(L, first >= 1, 3, "index out of range");
+  luaL_argcheck(L, last <= arr->length, 4, "index out of range");
+  for (i = first - 1; i < last; i++)
+    store_element(L, arr, i, 2);
+  return 0;
+}
+
+/* Constructor shared by doubles()/ints(): size or sequence of values */
+static int new_array(lua_State *L, ArrayKind kind) {
+  if (lua_istable(L, 1)) {
+    lua_Integer n = luaL_len(L, 1), i;
+    FlatArray *arr = push_array(L, kind, n, NULL);
+
+    for (i = 0; i < n; i++) {
+      lua_geti(L, 1, i + 1);
+      store_element(L, arr, i, -1);
+      lua_pop(L, 1);
+    }
+    return 1;
+  }
+
+  lua_Integer n = luaL_checkinteger(L, 1);
+  luaL_argcheck(L, n >= 0, 1, "negative size");
+  push_array(L, kind, n, NULL);
+  return 1;
+}
+
+static int l_doubles(lua_State *L) { return new_array(L, ARRAY_DOUBLE); }
+
+static int l_ints(lua_State *L) { return new_array(L, ARRAY_INT); }
+
+/*
+ * detect(vertices, offsets, transforms [, ids]) -> joints
+ *
+ * vertices:   doubles, local-frame xyz triples back to back
+ * offsets:    ints, count + 1 zero-based point offsets
+ * transforms: doubles, 16 per component (row-major, rigid)
+ * ids:        optional ints, one per component
+ *
+ * joints = { count = n, segments = doubles(6n), types = bytes(n),
+ *            components = ints(n), widths = doubles(n) } with zero-based
+ *            component indices.
+ */
+static int l_detect(lua_State *L) {
+  FlatArray *vertices = check_array_kind(L, 1, ARRAY_DOUBLE);
+  FlatArray *offsets = check_array_kind(L, 2, ARRAY_INT);
+  FlatArray *transforms = check_array_kind(L, 3, ARRAY_DOUBLE);
+  FlatArray *ids = lua_isnoneornil(L, 4) ? NULL
+                                         : check_array_kind(L, 4, ARRAY_INT);
+  FlatAssembly assembly;
+  FlatJoints joints = {0};
+  const int *offs = offsets->data;
+  lua_Integer count = offsets->length - 1, i;
+
+  luaL_argcheck(L, vertices->length % 3 == 0, 1,
+                "length must be a multiple of 3");
+  luaL_argcheck(L, count >= 1 && count <= 0x7FFFFFFF, 2,
+                "need count + 1 offsets");
+  luaL_argcheck(L, offs[0] >= 0, 2, "offsets must start at 0 or above");
+  for (i = 1; i <= count; i++)
+    luaL_argcheck(L, offs[i] >= offs[i - 1], 2, "offsets must be ascending");
+  luaL_argcheck(L, (lua_Integer)offs[count] * 3 <= vertices->length, 2,
+                "offsets exceed vertices");
+  luaL_argcheck(L, transforms->length == count * 16, 3,
+                "need 16 values per component");
+  luaL_argcheck(L, !ids || ids->length == count, 4, "need one id per component");
+
+  assembly.vertices = vertices->data;
+  assembly.vertex_offsets = offs;
+  assembly.transforms = transforms->data;
+  assembly.ids = ids ? ids->data : NULL;
+  assembly.count = (int)count;
+
+  if (detect_flat_assembly(&assembly, &joints) != 0) {
+    free_flat_joints(&joints);
+    return luaL_error(L, "detection failed");
+  }
+
+  /* Hand the engine's buffers to the result arrays without copying */
+  lua_createtable(L, 0, 5);
+  lua_pushinteger(L, joints.count);
+  lua_setfield(L, -2, "count");
+  push_array(L, ARRAY_DOUBLE, (lua_Integer)joints.count * 6, joints.segments);
+  lua_setfield(L, -2, "segments");
+  push_array(L, ARRAY_BYTE, joints.count, joints.types);
+  lua_setfield(L, -2, "types");
+  push_array(L, ARRAY_INT, joints.count, joints.components);
+  lua_setfield(L, -2, "components");
+  push_array(L, ARRAY_DOUBLE, joints.count, joints.widths);
+  lua_setfield(L, -2, "widths");
+
+  return 1;
+}
+
+static const luaL_Reg array_metamethods[] = {
+    {"__index", array_index},   {"__newindex", array_newindex},
+    {"__len", array_len},       {"__gc", array_gc},
+    {"__tostring", array_tostring}, {NULL, NULL}};
+
+static const luaL_Reg array_methods[] = {
+    {"totable", array_totable}, {"fill", array_fill}, {NULL, NULL}};
+
+static const luaL_Reg module_functions[] = {{"doubles", l_doubles},
+                                            {"ints", l_ints},
+                                            {"detect", l_detect},
+                                            {NULL, NULL}};
+
+int luaopen_detection3d(lua_State *L) {
+  luaL_newmetatable(L, ARRAY_METATABLE);
+  luaL_setfuncs(L, array_metamethods, 0);
+  luaL_newlib(L, array_methods);
+  lua_setfield(L, -2, "__methods");
+  lua_pop(L, 1);
+
+  luaL_newlib(L, module_functions);
+  lua_pushinteger(L, FLAT_FINGER_JOINT);
+  lua_setfield(L, -2, "FINGER_JOINT");
+  lua_pushinteger(L, FLAT_HOLE_JOINT);
+  lua_setfield(L, -2, "HOLE_JOINT");
+  lua_pushinteger(L, FLAT_SLOT_JOINT);
+  lua_setfield(L, -2, "SLOT_JOINT");
+
+  return 1;
+}
@@ -0,0 +1,28 @@
+-- Two 2x2 panels run through the native engine
+local d3d = require("detection3d")
+
+-- Outlines are xyz triples in each panel's local frame
+local vertices = d3d.doubles({
+  0, 0, 0,  2, 0, 0,  2, 2, 0,  0, 2, 0,
+  0, 0, 0,  2, 0, 0,  2, 2, 0,  0, 2, 0,
+})
+local offsets = d3d.ints({0, 4, 8}) -- count + 1 point offsets
+
+-- Row-major rigid local-to-world transforms, 16 per component
+local transforms = d3d.doubles({
+  1, 0, 0, 0,   0, 1, 0, 0,   0, 0, 1, 0,   0, 0, 0, 1,
+  1, 0, 0, 1,   0, 0, -1, 1,  0, 1, 0, 0,   0, 0, 0, 1,
+})
+
+local joints = d3d.detect(vertices, offsets, transforms, d3d.ints({1, 2}))
+print(string.format("%d joints", joints.count))
+
+local names = {[d3d.FINGER_JOINT] = "finger", [d3d.HOLE_JOINT] = "hole",
+               [d3d.SLOT_JOINT] = "slot"}
+for i = 1, joints.count do
+  local s = (i - 1) * 6
+  print(string.format("  %-6s on component %d: (%.2f, %.2f, %.2f) -> (%.2f, %.2f, %.2f)",
+    names[joints.types[i]], joints.components[i],
+    joints.segments[s + 1], joints.segments[s + 2], joints.segments[s + 3],
+    joints.segments[s + 4], joints.segments[s + 5], joints.segments[s + 6]))
+end
@@ -0,0 +1,12 @@
+{
+  "targets": [
+    {
+      "target_name": "detection_addon",
+      "sources": ["detection_addon.c", "../3d_detection_algo.c"],
+      "include_dirs": [".."],
+      "defines": ["DETECTION_ENGINE_NO_MAIN", "NAPI_VERSION=8"],
+      "cflags": ["-O3", "-std=c99"],
+      "xcode_settings": {"OTHER_CFLAGS": ["-O3", "-std=c99"]}
+    }
+  ]
+}
@@ -0,0 +1,357 @@
+/*
+ * 3D Component Intersection Detection - N-API addon
+ *
+ * Exposes the C engine to Node.js. Geometry typed arrays are read in place
+ * on a libuv worker thread, and joint results come back as typed arrays
+ * that wrap the engine's own output buffers.
+ */
+
+#include <node_api.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "3d_detection_algo.h"
+
+#define NAPI_CALL(env, call)                                                   \
+  do {                                                                         \
+    if ((call) != napi_ok) {                                                   \
+      const napi_extended_error_info *info;                                    \
+      napi_get_last_error_info((env), &info);                                  \
+      napi_throw_error((env), NULL,                                            \
+                       info && info->error_message ? info->error_message       \
+                                                   : "N-API call failed");     \
+      return NULL;                                                             \
+    }                                                                          \
+  } while (0)
+
+/* One in-flight detect() call */
+typedef struct {
+  napi_async_work work;
+  napi_deferred deferred;
+  napi_ref array_refs[4]; /* the typed arrays the worker reads in place */
+  int ref_count;
+
+  FlatAssembly assembly;
+  const float *vertices_f32;   /* set when vertices need widening */
+  const float *transforms_f32; /* set when transforms need widening */
+  size_t vertex_values;
+  double *widened_vertices;
+  double *widened_transforms;
+
+  FlatJoints joints;
+  int status;
+} DetectJob;
+
+/*
+ * Fetch a typed array property; returns its element type, length and data,
+ * and takes a reference on the array for the job so reassigning the
+ * property while the worker runs cannot free the buffer under it
+ */
+static int get_typed_array(napi_env env, DetectJob *job, napi_value obj,
+                           const char *name, napi_typedarray_type *type,
+                           size_t *length, void **data) {
+  napi_value value;
+  bool present, is_typed;
+
+  if (napi_has_named_property(env, obj, name, &present) != napi_ok ||
+      !present)
+    return 0;
+  if (napi_get_named_property(env, obj, name, &value) != napi_ok ||
+      napi_is_typedarray(env, value, &is_typed) != napi_ok || !is_typed)
+    return -1;
+  if (napi_get_typedarray_info(env, value, type, length, data, NULL, NULL) !=
+      napi_ok)
+    return -1;
+  if (napi_create_reference(env, value, 1, &job->array_refs[job->ref_count]) !=
+      napi_ok)
+    return -1;
+  job->ref_count++;
+
+  return 1;
+}
+
+static void release_job(napi_env env, DetectJob *job) {
+  int i;
+
+  for (i = 0; i < job->ref_count; i++)
+    napi_delete_reference(env, job->array_refs[i]);
+  if (job->work)
+    napi_delete_async_work(env, job->work);
+  free_flat_joints(&job->joints);
+  free(job->widened_vertices);
+  free(job->widened_transforms);
+  free(job);
+}
+
+static void execute_detect(napi_env env, void *data) {
+  DetectJob *job = data;
+  size_t i;
+
+  (void)env;
+
+  /* Float32 input is widened here, off the event loop */
+  if (job->vertices_f32) {
+    job->widened_vertices =
+        malloc(sizeof(double) * (job->vertex_values ? job->vertex_values : 1));
+    if (!job->widened_vertices) {
+      job->status = -1;
+      return;
+    }
+    for (i = 0; i < job->vertex_values; i++)
+      job->widened_vertices[i] = job->vertices_f32[i];
+    job->assembly.vertices = job->widened_vertices;
+  }
+
+  if (job->transforms_f32) {
+    size_t n = (size_t)job->assembly.count * 16;
+
+    job->widened_transforms = malloc(sizeof(double) * n);
+    if (!job->widened_transforms) {
+      job->status = -1;
+      return;
+    }
+    for (i = 0; i < n; i++)
+      job->widened_transforms[i] = job->transforms_f32[i];
+    job->assembly.transforms = job->widened_transforms;
+  }
+
+  job->status = detect_flat_assembly(&job->assembly, &job->joints);
+}
+
+static void free_buffer(napi_env env, void *data, void *hint) {
+  (void)env;
+  (void)hint;
+  free(data);
+}
+
+/* Wrap an engine buffer as an ArrayBuffer, copying if externals are banned */
+static napi_status wrap_buffer(napi_env env, void *data, size_t bytes,
+                               napi_value *result) {
+  void *copy;
+
+  if (bytes > 0 && napi_create_external_arraybuffer(env, data, bytes,
+                                                    free_buffer, NULL,
+                                                    result) == napi_ok)
+    return napi_ok;
+
+  if (napi_create_arraybuffer(env, bytes, &copy, result) != napi_ok)
+    return napi_generic_failure;
+  if (bytes > 0)
+    memcpy(copy, data, bytes);
+  free(data);
+
+  return napi_ok;
+}
+
+static napi_value build_result(napi_env env, DetectJob *job) {
+  napi_value result, buffer, array, count;
+  size_t n = (size_t)job->joints.count;
+
+  NAPI_CALL(env, napi_create_object(env, &result));
+
+  NAPI_CALL(env, wrap_buffer(env, job->joints.segments,
+                             sizeof(double) * 6 * n, &buffer));
+  job->joints.segments = NULL;
+  NAPI_CALL(env, napi_create_typedarray(env, napi_float64_array, 6 * n,
+                                        buffer, 0, &array));
+  NAPI_CALL(env, napi_set_named_property(env, result, "segments", array));
+
+  NAPI_CALL(env, wrap_buffer(env, job->joints.types, n, &buffer));
+  job->joints.types = NULL;
+  NAPI_CALL(env,
+            napi_create_typedarray(env, napi_uint8_array, n, buffer, 0, &array));
+  NAPI_CALL(env, napi_set_named_property(env, result, "types", array));
+
+  NAPI_CALL(env, wrap_buffer(env, job->joints.components, sizeof(int) * n,
+                             &buffer));
+  job->joints.components = NULL;
+  NAPI_CALL(env,
+            napi_create_typedarray(env, napi_int32_array, n, buffer, 0, &array));
+  NAPI_CALL(env, napi_set_named_property(env, result, "components", array));
+
+  NAPI_CALL(env, wrap_buffer(env, job->joints.widths, sizeof(double) * n,
+                             &buffer));
+  job->joints.widths = NULL;
+  NAPI_CALL(env, napi_create_typedarray(env, napi_float64_array, n, buffer, 0,
+                                        &array));
+  NAPI_CALL(env, napi_set_named_property(env, result, "widths", array));
+
+  NAPI_CALL(env, napi_create_uint32(env, (uint32_t)n, &count));
+  NAPI_CALL(env, napi_set_named_property(env, result, "count", count));
+
+  return result;
+}
+
+static void complete_detect(napi_env env, napi_status status, void *data) {
+  DetectJob *job = data;
+  napi_value result = NULL;
+
+  if (status == napi_ok && job->status == 0)
+    result = build_result(env, job);
+
+  if (result) {
+    napi_resolve_deferred(env, job->deferred, result);
+  } else {
+    napi_value message, error;
+    bool pending;
+
+    /* build_result may have thrown; turn that into the rejection */
+    napi_is_exception_pending(env, &pending);
+    if (pending) {
+      napi_get_and_clear_last_exception(env, &error);
+    } else {
+      napi_create_string_utf8(env, "detection failed", NAPI_AUTO_LENGTH,
+                              &message);
+      napi_create_error(env, NULL, message, &error);
+    }
+    napi_reject_deferred(env, job->deferred, error);
+  }
+
+  release_job(env, job);
+}
+
+/*
+ * detect({ vertices, offsets, transforms[, ids] }) -> Promise
+ *
+ * vertices:   Float64Array (zero-copy) or Float32Array of local xyz triples
+ * offsets:    Int32Array/Uint32Array, count + 1 point offsets
+ * transforms: Float64Array (zero-copy) or Float32Array, 16 per component
+ * ids:        optional Int32Array of component ids
+ *
+ * Resolves to { segments: Float64Array, types: Uint8Array,
+ *               components: Int32Array, widths: Float64Array, count }.
+ */
+static napi_value detect(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1], promise;
+  napi_valuetype arg_type;
+  napi_typedarray_type type;
+  size_t vertex_len, offset_len, transform_len, id_len;
+  void *vertices, *offsets, *transforms, *ids = NULL;
+  DetectJob *job;
+  napi_value name;
+  size_t i;
+  const int *offs;
+
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+  NAPI_CALL(env, napi_typeof(env, argv[0], &arg_type));
+  if (argc < 1 || arg_type != napi_object) {
+    napi_throw_type_error(env, NULL, "detect() expects a geometry object");
+    return NULL;
+  }
+
+  job = calloc(1, sizeof(DetectJob));
+  if (!job) {
+    napi_throw_error(env, NULL, "out of memory");
+    return NULL;
+  }
+
+  /* Vertices */
+  if (get_typed_array(env, job, argv[0], "vertices", &type, &vertex_len,
+                      &vertices) != 1 ||
+      (type != napi_float64_array && type != napi_float32_array) ||
+      vertex_len % 3 != 0)
+    goto invalid;
+  job->vertex_values = vertex_len;
+  if (type == napi_float64_array)
+    job->assembly.vertices = vertices;
+  else
+    job->vertices_f32 = vertices;
+
+  /* Offsets */
+  if (get_typed_array(env, job, argv[0], "offsets", &type, &offset_len,
+                      &offsets) != 1 ||
+      (type != napi_int32_array && type != napi_uint32_array) ||
+      offset_len < 2 || offset_len - 1 > 0x7FFFFFFF)
+    goto invalid;
+  job->assembly.count = (int)(offset_len - 1);
+  job->assembly.vertex_offsets = offsets;
+
+  offs = offsets;
+  if (offs[0] < 0)
+    goto invalid;
+  for (i = 1; i < offset_len; i++)
+    if (offs[i] < offs[i - 1])
+      goto invalid;
+  if ((size_t)offs[offset_len - 1] * 3 > vertex_len)
+    goto invalid;
+
+  /* Transforms */
+  if (get_typed_array(env, job, argv[0], "transforms", &type, &transform_len,
+                      &transforms) != 1 ||
+      (type != napi_float64_array && type != napi_float32_array) ||
+      transform_len != (size_t)job->assembly.count * 16)
+    goto invalid;
+  if (type == napi_float64_array)
+    job->assembly.transforms = transforms;
+  else
+    job->transforms_f32 = transforms;
+
+  /* Optional ids */
+  switch (get_typed_array(env, job, argv[0], "ids", &type, &id_len, &ids)) {
+  case 0:
+    break;
+  case 1:
+    if (type == napi_int32_array && id_len == (size_t)job->assembly.count) {
+      job->assembly.ids = ids;
+      break;
+    }
+    /* fall through */
+  default:
+    goto invalid;
+  }
+
+  /* The promise is settled by complete_detect once the work is queued */
+  if (napi_create_string_utf8(env, "detection3d:detect", NAPI_AUTO_LENGTH,
+                              &name) != napi_ok ||
+      napi_create_async_work(env, NULL, name, execute_detect, complete_detect,
+                             job, &job->work) != napi_ok ||
+      napi_create_promise(env, &job->deferred, &promise) != napi_ok)
+    goto failed;
+  if (napi_queue_async_work(env, job->work) != napi_ok) {
+    napi_value error, message;
+
+    napi_create_string_utf8(env, "could not queue detection",
+                            NAPI_AUTO_LENGTH, &message);
+    napi_create_error(env, NULL, message, &error);
+    napi_reject_deferred(env, job->deferred, error);
+    release_job(env, job);
+    return promise;
+  }
+
+  return promise;
+
+failed:
+  release_job(env, job);
+  napi_throw_error(env, NULL, "could not start detection");
+  return NULL;
+
+invalid:
+  release_job(env, job);
+  napi_throw_type_error(
+      env, NULL,
+      "detect() expects { vertices: Float64Array|Float32Array (xyz), "
+      "offsets: Int32Array|Uint32Array (count + 1, ascending), "
+      "transforms: Float64Array|Float32Array (16 per component), "
+      "ids?: Int32Array }");
+  return NULL;
+}
+
+static napi_value init(napi_env env, napi_value exports) {
+  napi_value fn, value;
+
+  NAPI_CALL(env, napi_create_function(env, "detect", NAPI_AUTO_LENGTH, detect,
+                                      NULL, &fn));
+  NAPI_CALL(env, napi_set_named_property(env, exports, "detect", fn));
+
+  NAPI_CALL(env, napi_create_uint32(env, FLAT_FINGER_JOINT, &value));
+  NAPI_CALL(env, napi_set_named_property(env, exports, "FINGER_JOINT", value));
+  NAPI_CALL(env, napi_create_uint32(env, FLAT_HOLE_JOINT, &value));
+  NAPI_CALL(env, napi_set_named_property(env, exports, "HOLE_JOINT", value));
+  NAPI_CALL(env, napi_create_uint32(env, FLAT_SLOT_JOINT, &value));
+  NAPI_CALL(env, napi_set_named_property(env, exports, "SLOT_JOINT", value));
+
+  return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init)
@@ -0,0 +1,38 @@
+/**
+ * 3D Component Intersection Detection - native engine for Node.js
+ *
+ * Thin loader around the N-API addon built from ../3d_detection_algo.c.
+ * See README.md for the geometry layout.
+ */
+
+'use strict';
+
+const path = require('path');
+
+const addon = require(path.join(__dirname, 'build', 'Release', 'detection_addon.node'));
+
+const JointType = Object.freeze({
+  [addon.FINGER_JOINT]: 'finger',
+  [addon.HOLE_JOINT]: 'hole',
+  [addon.SLOT_JOINT]: 'slot'
+});
+
+/**
+ * Run detection on a flat assembly off the event loop.
+ * @param {{vertices: Float64Array|Float32Array, offsets: Int32Array|Uint32Array,
+ *          transforms: Float64Array|Float32Array, ids?: Int32Array}} geometry
+ * @returns {Promise<{segments: Float64Array, types: Uint8Array,
+ *                    components: Int32Array, widths: Float64Array,
+ *                    count: number}>}
+ */
+function detect(geometry) {
+  return addon.detect(geometry);
+}
+
+module.exports = {
+  detect,
+  JointType,
+  FINGER_JOINT: addon.FINGER_JOINT,
+  HOLE_JOINT: addon.HOLE_JOINT,
+  SLOT_JOINT: addon.SLOT_JOINT
+};
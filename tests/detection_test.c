@@ -0,0 +1,643 @@
+/*
+ * 3D Component Intersection Detection - Regression tests
+ *
+ * Small hand-built assemblies with known answers, run through the context
+ * API. Linked against libdetection; see `make test` in the repository
+ * root. Prints each failed check and exits non-zero if there was one.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "3d_detection_algo.h"
+
+#define TOLERANCE 1e-6
+
+static int failures;
+
+static void check(int ok, const char *test, const char *what) {
+  if (!ok) {
+    fprintf(stderr, "FAIL %s: %s\n", test, what);
+    failures++;
+  }
+}
+
+static int near(double a, double b) { return fabs(a - b) <= TOLERANCE; }
+
+// Rigid transforms placing a panel's local xy plane in the world
+static void floor_pose(double *m, double z) {
+  const double pose[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, z, 0, 0, 0, 1};
+  int k;
+
+  for (k = 0; k < 16; k++)
+    m[k] = pose[k];
+}
+
+// Local x along world x, local y up: the wall stands in the plane y = at
+static void wall_pose_y(double *m, double at) {
+  const double pose[16] = {1, 0, 0, 0, 0, 0, -1, at, 0, 1, 0, 0, 0, 0, 0, 1};
+  int k;
+
+  for (k = 0; k < 16; k++)
+    m[k] = pose[k];
+}
+
+// Local x along world y, local y up: the wall stands in the plane x = at
+static void wall_pose_x(double *m, double at) {
+  const double pose[16] = {0, 0, 1, at, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1};
+  int k;
+
+  for (k = 0; k < 16; k++)
+    m[k] = pose[k];
+}
+
+static int add_rect(DetectionContext *ctx, int id, double x0, double y0,
+                    double x1, double y1, const double *pose) {
+  double v[12];
+
+  v[0] = x0, v[1] = y0, v[2] = 0.0;
+  v[3] = x1, v[4] = y0, v[5] = 0.0;
+  v[6] = x1, v[7] = y1, v[8] = 0.0;
+  v[9] = x0, v[10] = y1, v[11] = 0.0;
+
+  return detection_add_component(ctx, id, v, 4, pose);
+}
+
+// Joints of one type on one component: how many and their total length
+static int count_joints(const DetectionContext *ctx, int component, int type,
+                        double *length) {
+  DetectionJointIterator it;
+  DetectionJoint joint;
+  int count = 0;
+
+  *length = 0.0;
+  detection_joints_begin(ctx, component, &it);
+  while (detection_joints_next(&it, &joint)) {
+    const double *s = joint.segment;
+
+    if (joint.type != type)
+      continue;
+    *length += sqrt((s[3] - s[0]) * (s[3] - s[0]) +
+                    (s[4] - s[1]) * (s[4] - s[1]) +
+                    (s[5] - s[2]) * (s[5] - s[2]));
+    count++;
+  }
+
+  return count;
+}
+
+// Floor [0, 10]^2 and a 10 x 10 wall meeting it as given; checks each
+// side's single joint type and length
+static void check_pair(const char *test, double wall_y, double wall_z0,
+                       int floor_type, int wall_type) {
+  DetectionContext *ctx = detection_context_create();
+  double pose[16], length;
+
+  floor_pose(pose, 0.0);
+  add_rect(ctx, 1, 0, 0, 10, 10, pose);
+  wall_pose_y(pose, wall_y);
+  add_rect(ctx, 2, 0, wall_z0, 10, wall_z0 + 10, pose);
+  check(detection_run(ctx) == 0, test, "run failed");
+  check(detection_joint_count(ctx) == 2, test, "expected two joints");
+  check(count_joints(ctx, 0, floor_type, &length) == 1 && near(length, 10.0),
+        test, "floor joint");
+  check(count_joints(ctx, 1, wall_type, &length) == 1 && near(length, 10.0),
+        test, "wall joint");
+  detection_context_destroy(ctx);
+}
+
+static unsigned long read_u32(const unsigned char *p) {
+  return p[0] | (unsigned long)p[1] << 8 | (unsigned long)p[2] << 16 |
+         (unsigned long)p[3] << 24;
+}
+
+// A traced run of the T pair: the header holds both outlines and the event
+// stream one pair event per pair tested and one joint event per joint
+static void test_trace(void) {
+  const char *path = "detection_test.trace";
+  DetectionContext *ctx = detection_context_create();
+  DetectionStats stats;
+  unsigned char buffer[4096];
+  unsigned long pairs = 0, joints = 0, components, c;
+  double pose[16];
+  size_t size, at = 12;
+  FILE *file;
+  int ended = 0;
+
+  floor_pose(pose, 0.0);
+  add_rect(ctx, 1, 0, 0, 10, 10, pose);
+  wall_pose_y(pose, 5.0);
+  add_rect(ctx, 2, 0, 0, 10, 10, pose);
+  check(detection_context_set_trace_path(ctx, path) == 0, "trace",
+        "set path failed");
+  check(detection_run(ctx) == 0, "trace", "traced run failed");
+  detection_get_stats(ctx, &stats);
+
+  file = fopen(path, "rb");
+  size = file ? fread(buffer, 1, sizeof(buffer), file) : 0;
+  if (file)
+    fclose(file);
+  remove(path);
+  check(size > 12 && memcmp(buffer, "D3TR", 4) == 0, "trace", "no header");
+  components = size > 12 ? read_u32(&buffer[8]) : 0;
+  check(components == 2, "trace", "header component count");
+  // id, normal, 3x4 transform, vertex count, then xyz per vertex
+  for (c = 0; c < components && at + 68 <= size; c++)
+    at += 68 + 12 * read_u32(&buffer[at + 64]);
+  while (at < size && !ended) {
+    if (buffer[at] == 1) {
+      pairs++;
+      at += 12;
+    } else if (buffer[at] == 2) {
+      joints++;
+      at += 32;
+    } else {
+      ended = buffer[at] == 3 && at + 1 == size;
+      break;
+    }
+  }
+  check(ended, "trace", "event stream not closed by END");
+  check(pairs == stats.pairs_tested, "trace", "pair events");
+  check(joints == (unsigned long)stats.joint_count, "trace", "joint events");
+
+  // Unopenable and unwritable traces fail the run
+  detection_context_set_trace_path(ctx, "no-such-directory/run.trace");
+  check(detection_run(ctx) == -1, "trace", "unopenable path not reported");
+#ifdef __linux__
+  detection_context_set_trace_path(ctx, "/dev/full");
+  check(detection_run(ctx) == -1, "trace", "failed write not reported");
+#endif
+  detection_context_set_trace_path(ctx, NULL);
+  check(detection_run(ctx) == 0, "trace", "untraced run failed");
+  detection_context_destroy(ctx);
+}
+
+static void test_classification(void) {
+  // Wall on the floor's edge, on its middle, and through it
+  check_pair("L", 0.0, 0.0, FLAT_FINGER_JOINT, FLAT_FINGER_JOINT);
+  check_pair("T", 5.0, 0.0, FLAT_HOLE_JOINT, FLAT_FINGER_JOINT);
+  check_pair("cross", 5.0, -5.0, FLAT_SLOT_JOINT, FLAT_SLOT_JOINT);
+}
+
+// Shelving: three floors on a grid of walls standing on, through and at
+// the edges of each other, for L, T and cross joints in one assembly
+static void build_shelves(DetectionContext *ctx) {
+  const double across[3] = {0.0, 5.0, 10.0};
+  const double along[3] = {0.0, 3.3, 10.0};
+  double pose[16];
+  int k, id = 1;
+
+  for (k = 0; k < 3; k++) {
+    floor_pose(pose, 4.0 * k);
+    add_rect(ctx, id++, 0, 0, 10, 10, pose);
+  }
+  for (k = 0; k < 3; k++) {
+    wall_pose_y(pose, across[k]);
+    add_rect(ctx, id++, 0, 0, 10, 8, pose);
+    wall_pose_x(pose, along[k]);
+    add_rect(ctx, id++, 0, 0, 10, 8, pose);
+  }
+}
+
+// Copy of the last run's joints in iteration order; NULL if none
+static DetectionJoint *snapshot_joints(const DetectionContext *ctx,
+                                       int *count) {
+  DetectionJoint *joints;
+  DetectionJointIterator it;
+  int n = 0;
+
+  *count = detection_joint_count(ctx);
+  joints = *count > 0 ? malloc(sizeof(DetectionJoint) * *count) : NULL;
+  if (!joints)
+    return NULL;
+  detection_joints_begin(ctx, -1, &it);
+  while (n < *count && detection_joints_next(&it, &joints[n]))
+    n++;
+  *count = n;
+
+  return joints;
+}
+
+// Whether the last run in ctx left exactly the expected joints, in order
+static int same_joints(const DetectionContext *ctx,
+                       const DetectionJoint *expected, int expected_count) {
+  DetectionJoint *actual;
+  int count, k, c, same;
+
+  actual = snapshot_joints(ctx, &count);
+  same = count == expected_count;
+  for (k = 0; same && k < count; k++) {
+    same = actual[k].type == expected[k].type &&
+           actual[k].component == expected[k].component &&
+           actual[k].width == expected[k].width;
+    for (c = 0; c < 6 && same; c++)
+      same = actual[k].segment[c] == expected[k].segment[c];
+  }
+  free(actual);
+
+  return same;
+}
+
+// Completion latch for detection_run_async()
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+  int finished;
+  int status;
+} AsyncWait;
+
+static void on_async_done(void *user, int status) {
+  AsyncWait *wait = user;
+
+  pthread_mutex_lock(&wait->lock);
+  wait->finished = 1;
+  wait->status = status;
+  pthread_cond_signal(&wait->done);
+  pthread_mutex_unlock(&wait->lock);
+}
+
+// Tiled runs, in one tile and in more tiles than rows, merge back to the
+// sequential joints
+static void test_async(void) {
+  DetectionContext *ctx = detection_context_create();
+  DetectionPool *pool = detection_pool_create(3);
+  const int tiles[3] = {1, 4, 32};
+  DetectionJoint *expected;
+  AsyncWait wait;
+  int count, k;
+
+  build_shelves(ctx);
+  check(detection_run(ctx) == 0, "async", "sequential run failed");
+  expected = snapshot_joints(ctx, &count);
+  check(count > 0, "async", "shelves have no joints");
+
+  pthread_mutex_init(&wait.lock, NULL);
+  pthread_cond_init(&wait.done, NULL);
+  for (k = 0; k < 3; k++) {
+    wait.finished = 0;
+    wait.status = -1;
+    if (detection_run_async(ctx, pool, tiles[k], NULL, on_async_done,
+                            &wait) != 0) {
+      check(0, "async", "run not scheduled");
+      continue;
+    }
+    pthread_mutex_lock(&wait.lock);
+    while (!wait.finished)
+      pthread_cond_wait(&wait.done, &wait.lock);
+    pthread_mutex_unlock(&wait.lock);
+    check(wait.status == 0, "async", "run failed");
+    check(same_joints(ctx, expected, count), "async",
+          "tiled joints differ from detection_run()");
+  }
+  pthread_cond_destroy(&wait.done);
+  pthread_mutex_destroy(&wait.lock);
+  free(expected);
+  detection_pool_destroy(pool);
+  detection_context_destroy(ctx);
+}
+
+// Pipelined runs, with the default queues and with queues of one pair so
+// the broad phase keeps blocking, give the sequential joints
+static void test_pipelined(void) {
+  DetectionContext *ctx = detection_context_create();
+  DetectionPool *pool = detection_pool_create(3);
+  const int queues[2] = {0, 1};
+  DetectionJoint *expected;
+  int count, k;
+
+  build_shelves(ctx);
+  check(detection_run(ctx) == 0, "pipelined", "sequential run failed");
+  expected = snapshot_joints(ctx, &count);
+  for (k = 0; k < 2; k++) {
+    check(detection_run_pipelined(ctx, pool, queues[k]) == 0, "pipelined",
+          "run failed");
+    check(same_joints(ctx, expected, count), "pipelined",
+          "pipelined joints differ from detection_run()");
+  }
+  free(expected);
+  detection_pool_destroy(pool);
+  detection_context_destroy(ctx);
+}
+
+// An L-shaped floor with a wall standing on its notch edge, which lies
+// between quantization steps (10 / 65535): quantized, the joint must still
+// be a finger on that edge on both parts, moved by at most the rounding
+static void test_quantization(void) {
+  const double notches[3] = {2.5, 3.3, 6.1};
+  int k, quantized;
+
+  for (k = 0; k < 3; k++) {
+    for (quantized = 0; quantized < 2; quantized++) {
+      DetectionContext *ctx = detection_context_create();
+      const double at = notches[k];
+      const double floor[18] = {0, 0, 0, 10, 0, 0, 10, at, 0,
+                                5, at, 0, 5, 10, 0, 0, 10, 0};
+      DetectionJointIterator it;
+      DetectionJoint joint;
+      double pose[16];
+      int seen = 0;
+
+      detection_context_set_vertex_quantization(ctx, quantized);
+      floor_pose(pose, 0.0);
+      detection_add_component(ctx, 1, floor, 6, pose);
+      wall_pose_y(pose, at);
+      add_rect(ctx, 2, 5, 0, 10, 5, pose);
+      check(detection_run(ctx) == 0, "quantization", "run failed");
+      detection_joints_begin(ctx, -1, &it);
+      while (detection_joints_next(&it, &joint)) {
+        const double *s = joint.segment;
+
+        check(joint.type == FLAT_FINGER_JOINT, "quantization",
+              "notch joint is not a finger");
+        check(joint.component != 0 || joint.edge == 2, "quantization",
+              "floor joint is not on the notch edge");
+        check(fabs(hypot(s[3] - s[0], s[4] - s[1]) - 5.0) < 1e-3,
+              "quantization", "joint moved by more than the rounding");
+        seen++;
+      }
+      check(seen == 2, "quantization", "expected two joints");
+      detection_context_destroy(ctx);
+    }
+  }
+}
+
+// A disc of radius 5 from two half-circle arcs, crossed 3 off its centre:
+// the chord is 8 long, not the 10 of its bounding square
+static void test_arcs(void) {
+  DetectionContext *ctx = detection_context_create();
+  const double disc[6] = {0, 5, 0, 10, 5, 0};
+  const double bulges[2] = {1.0, 1.0};
+  double pose[16], length;
+
+  floor_pose(pose, 0.0);
+  detection_add_curved_component(ctx, 1, disc, bulges, 2, pose);
+  wall_pose_x(pose, 8.0);
+  add_rect(ctx, 2, -2, -5, 12, 5, pose);
+  check(detection_run(ctx) == 0, "arcs", "run failed");
+  check(count_joints(ctx, 0, FLAT_SLOT_JOINT, &length) == 1 &&
+            near(length, 8.0),
+        "arcs", "disc slot is not the 8 long chord");
+  detection_context_destroy(ctx);
+}
+
+// A floor with a square cutout, crossed through the cutout: the joint
+// splits around the hole on both parts
+static void test_inner_loops(void) {
+  DetectionContext *ctx = detection_context_create();
+  const double v[24] = {0, 0, 0, 10, 0, 0, 10, 10, 0, 0, 10, 0,
+                        3, 3, 0, 3,  7, 0, 7,  7,  0, 7, 3,  0};
+  const int starts[2] = {0, 4};
+  double pose[16], length;
+
+  floor_pose(pose, 0.0);
+  detection_add_component_loops(ctx, 1, v, NULL, 8, starts, 2, pose);
+  wall_pose_y(pose, 5.0);
+  add_rect(ctx, 2, 0, -5, 10, 5, pose);
+  check(detection_run(ctx) == 0, "loops", "run failed");
+  check(count_joints(ctx, 0, FLAT_SLOT_JOINT, &length) == 2 &&
+            near(length, 6.0),
+        "loops", "floor slots do not skip the cutout");
+  check(count_joints(ctx, 1, FLAT_SLOT_JOINT, &length) == 2 &&
+            near(length, 6.0),
+        "loops", "wall slots do not skip the cutout");
+  detection_context_destroy(ctx);
+}
+
+// 0.2-thick slabs: each joint is as wide as the other slab, and a wall
+// leaning at 30 degrees leaves a footprint 0.2 / sin(30) = 0.4 wide
+static void test_thickness(void) {
+  DetectionContext *ctx = detection_context_create();
+  const double c = sqrt(3.0) / 2.0, s = 0.5;
+  // Local x along world x, local y rising 30 degrees across y = 5
+  const double lean[16] = {1, 0, 0, 0, 0, c, -s, 5, 0, s, c, 0, 0, 0, 0, 1};
+  double pose[16];
+  DetectionJointIterator it;
+  DetectionJoint joint;
+  int seen = 0;
+
+  detection_context_set_thickness(ctx, 0.2);
+  floor_pose(pose, 0.0);
+  add_rect(ctx, 1, 0, 0, 10, 10, pose);
+  add_rect(ctx, 2, 0, -5, 10, 5, lean);
+  check(detection_run(ctx) == 0, "thickness", "run failed");
+  detection_joints_begin(ctx, 0, &it);
+  while (detection_joints_next(&it, &joint)) {
+    check(near(joint.width, 0.4), "thickness", "floor width is not 0.4");
+    seen++;
+  }
+  detection_joints_begin(ctx, 1, &it);
+  while (detection_joints_next(&it, &joint)) {
+    check(near(joint.width, 0.4), "thickness", "wall width is not 0.4");
+    seen++;
+  }
+  check(seen == 2, "thickness", "expected two joints");
+  detection_context_destroy(ctx);
+}
+
+// A floor whose sides are each split into 8 edges, wobbling by 1e-8:
+// simplified at 1e-6 it stores 4 corners, finds the same joint, and still
+// reports the joint on the original edge it runs along
+static void test_simplification(void) {
+  int simplify;
+
+  for (simplify = 0; simplify < 2; simplify++) {
+    DetectionContext *ctx = detection_context_create();
+    const double corners[5][2] = {{0, 0}, {10, 0}, {10, 10}, {0, 10}, {0, 0}};
+    double floor[3 * 32], pose[16], length;
+    DetectionJointIterator it;
+    DetectionJoint joint;
+    DetectionStats stats;
+    int side, k, v = 0;
+
+    for (side = 0; side < 4; side++)
+      for (k = 0; k < 8; k++, v++) {
+        floor[3 * v] = corners[side][0] +
+                       (corners[side + 1][0] - corners[side][0]) * k / 8.0;
+        floor[3 * v + 1] = corners[side][1] +
+                           (corners[side + 1][1] - corners[side][1]) * k / 8.0;
+        floor[3 * v + 2] = 0.0;
+        if (k % 2)
+          floor[3 * v + (side % 2 ? 0 : 1)] += 1e-8;
+      }
+    if (simplify)
+      detection_context_set_simplify_tolerance(ctx, 1e-6);
+    floor_pose(pose, 0.0);
+    detection_add_component(ctx, 1, floor, 32, pose);
+    // Along x from 6 to 7 on y = 0: the original edge from 6.25 to 7.5
+    wall_pose_y(pose, 0.0);
+    add_rect(ctx, 2, 6, 0, 7, 5, pose);
+    check(detection_run(ctx) == 0, "simplification", "run failed");
+    detection_get_stats(ctx, &stats);
+    check(stats.vertices == (simplify ? 8 : 36), "simplification",
+          "stored vertex count");
+    check(count_joints(ctx, 0, FLAT_FINGER_JOINT, &length) == 1 &&
+              near(length, 1.0),
+          "simplification", "floor finger joint");
+    detection_joints_begin(ctx, 0, &it);
+    check(detection_joints_next(&it, &joint) && joint.edge == 5,
+          "simplification", "joint not reported on original edge 5");
+    detection_context_destroy(ctx);
+  }
+}
+
+// A floor modelled as two halves, crossed by one wall: merged they act as
+// one face; unmerged, joint merging fuses the wall's two abutting slots
+static void test_merging(void) {
+  DetectionContext *ctx = detection_context_create();
+  DetectionStats stats;
+  double pose[16], length;
+
+  floor_pose(pose, 0.0);
+  add_rect(ctx, 1, 0, 0, 5, 10, pose);
+  add_rect(ctx, 2, 5, 0, 10, 10, pose);
+  wall_pose_y(pose, 5.0);
+  add_rect(ctx, 3, 0, -5, 10, 5, pose);
+  check(detection_run(ctx) == 0, "merging", "run failed");
+  detection_get_stats(ctx, &stats);
+  check(stats.components_merged == 1, "merging", "halves not merged");
+  check(detection_component_face(ctx, 1) == 0, "merging",
+        "second half not held by the first");
+  check(count_joints(ctx, 0, FLAT_SLOT_JOINT, &length) == 1 &&
+            near(length, 10.0),
+        "merging", "face slot is not the full width");
+
+  detection_context_set_face_merging(ctx, 0);
+  check(detection_run(ctx) == 0, "merging", "unmerged run failed");
+  detection_get_stats(ctx, &stats);
+  check(stats.components_merged == 0, "merging", "halves merged when off");
+  check(count_joints(ctx, 2, FLAT_SLOT_JOINT, &length) == 2, "merging",
+        "wall should meet each half separately");
+  detection_context_destroy(ctx);
+}
+
+// Abutting collinear slots fuse when joint merging is on. The second
+// case has two line groups whose first one shrinks as it fuses, which
+// used to leave the second group fusing into the first one's last run.
+static void test_joint_merging(void) {
+  DetectionContext *ctx = detection_context_create();
+  double pose[16], length;
+
+  detection_context_set_face_merging(ctx, 0);
+  detection_context_set_joint_merging(ctx, 1);
+  floor_pose(pose, 0.0);
+  add_rect(ctx, 1, 0, 0, 5, 10, pose);
+  add_rect(ctx, 2, 5, 0, 10, 10, pose);
+  wall_pose_y(pose, 5.0);
+  add_rect(ctx, 3, 0, -5, 10, 5, pose);
+  check(detection_run(ctx) == 0, "joint merging", "run failed");
+  check(count_joints(ctx, 2, FLAT_SLOT_JOINT, &length) == 1 &&
+            near(length, 10.0),
+        "joint merging", "abutting wall slots not fused");
+  detection_context_destroy(ctx);
+
+  ctx = detection_context_create();
+  detection_context_set_face_merging(ctx, 0);
+  detection_context_set_joint_merging(ctx, 1);
+  floor_pose(pose, 0.0);
+  add_rect(ctx, 1, 0, 0, 10, 10, pose);
+  wall_pose_y(pose, 5.0);
+  add_rect(ctx, 2, 0, -5, 5, 5, pose);
+  add_rect(ctx, 3, 5, -5, 10, 5, pose);
+  wall_pose_x(pose, 5.0);
+  add_rect(ctx, 4, 0, -5, 5, 5, pose);
+  add_rect(ctx, 5, 5, -5, 10, 5, pose);
+  check(detection_run(ctx) == 0, "joint merging", "split walls run failed");
+  check(count_joints(ctx, 0, FLAT_SLOT_JOINT, &length) == 2, "joint merging",
+        "each split wall should leave one fused floor slot");
+  detection_context_destroy(ctx);
+}
+
+// Teeth along an L joint: an odd number of slots shared out so the floor
+// (lowest index) keeps both ends and the wall cuts one more than it
+static void test_teeth(void) {
+  DetectionContext *ctx = detection_context_create();
+  DetectionTeethParams params = {0.5, 1.0, 0.0};
+  double pose[16], *corners;
+  int *owners, total, k, cuts[2] = {0, 0};
+
+  floor_pose(pose, 0.0);
+  add_rect(ctx, 1, 0, 0, 10, 10, pose);
+  wall_pose_y(pose, 0.0);
+  add_rect(ctx, 2, 0, 0, 10, 10, pose);
+  check(detection_run(ctx) == 0, "teeth", "run failed");
+  total = detection_generate_teeth(ctx, &params, NULL, NULL, 0);
+  check(total > 0 && total % 2 == 1, "teeth", "expected an odd cut count");
+  if (total <= 0) {
+    detection_context_destroy(ctx);
+    return;
+  }
+
+  corners = malloc(sizeof(double) * 8 * total);
+  owners = malloc(sizeof(int) * total);
+  check(detection_generate_teeth(ctx, &params, corners, owners, total) ==
+            total,
+        "teeth", "second call disagrees");
+  for (k = 0; k < total; k++) {
+    const double *q = &corners[8 * k];
+    double area = 0.0;
+    int c;
+
+    if (owners[k] == 0 || owners[k] == 1)
+      cuts[owners[k]]++;
+    for (c = 0; c < 4; c++)
+      area += q[2 * c] * q[(2 * c + 3) % 8] - q[(2 * c + 2) % 8] * q[2 * c + 1];
+    check(near(area * 0.5, 10.0 / total * 0.5), "teeth",
+          "cut is not one slot by the depth");
+  }
+  check(cuts[1] == cuts[0] + 1, "teeth", "wall should cut one more slot");
+  free(corners);
+  free(owners);
+  detection_context_destroy(ctx);
+}
+
+// A T joint's hole opening: the joint grown by clearance, shrunk by kerf / 2
+static void test_offsets(void) {
+  DetectionContext *ctx = detection_context_create();
+  DetectionOffsetParams params = {0.3, 0.1, 0.1};
+  double pose[16], corners[8], area = 0.0;
+  int type = -1, c;
+
+  floor_pose(pose, 0.0);
+  add_rect(ctx, 1, 0, 0, 10, 10, pose);
+  wall_pose_y(pose, 5.0);
+  add_rect(ctx, 2, 2, 0, 8, 10, pose);
+  check(detection_run(ctx) == 0, "offsets", "run failed");
+  check(detection_offset_joints(ctx, 0, &params, corners, &type, 1) == 1,
+        "offsets", "expected one opening");
+  check(type == FLAT_HOLE_JOINT, "offsets", "opening is not a hole");
+  for (c = 0; c < 4; c++)
+    area += corners[2 * c] * corners[(2 * c + 3) % 8] -
+            corners[(2 * c + 2) % 8] * corners[2 * c + 1];
+  // (6 + 2 * 0.1 - 0.1) x (0.3 + 2 * 0.1 - 0.1), counterclockwise
+  check(near(area * 0.5, 6.1 * 0.4), "offsets", "opening is not 6.1 x 0.4");
+  detection_context_destroy(ctx);
+}
+
+int main(void) {
+  test_classification();
+  test_trace();
+  test_async();
+  test_pipelined();
+  test_quantization();
+  test_arcs();
+  test_inner_loops();
+  test_thickness();
+  test_simplification();
+  test_merging();
+  test_joint_merging();
+  test_teeth();
+  test_offsets();
+
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("libdetection %s: all tests passed\n", detection_version());
+
+  return 0;
+}